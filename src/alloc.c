@@ -0,0 +1,377 @@
+#include "alloc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/* alignment of everything handed out by arenas and pools */
+#define ALIGN 16
+
+#define ALIGN_UP(n) (((n) + (ALIGN - 1)) & ~((size_t) ALIGN - 1))
+
+
+void *mem_alloc(allocator_p a, size_t bytes)
+{
+	return a ? a->alloc(a->state, bytes) : malloc(bytes);
+}
+
+
+void *mem_calloc(allocator_p a, size_t n, size_t bytes)
+{
+	void *ptr = NULL;
+
+	if (!a) {
+		return calloc(n, bytes);
+	}
+
+	if (bytes && n > (size_t) -1 / bytes) {
+		return NULL;
+	}
+
+	ptr = a->alloc(a->state, n * bytes);
+	if (ptr) {
+		memset(ptr, 0, n * bytes);
+	}
+	return ptr;
+}
+
+
+void *mem_realloc(allocator_p a, void *ptr, size_t old_bytes, size_t bytes)
+{
+	return a ? a->realloc(a->state, ptr, old_bytes, bytes) : realloc(ptr, bytes);
+}
+
+
+void mem_free(allocator_p a, void *ptr, size_t bytes)
+{
+	if (!ptr) {
+		return;
+	}
+
+	if (a) {
+		a->free(a->state, ptr, bytes);
+	} else {
+		free(ptr);
+	}
+}
+
+
+
+/*
+ * Block of an arena.
+ */
+typedef struct s_arena_block
+{
+	struct s_arena_block *next;
+
+	/* bytes of data, and how many of them are used */
+	size_t size;
+	size_t used;
+
+	/* the last allocation, for realloc and free in place */
+	char *last;
+
+	char data[] __attribute__((aligned(ALIGN)));
+}
+arena_block_t, *arena_block_p;
+
+
+typedef struct s_arena
+{
+	allocator_p parent;
+	size_t block_bytes;
+
+	/* the blocks, in the order they are used */
+	arena_block_p first;
+	arena_block_p current;
+
+	allocator_t allocator;
+}
+arena_t;
+
+
+static void *arena_alloc_cb(void *state, size_t bytes)
+{
+	return arena_alloc((arena_p) state, bytes);
+}
+
+
+static void *arena_realloc_cb(void *state, void *ptr, size_t old_bytes, size_t bytes)
+{
+	arena_p arena = (arena_p) state;
+	arena_block_p block = arena->current;
+	void *new_ptr = NULL;
+
+	if (ptr && block && (char *) ptr == block->last
+			&& (size_t) (block->last - block->data) + bytes <= block->size) {
+		/* the last allocation, resize it in place */
+		block->used = ALIGN_UP((size_t) (block->last - block->data) + bytes);
+		if (block->used > block->size) {
+			block->used = block->size;
+		}
+		return ptr;
+	}
+
+	new_ptr = arena_alloc(arena, bytes);
+	if (new_ptr && ptr) {
+		memcpy(new_ptr, ptr, old_bytes < bytes ? old_bytes : bytes);
+	}
+	return new_ptr;
+}
+
+
+static void arena_free_cb(void *state, void *ptr, size_t bytes)
+{
+	arena_block_p block = ((arena_p) state)->current;
+
+	(void) bytes;
+
+	if (block && (char *) ptr == block->last) {
+		block->used = (size_t) (block->last - block->data);
+		block->last = NULL;
+	}
+}
+
+
+arena_p arena_create(allocator_p parent, size_t block_bytes)
+{
+	arena_p arena = (arena_p) mem_alloc(parent, sizeof(arena_t));
+	if (arena) {
+		arena->parent = parent;
+		arena->block_bytes = block_bytes ? ALIGN_UP(block_bytes) : 4096;
+		arena->first = NULL;
+		arena->current = NULL;
+		arena->allocator.alloc = arena_alloc_cb;
+		arena->allocator.realloc = arena_realloc_cb;
+		arena->allocator.free = arena_free_cb;
+		arena->allocator.state = arena;
+	}
+	return arena;
+}
+
+
+void arena_destroy(arena_p arena)
+{
+	if (arena) {
+		arena_block_p block = arena->first;
+
+		while (block) {
+			arena_block_p next = block->next;
+			mem_free(arena->parent, block, sizeof(arena_block_t) + block->size);
+			block = next;
+		}
+		arena->first = NULL;
+		arena->current = NULL;
+
+		mem_free(arena->parent, arena, sizeof(arena_t));
+	}
+}
+
+
+void *arena_alloc(arena_p arena, size_t bytes)
+{
+	arena_block_p block = arena->current, next = NULL;
+	size_t size = ALIGN_UP(bytes ? bytes : 1);
+	char *ptr = NULL;
+
+	if (!block || block->size - block->used < size) {
+		/* go on with the next kept block, or a new one if it is not large enough */
+		next = block ? block->next : arena->first;
+
+		if (!next || next->size < size) {
+			size_t block_size = size > arena->block_bytes ? size : arena->block_bytes;
+
+			next = (arena_block_p) mem_alloc(arena->parent, sizeof(arena_block_t) + block_size);
+			if (!next) {
+				return NULL;
+			}
+			next->size = block_size;
+
+			if (block) {
+				next->next = block->next;
+				block->next = next;
+			} else {
+				next->next = arena->first;
+				arena->first = next;
+			}
+		}
+
+		next->used = 0;
+		next->last = NULL;
+		arena->current = block = next;
+	}
+
+	ptr = block->data + block->used;
+	block->used += size;
+	block->last = ptr;
+	return ptr;
+}
+
+
+arena_mark_t arena_mark(arena_p arena)
+{
+	arena_mark_t mark = { .block = arena->current, .used = arena->current ? arena->current->used : 0 };
+	return mark;
+}
+
+
+void arena_reset_to(arena_p arena, arena_mark_t mark)
+{
+	arena_block_p block = (arena_block_p) mark.block;
+
+	arena->current = block;
+	if (block) {
+		block->used = mark.used;
+		block->last = NULL;
+	}
+}
+
+
+void arena_reset(arena_p arena)
+{
+	arena->current = NULL;
+}
+
+
+allocator_p arena_allocator(arena_p arena)
+{
+	return &arena->allocator;
+}
+
+
+
+/*
+ * Block of a pool.
+ */
+typedef struct s_pool_block
+{
+	struct s_pool_block *next;
+
+	char data[] __attribute__((aligned(ALIGN)));
+}
+pool_block_t, *pool_block_p;
+
+
+typedef struct s_pool
+{
+	allocator_p parent;
+	size_t item_bytes;
+	size_t items_per_block;
+
+	pool_block_p blocks;
+
+	/* the items put back, linked through their first bytes */
+	void *free_items;
+
+	allocator_t allocator;
+}
+pool_t;
+
+
+static void *pool_alloc_cb(void *state, size_t bytes)
+{
+	pool_p pool = (pool_p) state;
+
+	return bytes <= pool->item_bytes ? pool_alloc(pool) : NULL;
+}
+
+
+static void *pool_realloc_cb(void *state, void *ptr, size_t old_bytes, size_t bytes)
+{
+	pool_p pool = (pool_p) state;
+
+	(void) old_bytes;
+
+	if (bytes > pool->item_bytes) {
+		return NULL;
+	}
+	return ptr ? ptr : pool_alloc(pool);
+}
+
+
+static void pool_free_cb(void *state, void *ptr, size_t bytes)
+{
+	(void) bytes;
+	pool_free((pool_p) state, ptr);
+}
+
+
+pool_p pool_create(allocator_p parent, size_t item_bytes, size_t items_per_block)
+{
+	pool_p pool = (pool_p) mem_alloc(parent, sizeof(pool_t));
+	if (pool) {
+		if (item_bytes < sizeof(void *)) {
+			item_bytes = sizeof(void *);
+		}
+		pool->parent = parent;
+		pool->item_bytes = ALIGN_UP(item_bytes);
+		pool->items_per_block = items_per_block ? items_per_block : 256;
+		pool->blocks = NULL;
+		pool->free_items = NULL;
+		pool->allocator.alloc = pool_alloc_cb;
+		pool->allocator.realloc = pool_realloc_cb;
+		pool->allocator.free = pool_free_cb;
+		pool->allocator.state = pool;
+	}
+	return pool;
+}
+
+
+void pool_destroy(pool_p pool)
+{
+	if (pool) {
+		size_t block_bytes = sizeof(pool_block_t) + pool->item_bytes * pool->items_per_block;
+
+		while (pool->blocks) {
+			pool_block_p next = pool->blocks->next;
+			mem_free(pool->parent, pool->blocks, block_bytes);
+			pool->blocks = next;
+		}
+		pool->free_items = NULL;
+
+		mem_free(pool->parent, pool, sizeof(pool_t));
+	}
+}
+
+
+void *pool_alloc(pool_p pool)
+{
+	void *item = pool->free_items;
+
+	if (!item) {
+		unsigned int i;
+		pool_block_p block = (pool_block_p) mem_alloc(pool->parent,
+				sizeof(pool_block_t) + pool->item_bytes * pool->items_per_block);
+		if (!block) {
+			return NULL;
+		}
+		block->next = pool->blocks;
+		pool->blocks = block;
+
+		/* put all the items of the new block onto the free list */
+		for (i = pool->items_per_block; i > 0; --i) {
+			void *p = block->data + pool->item_bytes * (i - 1);
+			*(void **) p = pool->free_items;
+			pool->free_items = p;
+		}
+		item = pool->free_items;
+	}
+
+	pool->free_items = *(void **) item;
+	return item;
+}
+
+
+void pool_free(pool_p pool, void *item)
+{
+	if (item) {
+		*(void **) item = pool->free_items;
+		pool->free_items = item;
+	}
+}
+
+
+allocator_p pool_allocator(pool_p pool)
+{
+	return &pool->allocator;
+}
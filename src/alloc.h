@@ -0,0 +1,174 @@
+#ifndef _ALLOC_H_
+#define _ALLOC_H_
+
+#include <stdlib.h>
+
+
+/*
+ * Allocator handle.
+ *
+ * Each function gets state as its first argument. The sizes of the blocks
+ * are passed back on realloc and free, so that allocators need not
+ * remember them.
+ *
+ * Wherever an allocator_p is taken, NULL stands for malloc, realloc and free.
+ */
+typedef struct s_allocator
+{
+	void *(*alloc)(void *state, size_t bytes);
+	void *(*realloc)(void *state, void *ptr, size_t old_bytes, size_t bytes);
+	void (*free)(void *state, void *ptr, size_t bytes);
+
+	void *state;
+}
+allocator_t, *allocator_p;
+
+
+/*
+ * Allocate bytes from the allocator.
+ *
+ * Returns NULL if failed.
+ */
+void *mem_alloc(allocator_p a, size_t bytes);
+
+
+/*
+ * Allocate n * bytes from the allocator, all set to zero.
+ *
+ * Returns NULL if failed.
+ */
+void *mem_calloc(allocator_p a, size_t n, size_t bytes);
+
+
+/*
+ * Resize the block of old_bytes at ptr to bytes, keeping its content.
+ *
+ * Returns NULL if failed, in which case the block is untouched.
+ */
+void *mem_realloc(allocator_p a, void *ptr, size_t old_bytes, size_t bytes);
+
+
+/*
+ * Give the block of bytes at ptr back to the allocator.
+ */
+void mem_free(allocator_p a, void *ptr, size_t bytes);
+
+
+
+/*
+ * Arena, a.k.a. bump allocator.
+ *
+ * Memory is handed out from large blocks and given back all at once,
+ * by resetting the arena or rolling it back to a mark. The blocks are kept
+ * for later allocations, so an arena which is used the same way again and
+ * again stops allocating from its parent.
+ */
+typedef struct s_arena *arena_p;
+
+
+/*
+ * Position in an arena, see arena_mark.
+ */
+typedef struct s_arena_mark
+{
+	void *block;
+	size_t used;
+}
+arena_mark_t;
+
+
+/*
+ * Create an arena getting blocks of at least block_bytes from parent.
+ *
+ * NOTE: the arena created by this function MUST be destroyed by the caller,
+ * using arena_destroy.
+ */
+arena_p arena_create(allocator_p parent, size_t block_bytes);
+
+
+/*
+ * Destroy the arena, giving all its blocks back to the parent.
+ */
+void arena_destroy(arena_p arena);
+
+
+/*
+ * Allocate bytes from the arena, aligned for any type.
+ *
+ * Returns NULL if failed.
+ */
+void *arena_alloc(arena_p arena, size_t bytes);
+
+
+/*
+ * Get the current position of the arena.
+ */
+arena_mark_t arena_mark(arena_p arena);
+
+
+/*
+ * Give back everything allocated since the mark was got.
+ */
+void arena_reset_to(arena_p arena, arena_mark_t mark);
+
+
+/*
+ * Give back everything allocated from the arena.
+ */
+void arena_reset(arena_p arena);
+
+
+/*
+ * Get the allocator handle of the arena.
+ *
+ * Freeing through it only gives memory back if it is the last allocation.
+ */
+allocator_p arena_allocator(arena_p arena);
+
+
+
+/*
+ * Pool of fixed-size items.
+ */
+typedef struct s_pool *pool_p;
+
+
+/*
+ * Create a pool of items of item_bytes, getting them from parent
+ * items_per_block at a time.
+ *
+ * NOTE: the pool created by this function MUST be destroyed by the caller,
+ * using pool_destroy.
+ */
+pool_p pool_create(allocator_p parent, size_t item_bytes, size_t items_per_block);
+
+
+/*
+ * Destroy the pool, giving all its blocks back to the parent.
+ */
+void pool_destroy(pool_p pool);
+
+
+/*
+ * Get an item from the pool.
+ *
+ * Returns NULL if failed.
+ */
+void *pool_alloc(pool_p pool);
+
+
+/*
+ * Put the item back into the pool.
+ */
+void pool_free(pool_p pool, void *item);
+
+
+/*
+ * Get the allocator handle of the pool.
+ *
+ * Allocating more than the item size through it fails.
+ */
+allocator_p pool_allocator(pool_p pool);
+
+
+#endif /* _ALLOC_H_ */
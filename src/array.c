@@ -1,6 +1,7 @@
 #include "array.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 
 #define MIN_INIT_SIZE 32
@@ -8,8 +9,11 @@
 
 typedef struct s_array
 {
-	/* all the pointers */
-	void **items;
+	allocator_p alloc;
+
+	/* all the items, item_bytes each */
+	char *items;
+	size_t item_bytes;
 	
 	/* allocated size */
 	size_t n;
@@ -20,23 +24,46 @@ typedef struct s_array
 array_t;
 
 
+#define ITEM(array, index) ((array)->items + (array)->item_bytes * (index))
+
+
 array_p array_create(size_t init_size)
 {
-	array_p array = (array_p) malloc(sizeof(array_t));
+	return array_create_typed_with(NULL, sizeof(void *), init_size);
+}
+
+
+array_p array_create_with(allocator_p a, size_t init_size)
+{
+	return array_create_typed_with(a, sizeof(void *), init_size);
+}
+
+
+array_p array_create_typed(size_t item_bytes, size_t init_size)
+{
+	return array_create_typed_with(NULL, item_bytes, init_size);
+}
+
+
+array_p array_create_typed_with(allocator_p a, size_t item_bytes, size_t init_size)
+{
+	array_p array = (array_p) mem_alloc(a, sizeof(array_t));
 	if (array) {
-		void **items = NULL;
+		char *items = NULL;
 		
 		if (init_size < MIN_INIT_SIZE) {
 			init_size = MIN_INIT_SIZE;
 		}
 
-		items = (void **) calloc(init_size, sizeof(void *));
+		items = (char *) mem_alloc(a, item_bytes * init_size);
 		if (!items) {
-			free(array);
+			mem_free(a, array, sizeof(array_t));
 			return NULL;
 		}
 
+		array->alloc = a;
 		array->items = items;
+		array->item_bytes = item_bytes;
 		array->n = init_size;
 		array->size = 0;
 	}
@@ -47,56 +74,78 @@ array_p array_create(size_t init_size)
 void array_destroy(array_p array)
 {
 	if (array) {
-		free(array->items);
+		allocator_p a = array->alloc;
+
+		mem_free(a, array->items, array->item_bytes * array->n);
 		array->items = NULL;
 
-		free(array);
+		mem_free(a, array, sizeof(array_t));
 	}
 }
 
 
-static int ensure_capacity(array_p array)
+int array_reserve(array_p array, size_t n)
 {
-	unsigned int i = 0;
-	size_t size = array->size;
-	size_t n = array->n, new_n = 0;
-	void **items = NULL, **new_items = NULL;
+	char *new_items = NULL;
 
-	if (size != n) {
-		/* need not enlarge */
+	if (n <= array->n) {
 		return 0;
 	}
 
-	if (n >> (sizeof(size_t) * 8 - 1)) {
+	if (n > ((size_t) -1) / array->item_bytes) {
 		/* too large */
 		return -1;
 	}
 
-	new_n = n << 1;
-	new_items = (void **) calloc(new_n, sizeof(void *));
+	new_items = (char *) mem_realloc(array->alloc, array->items,
+			array->item_bytes * array->n, array->item_bytes * n);
 	if (!new_items) {
 		return -1;
 	}
 
-	items = array->items;
-	for (i = 0; i < size; ++i) {
-		new_items[i] = items[i];
-	}
-
 	array->items = new_items;
-	array->n = new_n;
-	free(items);
+	array->n = n;
 	return 0;
 }
 
 
+static inline int ensure_capacity(array_p array)
+{
+	size_t n = array->n;
+
+	if (array->size != n) {
+		/* need not enlarge */
+		return 0;
+	}
+
+	if (n >> (sizeof(size_t) * 8 - 1)) {
+		/* too large */
+		return -1;
+	}
+
+	return array_reserve(array, n << 1);
+}
+
+
 int array_append(array_p array, void *item)
 {
 	if (ensure_capacity(array)) {
 		return -1;
 	}
 
-	array->items[array->size++] = item;
+	((void **) array->items)[array->size++] = item;
+
+	return 0;
+}
+
+
+int array_push(array_p array, const void *item)
+{
+	if (ensure_capacity(array)) {
+		return -1;
+	}
+
+	memcpy(ITEM(array, array->size++), item, array->item_bytes);
 
 	return 0;
 }
@@ -105,7 +154,7 @@ int array_append(array_p array, void *item)
 int array_pop(array_p array, void **item)
 {
 	size_t size = array->size;
-	void **items = array->items;
+	void **items = (void **) array->items;
 
 	if (!size--) {
 		return -1;
@@ -128,27 +177,45 @@ int array_at(array_p array, unsigned int index, void **item)
 		return -1;
 	}
 
-	*item = array->items[index];
+	*item = ((void **) array->items)[index];
 
 	return 0;
 }
 
 
-size_t array_size(array_p array)
+void *array_get(array_p array, unsigned int index)
 {
-	return array->size;
+	return index < array->size ? ITEM(array, index) : NULL;
 }
 
 
-void array_to_list(array_p array, void **list)
+void *array_data(array_p array)
 {
-	unsigned int i;
-	size_t size = array->size;
-	void **items = array->items;
+	return array->items;
+}
+
 
-	for (i = 0; i < size; ++i) {
-		list[i] = items[i];
+void array_truncate(array_p array, size_t size)
+{
+	if (size < array->size) {
+		array->size = size;
 	}
 }
 
 
+void array_clear(array_p array)
+{
+	array->size = 0;
+}
+
+
+size_t array_size(array_p array)
+{
+	return array->size;
+}
+
+
+void array_to_list(array_p array, void **list)
+{
+	memcpy(list, array->items, array->item_bytes * array->size);
+}
@@ -3,9 +3,14 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 
 /*
- * An array only stores pointers.
+ * An array stores pointers, or, if created typed, items of a fixed size by value.
+ *
+ * array_append, array_pop and array_at are for arrays of pointers;
+ * array_push and array_get work with both.
  */
 typedef struct s_array *array_p;
 
@@ -21,6 +26,29 @@ typedef struct s_array *array_p;
 array_p array_create(size_t init_size);
 
 
+/*
+ * Same as array_create, with all the memory of the array coming from the allocator.
+ */
+array_p array_create_with(allocator_p a, size_t init_size);
+
+
+/*
+ * Create a new array storing items of item_bytes each by value, with suggested initial size.
+ *
+ * Returns: a pointer to the new created array if succeed;
+ *          NULL if failed.
+ *
+ * NOTE: the array_p MUST be freed by the caller using array_destroy.
+ */
+array_p array_create_typed(size_t item_bytes, size_t init_size);
+
+
+/*
+ * Same as array_create_typed, with all the memory of the array coming from the allocator.
+ */
+array_p array_create_typed_with(allocator_p a, size_t item_bytes, size_t init_size);
+
+
 /*
  * Release the array.
  */
@@ -36,6 +64,15 @@ void array_destroy(array_p array);
 int array_append(array_p array, void *item);
 
 
+/*
+ * Copy the item at *item into the array.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int array_push(array_p array, const void *item);
+
+
 /*
  * Pop out the last item.
  *
@@ -56,6 +93,46 @@ int array_pop(array_p array, void **item);
 int array_at(array_p array, unsigned int index, void **item);
 
 
+/*
+ * Get the address of the item at the given index.
+ *
+ * It stays valid until the array grows.
+ *
+ * Returns NULL if array index out of range.
+ */
+void *array_get(array_p array, unsigned int index);
+
+
+/*
+ * Get the address of all the items, which are stored contiguously.
+ *
+ * It stays valid until the array grows.
+ */
+void *array_data(array_p array);
+
+
+/*
+ * Make sure the array has space for n items, so that it needs not grow
+ * until it has more than n items.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int array_reserve(array_p array, size_t n);
+
+
+/*
+ * Drop the items beyond size, if any.
+ */
+void array_truncate(array_p array, size_t size);
+
+
+/*
+ * Remove all the items, keeping the allocated space for later appending.
+ */
+void array_clear(array_p array);
+
+
 /*
  * Get the size of the array.
  */
@@ -0,0 +1,507 @@
+#include "batch.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+/*
+ * AVX-512 comes with FMA, which would fuse the products and sums of the
+ * distances into results different from point_dist's.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize ("fp-contract=off")
+#elif defined(__clang__)
+#pragma clang fp contract(off)
+#endif
+
+
+/*
+ * The kernels of an instruction set.
+ */
+typedef struct s_kernels
+{
+	const char *name;
+
+	void (*dist)(const double *xs, const double *ys, size_t n, double px, double py, double *dist);
+	size_t (*within)(const double *xs, const double *ys, size_t n, double px, double py, double thre,
+			unsigned int *index);
+	void (*contains)(const double *xs, const double *ys, size_t n, const double *bounds, unsigned char *inside);
+	void (*rect_dist)(const double *xl, const double *xu, const double *yl, const double *yu, size_t n,
+			double px, double py, double *dist);
+}
+kernels_t, *kernels_p;
+
+
+/*
+ * One point at a time, for the processors without vectors, and the tails of the others.
+ *
+ * bounds of a rect are its x lower, x upper, y lower and y upper.
+ */
+
+static inline double dist_one(double x, double y, double px, double py)
+{
+	double dx = x - px, dy = y - py;
+
+	return dx * dx + dy * dy;
+}
+
+
+static inline double axis_dist(double lower, double upper, double p)
+{
+	return p < lower ? lower - p : p > upper ? p - upper : 0.0;
+}
+
+
+static void dist_scalar(const double *xs, const double *ys, size_t n, double px, double py, double *dist)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		dist[i] = dist_one(xs[i], ys[i], px, py);
+	}
+}
+
+
+static size_t within_scalar(const double *xs, const double *ys, size_t n, double px, double py, double thre,
+		unsigned int *index)
+{
+	size_t i, k = 0;
+
+	for (i = 0; i < n; ++i) {
+		if (dist_one(xs[i], ys[i], px, py) <= thre) {
+			index[k++] = (unsigned int) i;
+		}
+	}
+	return k;
+}
+
+
+static void contains_scalar(const double *xs, const double *ys, size_t n, const double *bounds,
+		unsigned char *inside)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		inside[i] = xs[i] >= bounds[0] && xs[i] <= bounds[1] && ys[i] >= bounds[2] && ys[i] <= bounds[3];
+	}
+}
+
+
+static void rect_dist_scalar(const double *xl, const double *xu, const double *yl, const double *yu, size_t n,
+		double px, double py, double *dist)
+{
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		double dx = axis_dist(xl[i], xu[i], px), dy = axis_dist(yl[i], yu[i], py);
+		dist[i] = dx * dx + dy * dy;
+	}
+}
+
+
+static const kernels_t scalar_kernels = {
+	"scalar", dist_scalar, within_scalar, contains_scalar, rect_dist_scalar
+};
+
+
+#ifdef BATCH_X86
+
+/*
+ * Append the indexes base + j of the bits j set in mask.
+ */
+static inline size_t append_bits(unsigned int mask, size_t base, unsigned int *index, size_t k)
+{
+	while (mask) {
+		index[k++] = (unsigned int) (base + __builtin_ctz(mask));
+		mask &= mask - 1;
+	}
+	return k;
+}
+
+
+/*
+ * SSE2, 2 points at a time.
+ */
+
+__attribute__((target("sse2")))
+static inline __m128d dist_sse2_vec(const double *xs, const double *ys, __m128d px, __m128d py)
+{
+	__m128d dx = _mm_sub_pd(_mm_loadu_pd(xs), px);
+	__m128d dy = _mm_sub_pd(_mm_loadu_pd(ys), py);
+
+	return _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy));
+}
+
+
+__attribute__((target("sse2")))
+static void dist_sse2(const double *xs, const double *ys, size_t n, double px, double py, double *dist)
+{
+	size_t i;
+	__m128d vx = _mm_set1_pd(px), vy = _mm_set1_pd(py);
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		_mm_storeu_pd(dist + i, dist_sse2_vec(xs + i, ys + i, vx, vy));
+	}
+	dist_scalar(xs + i, ys + i, n - i, px, py, dist + i);
+}
+
+
+__attribute__((target("sse2")))
+static size_t within_sse2(const double *xs, const double *ys, size_t n, double px, double py, double thre,
+		unsigned int *index)
+{
+	size_t i, k = 0;
+	__m128d vx = _mm_set1_pd(px), vy = _mm_set1_pd(py), vt = _mm_set1_pd(thre);
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		unsigned int mask = _mm_movemask_pd(_mm_cmple_pd(dist_sse2_vec(xs + i, ys + i, vx, vy), vt));
+		k = append_bits(mask, i, index, k);
+	}
+	for (; i < n; ++i) {
+		if (dist_one(xs[i], ys[i], px, py) <= thre) {
+			index[k++] = (unsigned int) i;
+		}
+	}
+	return k;
+}
+
+
+__attribute__((target("sse2")))
+static void contains_sse2(const double *xs, const double *ys, size_t n, const double *bounds,
+		unsigned char *inside)
+{
+	size_t i;
+	__m128d xl = _mm_set1_pd(bounds[0]), xu = _mm_set1_pd(bounds[1]);
+	__m128d yl = _mm_set1_pd(bounds[2]), yu = _mm_set1_pd(bounds[3]);
+
+	for (i = 0; i + 2 <= n; i += 2) {
+		__m128d x = _mm_loadu_pd(xs + i), y = _mm_loadu_pd(ys + i);
+		__m128d in = _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(x, xl), _mm_cmple_pd(x, xu)),
+				_mm_and_pd(_mm_cmpge_pd(y, yl), _mm_cmple_pd(y, yu)));
+		unsigned int mask = _mm_movemask_pd(in);
+
+		inside[i] = mask & 1;
+		inside[i + 1] = (mask >> 1) & 1;
+	}
+	contains_scalar(xs + i, ys + i, n - i, bounds, inside + i);
+}
+
+
+__attribute__((target("sse2")))
+static void rect_dist_sse2(const double *xl, const double *xu, const double *yl, const double *yu, size_t n,
+		double px, double py, double *dist)
+{
+	size_t i;
+	__m128d vx = _mm_set1_pd(px), vy = _mm_set1_pd(py), zero = _mm_setzero_pd();
+
+	/* one of the two differences is 0 at most, so their sum is exact */
+	for (i = 0; i + 2 <= n; i += 2) {
+		__m128d dx = _mm_add_pd(_mm_max_pd(_mm_sub_pd(_mm_loadu_pd(xl + i), vx), zero),
+				_mm_max_pd(_mm_sub_pd(vx, _mm_loadu_pd(xu + i)), zero));
+		__m128d dy = _mm_add_pd(_mm_max_pd(_mm_sub_pd(_mm_loadu_pd(yl + i), vy), zero),
+				_mm_max_pd(_mm_sub_pd(vy, _mm_loadu_pd(yu + i)), zero));
+
+		_mm_storeu_pd(dist + i, _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)));
+	}
+	rect_dist_scalar(xl + i, xu + i, yl + i, yu + i, n - i, px, py, dist + i);
+}
+
+
+static const kernels_t sse2_kernels = {
+	"sse2", dist_sse2, within_sse2, contains_sse2, rect_dist_sse2
+};
+
+
+/*
+ * AVX2, 4 points at a time.
+ */
+
+__attribute__((target("avx2")))
+static inline __m256d dist_avx2_vec(const double *xs, const double *ys, __m256d px, __m256d py)
+{
+	__m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs), px);
+	__m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys), py);
+
+	return _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+}
+
+
+__attribute__((target("avx2")))
+static void dist_avx2(const double *xs, const double *ys, size_t n, double px, double py, double *dist)
+{
+	size_t i;
+	__m256d vx = _mm256_set1_pd(px), vy = _mm256_set1_pd(py);
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		_mm256_storeu_pd(dist + i, dist_avx2_vec(xs + i, ys + i, vx, vy));
+	}
+	dist_scalar(xs + i, ys + i, n - i, px, py, dist + i);
+}
+
+
+__attribute__((target("avx2")))
+static size_t within_avx2(const double *xs, const double *ys, size_t n, double px, double py, double thre,
+		unsigned int *index)
+{
+	size_t i, k = 0;
+	__m256d vx = _mm256_set1_pd(px), vy = _mm256_set1_pd(py), vt = _mm256_set1_pd(thre);
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256d le = _mm256_cmp_pd(dist_avx2_vec(xs + i, ys + i, vx, vy), vt, _CMP_LE_OQ);
+		k = append_bits(_mm256_movemask_pd(le), i, index, k);
+	}
+	for (; i < n; ++i) {
+		if (dist_one(xs[i], ys[i], px, py) <= thre) {
+			index[k++] = (unsigned int) i;
+		}
+	}
+	return k;
+}
+
+
+__attribute__((target("avx2")))
+static void contains_avx2(const double *xs, const double *ys, size_t n, const double *bounds,
+		unsigned char *inside)
+{
+	size_t i, j;
+	__m256d xl = _mm256_set1_pd(bounds[0]), xu = _mm256_set1_pd(bounds[1]);
+	__m256d yl = _mm256_set1_pd(bounds[2]), yu = _mm256_set1_pd(bounds[3]);
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256d x = _mm256_loadu_pd(xs + i), y = _mm256_loadu_pd(ys + i);
+		__m256d in = _mm256_and_pd(
+				_mm256_and_pd(_mm256_cmp_pd(x, xl, _CMP_GE_OQ), _mm256_cmp_pd(x, xu, _CMP_LE_OQ)),
+				_mm256_and_pd(_mm256_cmp_pd(y, yl, _CMP_GE_OQ), _mm256_cmp_pd(y, yu, _CMP_LE_OQ)));
+		unsigned int mask = _mm256_movemask_pd(in);
+
+		for (j = 0; j < 4; ++j) {
+			inside[i + j] = (mask >> j) & 1;
+		}
+	}
+	contains_scalar(xs + i, ys + i, n - i, bounds, inside + i);
+}
+
+
+__attribute__((target("avx2")))
+static void rect_dist_avx2(const double *xl, const double *xu, const double *yl, const double *yu, size_t n,
+		double px, double py, double *dist)
+{
+	size_t i;
+	__m256d vx = _mm256_set1_pd(px), vy = _mm256_set1_pd(py), zero = _mm256_setzero_pd();
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256d dx = _mm256_add_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(xl + i), vx), zero),
+				_mm256_max_pd(_mm256_sub_pd(vx, _mm256_loadu_pd(xu + i)), zero));
+		__m256d dy = _mm256_add_pd(_mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(yl + i), vy), zero),
+				_mm256_max_pd(_mm256_sub_pd(vy, _mm256_loadu_pd(yu + i)), zero));
+
+		_mm256_storeu_pd(dist + i, _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)));
+	}
+	rect_dist_scalar(xl + i, xu + i, yl + i, yu + i, n - i, px, py, dist + i);
+}
+
+
+static const kernels_t avx2_kernels = {
+	"avx2", dist_avx2, within_avx2, contains_avx2, rect_dist_avx2
+};
+
+
+/*
+ * AVX-512, 8 points at a time.
+ */
+
+__attribute__((target("avx512f")))
+static inline __m512d dist_avx512_vec(const double *xs, const double *ys, __m512d px, __m512d py)
+{
+	__m512d dx = _mm512_sub_pd(_mm512_loadu_pd(xs), px);
+	__m512d dy = _mm512_sub_pd(_mm512_loadu_pd(ys), py);
+
+	return _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy));
+}
+
+
+__attribute__((target("avx512f")))
+static void dist_avx512(const double *xs, const double *ys, size_t n, double px, double py, double *dist)
+{
+	size_t i;
+	__m512d vx = _mm512_set1_pd(px), vy = _mm512_set1_pd(py);
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		_mm512_storeu_pd(dist + i, dist_avx512_vec(xs + i, ys + i, vx, vy));
+	}
+	dist_scalar(xs + i, ys + i, n - i, px, py, dist + i);
+}
+
+
+__attribute__((target("avx512f")))
+static size_t within_avx512(const double *xs, const double *ys, size_t n, double px, double py, double thre,
+		unsigned int *index)
+{
+	size_t i, k = 0;
+	__m512d vx = _mm512_set1_pd(px), vy = _mm512_set1_pd(py), vt = _mm512_set1_pd(thre);
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__mmask8 le = _mm512_cmp_pd_mask(dist_avx512_vec(xs + i, ys + i, vx, vy), vt, _CMP_LE_OQ);
+		k = append_bits(le, i, index, k);
+	}
+	for (; i < n; ++i) {
+		if (dist_one(xs[i], ys[i], px, py) <= thre) {
+			index[k++] = (unsigned int) i;
+		}
+	}
+	return k;
+}
+
+
+__attribute__((target("avx512f")))
+static void contains_avx512(const double *xs, const double *ys, size_t n, const double *bounds,
+		unsigned char *inside)
+{
+	size_t i, j;
+	__m512d xl = _mm512_set1_pd(bounds[0]), xu = _mm512_set1_pd(bounds[1]);
+	__m512d yl = _mm512_set1_pd(bounds[2]), yu = _mm512_set1_pd(bounds[3]);
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m512d x = _mm512_loadu_pd(xs + i), y = _mm512_loadu_pd(ys + i);
+		__mmask8 in = _mm512_cmp_pd_mask(x, xl, _CMP_GE_OQ);
+
+		in = _mm512_mask_cmp_pd_mask(in, x, xu, _CMP_LE_OQ);
+		in = _mm512_mask_cmp_pd_mask(in, y, yl, _CMP_GE_OQ);
+		in = _mm512_mask_cmp_pd_mask(in, y, yu, _CMP_LE_OQ);
+		for (j = 0; j < 8; ++j) {
+			inside[i + j] = (in >> j) & 1;
+		}
+	}
+	contains_scalar(xs + i, ys + i, n - i, bounds, inside + i);
+}
+
+
+__attribute__((target("avx512f")))
+static void rect_dist_avx512(const double *xl, const double *xu, const double *yl, const double *yu, size_t n,
+		double px, double py, double *dist)
+{
+	size_t i;
+	__m512d vx = _mm512_set1_pd(px), vy = _mm512_set1_pd(py), zero = _mm512_setzero_pd();
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		__m512d dx = _mm512_add_pd(_mm512_max_pd(_mm512_sub_pd(_mm512_loadu_pd(xl + i), vx), zero),
+				_mm512_max_pd(_mm512_sub_pd(vx, _mm512_loadu_pd(xu + i)), zero));
+		__m512d dy = _mm512_add_pd(_mm512_max_pd(_mm512_sub_pd(_mm512_loadu_pd(yl + i), vy), zero),
+				_mm512_max_pd(_mm512_sub_pd(vy, _mm512_loadu_pd(yu + i)), zero));
+
+		_mm512_storeu_pd(dist + i, _mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)));
+	}
+	rect_dist_scalar(xl + i, xu + i, yl + i, yu + i, n - i, px, py, dist + i);
+}
+
+
+static const kernels_t avx512_kernels = {
+	"avx512", dist_avx512, within_avx512, contains_avx512, rect_dist_avx512
+};
+
+#endif /* BATCH_X86 */
+
+
+/* the kernels in use, chosen once */
+static const kernels_t *kernels = &scalar_kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Get the kernels of the named instruction set, if the processor supports it.
+ */
+static const kernels_t *find_kernels(const char *isa)
+{
+#ifdef BATCH_X86
+	__builtin_cpu_init();
+	if (!strcmp(isa, "avx512") && __builtin_cpu_supports("avx512f")) {
+		return &avx512_kernels;
+	}
+	if (!strcmp(isa, "avx2") && __builtin_cpu_supports("avx2")) {
+		return &avx2_kernels;
+	}
+	if (!strcmp(isa, "sse2") && __builtin_cpu_supports("sse2")) {
+		return &sse2_kernels;
+	}
+#endif
+	if (!strcmp(isa, "scalar")) {
+		return &scalar_kernels;
+	}
+	return NULL;
+}
+
+
+static void choose_kernels()
+{
+	const char *isas[] = { "avx512", "avx2", "sse2", "scalar" };
+	unsigned int i;
+
+	for (i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+		const kernels_t *k = find_kernels(isas[i]);
+		if (k) {
+			kernels = k;
+			return;
+		}
+	}
+}
+
+
+static inline const kernels_t *get_kernels()
+{
+	pthread_once(&kernels_once, choose_kernels);
+	return kernels;
+}
+
+
+void batch_dist(const double *xs, const double *ys, size_t n, point_p point, double *dist)
+{
+	get_kernels()->dist(xs, ys, n, point->x, point->y, dist);
+}
+
+
+size_t batch_within(const double *xs, const double *ys, size_t n, point_p point, double thre,
+		unsigned int *index)
+{
+	return get_kernels()->within(xs, ys, n, point->x, point->y, thre, index);
+}
+
+
+void batch_rect_contains(rect_p rect, const double *xs, const double *ys, size_t n, unsigned char *inside)
+{
+	double bounds[4] = { rect->x_itv.lower, rect->x_itv.upper, rect->y_itv.lower, rect->y_itv.upper };
+
+	get_kernels()->contains(xs, ys, n, bounds, inside);
+}
+
+
+void batch_rect_min_dist(const double *x_lower, const double *x_upper,
+		const double *y_lower, const double *y_upper, size_t n, point_p point, double *dist)
+{
+	get_kernels()->rect_dist(x_lower, x_upper, y_lower, y_upper, n, point->x, point->y, dist);
+}
+
+
+const char *batch_isa()
+{
+	return get_kernels()->name;
+}
+
+
+int batch_use(const char *isa)
+{
+	const kernels_t *k = NULL;
+
+	/* choose first, so that the choice doesn't override this one later */
+	get_kernels();
+
+	k = find_kernels(isa);
+	if (!k) {
+		return -1;
+	}
+	kernels = k;
+	return 0;
+}
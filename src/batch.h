@@ -0,0 +1,79 @@
+/* Geometry over batches of points, vectorised for the processor it runs on. */
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include <stdlib.h>
+
+#include "geo.h"
+
+
+/*
+ * The points of a batch are in struct-of-arrays form: the x of point i is
+ * xs[i] and its y is ys[i], so that consecutive points fill a vector register.
+ *
+ * The kernels use the widest of AVX-512, AVX2 and SSE2 the processor supports,
+ * chosen on the first call, and compute exactly what the functions of geo.h
+ * compute for each point: a distance is the same double as point_dist's.
+ */
+
+
+/*
+ * Compute the squared distances from point to the n points.
+ *
+ * dist: receives the distance to each point, MUST have space for n items
+ */
+void batch_dist(const double *xs, const double *ys, size_t n, point_p point, double *dist);
+
+
+/*
+ * Find the points within thre, a squared distance, from point.
+ *
+ * index: receives the indexes of the points found, in increasing order,
+ *        MUST have space for n items
+ *
+ * Returns: the number of points found.
+ */
+size_t batch_within(const double *xs, const double *ys, size_t n, point_p point, double thre,
+		unsigned int *index);
+
+
+/*
+ * Tell which of the n points the rect contains, as rect_contains does.
+ *
+ * inside: receives 1 for each point inside, 0 for the others, MUST have space for n items
+ */
+void batch_rect_contains(rect_p rect, const double *xs, const double *ys, size_t n, unsigned char *inside);
+
+
+/*
+ * Compute the squared distances from point to n rects, as rect_min_dist_to does.
+ *
+ * Rect i is x_lower[i] to x_upper[i] by y_lower[i] to y_upper[i].
+ *
+ * dist: receives the distance to each rect, MUST have space for n items
+ */
+void batch_rect_min_dist(const double *x_lower, const double *x_upper,
+		const double *y_lower, const double *y_upper, size_t n, point_p point, double *dist);
+
+
+/*
+ * Get the name of the instruction set the kernels use: "avx512", "avx2", "sse2" or "scalar".
+ */
+const char *batch_isa();
+
+
+/*
+ * Make the kernels use the instruction set of the name, as batch_isa names it,
+ * e.g. to compare them.
+ *
+ * NOTE: the kernels are switched for all the threads, unsynchronised, so
+ * it MUST NOT be called while any thread is clustering.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if the processor doesn't support it, or it's not built in.
+ */
+int batch_use(const char *isa);
+
+
+#endif /* _BATCH_H_ */
@@ -0,0 +1,365 @@
+/* for strdup */
+#define _POSIX_C_SOURCE 200809L
+
+#include "cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME32_1 0x9E3779B1U
+
+/* points hashed between two scrambles of the accumulators */
+#define SCRAMBLE_POINTS 32
+
+/* seeds of the hash naming a result, and of the one checking it */
+#define SEED_KEY 0
+#define SEED_CHECK 0x5bd1e995
+
+/* labels converted at a time */
+#define LABEL_CHUNK 4096
+
+#define MAGIC "DBSCANL1"
+
+
+/*
+ * Header of a result file, followed by n labels of width bytes each.
+ */
+typedef struct s_cache_header
+{
+	char magic[8];
+	uint64_t n;
+	double eps;
+	uint64_t min_pts;
+	int32_t flags;
+	int32_t clusters;
+	uint64_t check;
+	uint32_t width;
+	uint32_t reserved;
+}
+cache_header_t;
+
+
+typedef struct s_cache
+{
+	char *dir;
+
+	size_t hits;
+	size_t misses;
+}
+cache_t;
+
+
+static inline uint64_t avalanche(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+
+/*
+ * The x and y of each point go to the two accumulators. Each is xored with
+ * a key depending on the position of the point, its two halves are multiplied,
+ * and the other coordinate is added, as XXH3 does with its stripes.
+ */
+uint64_t cache_hash(const double *coords, size_t stride, size_t n, uint64_t seed)
+{
+	size_t i;
+	const char *p = (const char *) coords;
+	uint64_t acc[2];
+
+	stride = stride ? stride : sizeof(double) * 2;
+
+#if defined(__SSE2__)
+	{
+		__m128i vacc = _mm_setzero_si128();
+		__m128i vkey = _mm_set_epi64x((long long) (seed + PRIME64_2), (long long) (seed ^ PRIME64_1));
+		__m128i vstep = _mm_set1_epi64x((long long) PRIME64_3);
+		__m128i vprime = _mm_set1_epi32((int) PRIME32_1);
+
+		for (i = 0; i < n; ++i, p += stride) {
+			__m128i d = _mm_loadu_si128((const __m128i *) p);
+			__m128i dk = _mm_xor_si128(d, vkey);
+			__m128i prod = _mm_mul_epu32(dk, _mm_shuffle_epi32(dk, _MM_SHUFFLE(2, 3, 0, 1)));
+
+			vacc = _mm_add_epi64(vacc, _mm_add_epi64(prod, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2))));
+			vkey = _mm_add_epi64(vkey, vstep);
+
+			if ((i + 1) % SCRAMBLE_POINTS == 0) {
+				__m128i lo, hi;
+
+				vacc = _mm_xor_si128(vacc, _mm_srli_epi64(vacc, 47));
+				lo = _mm_mul_epu32(vacc, vprime);
+				hi = _mm_mul_epu32(_mm_srli_epi64(vacc, 32), vprime);
+				vacc = _mm_add_epi64(lo, _mm_slli_epi64(hi, 32));
+			}
+		}
+		_mm_storeu_si128((__m128i *) acc, vacc);
+	}
+#else
+	{
+		uint64_t key[2] = { seed ^ PRIME64_1, seed + PRIME64_2 };
+		unsigned int j;
+
+		acc[0] = acc[1] = 0;
+		for (i = 0; i < n; ++i, p += stride) {
+			uint64_t d[2];
+
+			memcpy(d, p, sizeof(d));
+			for (j = 0; j < 2; ++j) {
+				uint64_t dk = d[j] ^ key[j];
+
+				acc[j] += (dk & 0xffffffffULL) * (dk >> 32) + d[!j];
+				key[j] += PRIME64_3;
+			}
+
+			if ((i + 1) % SCRAMBLE_POINTS == 0) {
+				for (j = 0; j < 2; ++j) {
+					acc[j] ^= acc[j] >> 47;
+					acc[j] *= PRIME32_1;
+				}
+			}
+		}
+	}
+#endif
+
+	return avalanche(acc[0] ^ avalanche(acc[1] + PRIME64_1) ^ ((uint64_t) n * PRIME64_2));
+}
+
+
+/*
+ * Mix the parameters of the clustering into the hash of the points.
+ */
+static uint64_t mix_params(uint64_t h, double eps, size_t min_pts, int flags)
+{
+	uint64_t bits;
+
+	memcpy(&bits, &eps, sizeof(bits));
+	h = avalanche(h ^ (bits * PRIME64_1));
+	h = avalanche(h ^ ((uint64_t) min_pts * PRIME64_2));
+	h = avalanche(h ^ ((uint64_t) (unsigned int) flags * PRIME64_3));
+	return h;
+}
+
+
+cache_p cache_open(const char *dir)
+{
+	cache_p cache = NULL;
+
+	if (mkdir(dir, 0755) && errno != EEXIST) {
+		return NULL;
+	}
+
+	cache = (cache_p) calloc(1, sizeof(cache_t));
+	if (cache) {
+		cache->dir = strdup(dir);
+		if (!cache->dir) {
+			cache_close(cache);
+			return NULL;
+		}
+	}
+	return cache;
+}
+
+
+void cache_close(cache_p cache)
+{
+	if (cache) {
+		free(cache->dir);
+		cache->dir = NULL;
+
+		free(cache);
+	}
+}
+
+
+void cache_stats(cache_p cache, size_t *hits, size_t *misses)
+{
+	if (hits) {
+		*hits = cache->hits;
+	}
+	if (misses) {
+		*misses = cache->misses;
+	}
+}
+
+
+/*
+ * Read the labels of a result into labels.
+ *
+ * Returns: the numbers of clusters if found;
+ *          -1 if not.
+ */
+static int load(const char *path, cache_header_t *expected, int32_t *labels)
+{
+	size_t i, k, m;
+	cache_header_t header;
+	unsigned char buf[LABEL_CHUNK * sizeof(int32_t)];
+	FILE *file = fopen(path, "rb");
+
+	if (!file) {
+		return -1;
+	}
+
+	if (fread(&header, sizeof(header), 1, file) != 1
+			|| memcmp(header.magic, MAGIC, sizeof(header.magic))
+			|| header.n != expected->n || header.eps != expected->eps
+			|| header.min_pts != expected->min_pts || header.flags != expected->flags
+			|| header.check != expected->check
+			|| (header.width != 1 && header.width != 2 && header.width != 4)) {
+		fclose(file);
+		return -1;
+	}
+
+	for (i = 0; i < header.n; i += m) {
+		m = header.n - i < LABEL_CHUNK ? header.n - i : LABEL_CHUNK;
+		if (fread(buf, header.width, m, file) != m) {
+			fclose(file);
+			return -1;
+		}
+
+		for (k = 0; k < m; ++k) {
+			if (header.width == 1) {
+				labels[i + k] = buf[k];
+			} else if (header.width == 2) {
+				uint16_t v;
+				memcpy(&v, buf + k * 2, 2);
+				labels[i + k] = v;
+			} else {
+				memcpy(&labels[i + k], buf + k * 4, 4);
+			}
+		}
+	}
+
+	fclose(file);
+	return header.clusters;
+}
+
+
+/*
+ * Write the labels as a result, to a temporary file renamed to path,
+ * so that no one ever reads a partial result.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int store(const char *path, cache_header_t *header, const int32_t *labels)
+{
+	size_t i, k, m, len = strlen(path) + 32;
+	int32_t max_label = 0;
+	unsigned char buf[LABEL_CHUNK * sizeof(int32_t)];
+	char *temp = (char *) malloc(len);
+	FILE *file = NULL;
+
+	if (!temp) {
+		return -1;
+	}
+	snprintf(temp, len, "%s.%ld.tmp", path, (long) getpid());
+
+	for (i = 0; i < header->n; ++i) {
+		if (labels[i] > max_label) {
+			max_label = labels[i];
+		}
+	}
+	header->width = max_label <= 0xff ? 1 : max_label <= 0xffff ? 2 : 4;
+
+	file = fopen(temp, "wb");
+	if (!file || fwrite(header, sizeof(*header), 1, file) != 1) {
+		if (file) {
+			fclose(file);
+			unlink(temp);
+		}
+		free(temp);
+		return -1;
+	}
+
+	for (i = 0; i < header->n; i += m) {
+		m = header->n - i < LABEL_CHUNK ? header->n - i : LABEL_CHUNK;
+
+		for (k = 0; k < m; ++k) {
+			if (header->width == 1) {
+				buf[k] = (unsigned char) labels[i + k];
+			} else if (header->width == 2) {
+				uint16_t v = (uint16_t) labels[i + k];
+				memcpy(buf + k * 2, &v, 2);
+			} else {
+				memcpy(buf + k * 4, &labels[i + k], 4);
+			}
+		}
+
+		if (fwrite(buf, header->width, m, file) != m) {
+			fclose(file);
+			unlink(temp);
+			free(temp);
+			return -1;
+		}
+	}
+
+	if (fclose(file) || rename(temp, path)) {
+		unlink(temp);
+		free(temp);
+		return -1;
+	}
+
+	free(temp);
+	return 0;
+}
+
+
+int cache_cluster_labels(cache_p cache, dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	int r;
+	uint64_t key;
+	size_t len = strlen(cache->dir) + 32;
+	char *path = (char *) malloc(len);
+	cache_header_t header = {
+		.n = n,
+		.eps = eps,
+		.min_pts = min_pts,
+		.flags = flags
+	};
+
+	if (!path) {
+		return -1;
+	}
+
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	key = mix_params(cache_hash(coords, stride, n, SEED_KEY), eps, min_pts, flags);
+	header.check = mix_params(cache_hash(coords, stride, n, SEED_CHECK), eps, min_pts, flags);
+	snprintf(path, len, "%s/%016llx.lbl", cache->dir, (unsigned long long) key);
+
+	r = load(path, &header, labels);
+	if (r >= 0) {
+		++cache->hits;
+		free(path);
+		return r;
+	}
+	++cache->misses;
+
+	r = ctx ? dbscan_context_cluster_labels(ctx, coords, stride, n, eps, min_pts, flags, labels)
+		: dbscan_cluster_labels(coords, stride, n, eps, min_pts, flags, labels);
+	if (r >= 0) {
+		/* the result is good even if it can't be stored */
+		header.clusters = r;
+		store(path, &header, labels);
+	}
+
+	free(path);
+	return r;
+}
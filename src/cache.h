@@ -0,0 +1,73 @@
+/* On-disk cache of clustering results. */
+
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dbscan.h"
+
+
+/*
+ * Cache of cluster labels, one file per result in a directory.
+ *
+ * A result is found by a hash of the coordinates together with eps, min_pts
+ * and the flags, and checked against another hash of them when read back.
+ */
+typedef struct s_cache *cache_p;
+
+
+/*
+ * Hash the coordinates of n points, as passed to dbscan_cluster_labels.
+ *
+ * It's a fast non-cryptographic hash, computed with SSE2 where available,
+ * giving the same result without it. Each seed gives a different hash.
+ */
+uint64_t cache_hash(const double *coords, size_t stride, size_t n, uint64_t seed);
+
+
+/*
+ * Open the cache in the directory, creating it if it doesn't exist.
+ *
+ * NOTE: the cache opened by this function MUST be closed by the caller,
+ * using cache_close.
+ */
+cache_p cache_open(const char *dir);
+
+
+/*
+ * Close the cache. The results stay in the directory.
+ */
+void cache_close(cache_p cache);
+
+
+/*
+ * Same as dbscan_context_cluster_labels, but reading the labels from
+ * the cache if the same points were clustered the same way before, and
+ * storing them into it otherwise.
+ *
+ * The labels are stored with 1, 2 or 4 bytes each, as few as the largest
+ * of them needs.
+ *
+ * ctx: the context to cluster in on a miss, or NULL for a temporary one
+ *
+ * Failing to store a result is not an error, the labels being right anyway.
+ *
+ * NOTE: without DBSCAN_CANONICAL, a cached result is a clustering of the points,
+ * but not necessarily the same as clustering them again.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int cache_cluster_labels(cache_p cache, dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+/*
+ * Get the numbers of clusterings found in the cache, and not found.
+ */
+void cache_stats(cache_p cache, size_t *hits, size_t *misses);
+
+
+#endif /* _CACHE_H_ */
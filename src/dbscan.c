@@ -1,13 +1,58 @@
+/* for fileno, ftruncate and fseeko */
+#define _POSIX_C_SOURCE 200809L
+
 #include "dbscan.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "geo.h"
 #include "kdtree.h"
 #include "array.h"
 #include "hashset.h"
 #include "id_gen.h"
+#include "sfc.h"
+#include "nbgraph.h"
+#include "optics.h"
+#include "rho.h"
+#include "strip.h"
+#include "tiles.h"
+#include "unionfind.h"
+#include "alloc.h"
+#include "batch.h"
+
+
+/* points read from a file at a time */
+#define READ_RECORDS 4096
+
+/* bytes each point of a tile takes while the tile is clustered, see dbscan_cluster_file */
+#define TILE_POINT_BYTES 256
+
+/* fewest and most points buffered for each tile before they are spilled */
+#define SPILL_RECORDS_MIN 64
+#define SPILL_RECORDS_MAX 4096
+
+/*
+ * most pointsets whose neighbours are found by scanning all of them instead of
+ * the kd-tree, see index_sets; the scans cost as much as building and walking
+ * the tree at 2000 to 4000 pointsets on AVX2, the denser the later
+ */
+#ifndef SCAN_SETS_MAX
+#define SCAN_SETS_MAX 2048
+#endif
+
+/* seed of the sample of dbscan_sample_labels, so that it is the same from run to run */
+#define SAMPLE_SEED 0x2545f4914f6cdd1dULL
+
+/* flags of run, above the DBSCAN_* ones, for the engines the entry points pick by name */
+#define RUN_CORE 0x100
+#define RUN_SAMPLE 0x200
 
 
 void cpoint_init(cpoint_p cpoint, double x, double y)
@@ -18,6 +63,49 @@ void cpoint_init(cpoint_p cpoint, double x, double y)
 }
 
 
+/*
+ * Where the points come from and where their cluster ids go to.
+ *
+ * Either cpoints is set, or the points are read from coords and the
+ * cluster ids are written to labels.
+ *
+ * A point weighs weights[i] in the min_pts test, or 1 without weights.
+ */
+typedef struct s_source
+{
+	cpoint_p *cpoints;
+
+	/* x of a point, followed by y; stride bytes from one point to the next */
+	const char *coords;
+	size_t stride;
+
+	/* whether coords are int32_t instead of double */
+	int fixed;
+
+	int32_t *labels;
+	const double *weights;
+
+	size_t size;
+}
+source_t, *source_p;
+
+
+static inline void source_point(source_p src, unsigned int i, point_p point)
+{
+	if (src->cpoints) {
+		*point = src->cpoints[i]->point;
+	} else if (src->fixed) {
+		const int32_t *p = (const int32_t *) (src->coords + src->stride * i);
+		point->x = p[0];
+		point->y = p[1];
+	} else {
+		const double *p = (const double *) (src->coords + src->stride * i);
+		point->x = p[0];
+		point->y = p[1];
+	}
+}
+
+
 /*
  * This structure represents a set of cpoint_t with exactly the same coordinates.
  *
@@ -28,38 +116,93 @@ typedef struct s_cpointset
 	/* as a cpoint_t */
 	cpoint_t cpoint;
 
-	/* pointers to all the cpoints it represents */
-	array_p cpoints;
+	/* the source indexes of all the points it represents are members[first, first + count) */
+	unsigned int first;
+	unsigned int count;
+
+	/* the total weight of the points it represents, for the min_pts test */
+	double weight;
 }
 cpointset_t, *cpointset_p;
 
 
 /*
- * Create a pointset representing cpoint.
+ * Set cluster_id of the pointset and all the points it represents.
+ *
+ * The members of a pointset are in increasing order, so the labels of the
+ * points next to each other in the source are written as a whole run.
  */
-static cpointset_p cpointset_create(cpoint_p cpoint)
+static void cpointset_label(cpointset_p cpointset, source_p src, unsigned int *members, unsigned long id)
 {
-	cpointset_p cpointset = (cpointset_p) malloc(sizeof(cpointset_t));
-	if (cpointset) {
-		cpointset->cpoints = array_create(0);
-		if (!cpointset->cpoints) {
-			free(cpointset);
-			return NULL;
+	unsigned int i = cpointset->first, j, k, end = cpointset->first + cpointset->count;
+
+	cpointset->cpoint.cluster_id = id;
+	if (src->cpoints) {
+		for (; i < end; ++i) {
+			src->cpoints[members[i]]->cluster_id = id;
+		}
+		return;
+	}
+
+	while (i < end) {
+		int32_t *labels = src->labels + members[i];
+
+		for (j = i + 1; j < end && members[j] == members[j - 1] + 1; ++j) {
+		}
+		for (k = 0; k < j - i; ++k) {
+			labels[k] = (int32_t) id;
 		}
-		cpointset->cpoint = *cpoint;
+		i = j;
 	}
-	return cpointset;
 }
 
 
-static void cpointset_destroy(cpointset_p cpointset)
+/*
+ * A cluster with its first core point, just for sorting.
+ */
+typedef struct s_cluster_key
 {
-	if (cpointset) {
-		array_destroy(cpointset->cpoints);
-		cpointset->cpoints = NULL;
-		free(cpointset);
-	}
+	unsigned long key;
+	unsigned long id;
+}
+cluster_key_t, *cluster_key_p;
+
+
+static int cmp_key(const void *p1, const void *p2)
+{
+	unsigned long k1 = ((cluster_key_p) p1)->key, k2 = ((cluster_key_p) p2)->key;
+
+	return (k1 > k2) - (k1 < k2);
+}
+
+
+/*
+ * A point with its index in the source, just for sorting.
+ *
+ * It stands for the count points from index on, all the same in the source.
+ */
+typedef struct s_source_item
+{
+	point_t point;
+	unsigned int index;
+	unsigned int count;
+}
+source_item_t, *source_item_p;
+
+
+/*
+ * A point with int32_t coordinates and its index in the source, for a radix sort.
+ *
+ * It stands for the count points from index on, all the same in the source.
+ */
+typedef struct s_fixed_item
+{
+	/* x in the high 32 bits, y in the low ones, biased to sort as unsigned */
+	uint64_t key;
+	unsigned int index;
+	unsigned int count;
 }
+fixed_item_t, *fixed_item_p;
 
 
 /*
@@ -67,19 +210,19 @@ static void cpointset_destroy(cpointset_p cpointset)
  */
 static int cmp(const void *p1, const void *p2)
 {
-	if ((*(point_p *) p1)->x < (*(point_p *) p2)->x) {
+	if (((source_item_p) p1)->point.x < ((source_item_p) p2)->point.x) {
 		return -1;
 	}
 
-	if ((*(point_p *) p1)->x > (*(point_p *) p2)->x) {
+	if (((source_item_p) p1)->point.x > ((source_item_p) p2)->point.x) {
 		return 1;
 	}
 
-	if ((*(point_p *) p1)->y < (*(point_p *) p2)->y) {
+	if (((source_item_p) p1)->point.y < ((source_item_p) p2)->point.y) {
 		return -1;
 	}
 
-	if ((*(point_p *) p1)->y > (*(point_p *) p2)->y) {
+	if (((source_item_p) p1)->point.y > ((source_item_p) p2)->point.y) {
 		return 1;
 	}
 
@@ -88,359 +231,2216 @@ static int cmp(const void *p1, const void *p2)
 
 
 /*
- * Convert cpoint_p * to pointset_p *.
+ * Same as cmp, then by the index, for sorting the members of each pointset in order.
+ */
+static int cmp_index(const void *p1, const void *p2)
+{
+	int r = cmp(p1, p2);
+
+	if (r) {
+		return r;
+	}
+	return (((source_item_p) p1)->index > ((source_item_p) p2)->index)
+			- (((source_item_p) p1)->index < ((source_item_p) p2)->index);
+}
+
+
+/*
+ * Everything a clustering works with, kept from one clustering to the next.
  *
- * This is to avoid duplicated points in the input, which would cause an incorrect result.
+ * The buffers only grow, so once they are large enough for the input,
+ * clustering again allocates (almost) nothing.
+ */
+typedef struct s_dbscan_context
+{
+	allocator_p alloc;
+
+	/* the structures built for a single clustering, given back at its end, see run */
+	arena_p arena;
+
+	id_generator_p gen;
+
+	kdtree_p tree;
+
+	strip_p strip; // for DBSCAN_PLANE_SWEEP
+	nbgraph_p graph; // for DBSCAN_NBGRAPH and the parameter sweep
+
+	hashset_p visited; // maintaining pointers of cpointset_p
+	hashset_p nnset;
+	hashset_p hullset;
+	size_t hashset_n; // visited and nnset are created with this size
+
+	array_p noise;
+	array_p nn; // for knn result
+	array_p nn_; // for knn result while expanding the cluster
+	array_p pairs; // of sampled pointsets within eps of each other
+
+	/* growing buffers, see RESERVE */
+	source_item_t *items;
+	size_t items_n;
+	fixed_item_t *fixed; // for sorting int32_t coordinates by radix
+	size_t fixed_n;
+	fixed_item_t *fixed2;
+	size_t fixed2_n;
+	unsigned int *members;
+	size_t members_n;
+	cpointset_t *sets;
+	size_t sets_n;
+	cpointset_t *sets2; // for reordering sets
+	size_t sets2_n;
+	cpointset_p *cpointsets;
+	size_t cpointsets_n;
+	cpointset_p *nnlist;
+	size_t nnlist_n;
+	point_p *list;
+	size_t list_n;
+	unsigned int *perm;
+	size_t perm_n;
+	char *scratch;
+	size_t scratch_n;
+	double *weights;
+	size_t weights_n;
+	unsigned long *ids;
+	size_t ids_n;
+	unsigned char *core;
+	size_t core_n;
+	unsigned int *stack;
+	size_t stack_n;
+	cluster_key_t *keys;
+	size_t keys_n;
+	dbscan_stats_t *stats;
+	size_t stats_n;
+	point_t *hulls; // the vertices of all the hulls in stats
+	size_t hulls_n;
+	double *xs; // the coordinates of the pointsets, for scanning them
+	size_t xs_n;
+	double *ys;
+	size_t ys_n;
+	unsigned int *found; // the indexes of the pointsets found by a scan
+	size_t found_n;
+
+	/* whether the neighbours are found by scanning xs and ys, not the kd-tree */
+	int scan;
+
+	/* the pointsets in sets of the last clustering */
+	size_t n_sets;
+
+	/* the clusters in stats, and whether they are computed at all */
+	size_t n_stats;
+	int has_stats;
+}
+dbscan_context_t;
+
+
+/*
+ * Make sure the buffer has space for n items of bytes each.
+ *
+ * The content is not kept when it has to be enlarged.
  *
- * NOTE: the returned array, as well as all the elements in the returned array,
- *       MUST be freed and destroyed by the caller!
+ * Returns: 0 if succeed;
+ *         -1 if failed.
  */
-static cpointset_p *convert_points(cpoint_p *cpoints, size_t size, size_t *ret_size)
+static int reserve(allocator_p a, void **buf, size_t *buf_n, size_t n, size_t bytes)
 {
-	unsigned int i, j;
+	void *new_buf = NULL;
 
-	cpoint_p *temp = (cpoint_p *) malloc(sizeof(cpoint_p) * size);
-	cpointset_p *result = (cpointset_p *) calloc(size, sizeof(cpointset_t));
+	if (n <= *buf_n) {
+		return 0;
+	}
 
-	cpoint_p last = NULL; // non-allocated pointer
+	if (n < *buf_n * 2) {
+		n = *buf_n * 2;
+	}
 
-	if (!temp || !result) {
-		free(result);
-		free(temp);
-		*ret_size = 0;
-		return NULL;
+	new_buf = mem_alloc(a, n * bytes);
+	if (!new_buf) {
+		return -1;
 	}
 
-	memcpy(temp, cpoints, sizeof(cpoint_p) * size);
+	mem_free(a, *buf, *buf_n * bytes);
+	*buf = new_buf;
+	*buf_n = n;
+	return 0;
+}
+
 
-	/* first, sort */
-	qsort(temp, size, sizeof(cpoint_p), cmp);
+#define RESERVE(ctx, buf, n) reserve((ctx)->alloc, (void **) &(ctx)->buf, &(ctx)->buf##_n, (n), sizeof(*(ctx)->buf))
 
-	/* then, uniq */
-	j = -1;
-	for (i = 0; i < size; ++i) {
-		if (!last || last->point.x != temp[i]->point.x || last->point.y != temp[i]->point.y) {
-			/* not equal */
-			result[++j] = cpointset_create(temp[i]);
-			if (!result[j]) {
-				for (i = 0; i < j; ++i) {
-					cpointset_destroy(result[i]);
-					result[i] = NULL;
-				}
-				free(result);
-				free(temp);
-				*ret_size = 0;
-				return NULL;
-			}
 
-			last = temp[i];
+dbscan_context_p dbscan_context_create()
+{
+	return dbscan_context_create_with(NULL);
+}
 
-		}
 
-		if (array_append(result[j]->cpoints, temp[i])) {
-			for (i = 0; i <= j; ++i) {
-				cpointset_destroy(result[i]);
-				result[i] = NULL;
-			}
-			free(result);
-			free(temp);
-			*ret_size = 0;
+dbscan_context_p dbscan_context_create_with(allocator_p a)
+{
+	dbscan_context_p ctx = (dbscan_context_p) mem_calloc(a, 1, sizeof(dbscan_context_t));
+	if (ctx) {
+		ctx->alloc = a;
+		ctx->arena = arena_create(a, 0);
+		ctx->gen = id_generator_create_with(a);
+		ctx->tree = kdtree_create_with(a);
+		ctx->strip = strip_create_with(a, 0.0, 0.0);
+		ctx->graph = nbgraph_create_with(a);
+		ctx->hullset = hashset_create_with(a, 0, NULL, NULL);
+		ctx->noise = array_create_with(a, 128);
+		ctx->nn = array_create_with(a, 512);
+		ctx->nn_ = array_create_with(a, 512);
+		ctx->pairs = array_create_typed_with(a, sizeof(unsigned int) * 2, 512);
+
+		if (!ctx->arena || !ctx->gen || !ctx->tree || !ctx->strip || !ctx->graph || !ctx->hullset
+				|| !ctx->noise || !ctx->nn || !ctx->nn_ || !ctx->pairs) {
+			dbscan_context_destroy(ctx);
 			return NULL;
 		}
 	}
+	return ctx;
+}
 
-	free(temp);
 
-	*ret_size = j + 1;
-	return result;
+void dbscan_context_destroy(dbscan_context_p ctx)
+{
+	if (ctx) {
+		allocator_p a = ctx->alloc;
+
+		arena_destroy(ctx->arena);
+		id_generator_destroy(ctx->gen);
+		kdtree_destroy(ctx->tree);
+		strip_destroy(ctx->strip);
+		nbgraph_destroy(ctx->graph);
+		hashset_destroy(ctx->visited);
+		hashset_destroy(ctx->nnset);
+		hashset_destroy(ctx->hullset);
+		array_destroy(ctx->noise);
+		array_destroy(ctx->nn);
+		array_destroy(ctx->nn_);
+		array_destroy(ctx->pairs);
+
+		mem_free(a, ctx->items, sizeof(*ctx->items) * ctx->items_n);
+		mem_free(a, ctx->fixed, sizeof(*ctx->fixed) * ctx->fixed_n);
+		mem_free(a, ctx->fixed2, sizeof(*ctx->fixed2) * ctx->fixed2_n);
+		mem_free(a, ctx->members, sizeof(*ctx->members) * ctx->members_n);
+		mem_free(a, ctx->sets, sizeof(*ctx->sets) * ctx->sets_n);
+		mem_free(a, ctx->sets2, sizeof(*ctx->sets2) * ctx->sets2_n);
+		mem_free(a, ctx->cpointsets, sizeof(*ctx->cpointsets) * ctx->cpointsets_n);
+		mem_free(a, ctx->nnlist, sizeof(*ctx->nnlist) * ctx->nnlist_n);
+		mem_free(a, ctx->list, sizeof(*ctx->list) * ctx->list_n);
+		mem_free(a, ctx->perm, sizeof(*ctx->perm) * ctx->perm_n);
+		mem_free(a, ctx->scratch, ctx->scratch_n);
+		mem_free(a, ctx->weights, sizeof(*ctx->weights) * ctx->weights_n);
+		mem_free(a, ctx->ids, sizeof(*ctx->ids) * ctx->ids_n);
+		mem_free(a, ctx->core, sizeof(*ctx->core) * ctx->core_n);
+		mem_free(a, ctx->stack, sizeof(*ctx->stack) * ctx->stack_n);
+		mem_free(a, ctx->keys, sizeof(*ctx->keys) * ctx->keys_n);
+		mem_free(a, ctx->stats, sizeof(*ctx->stats) * ctx->stats_n);
+		mem_free(a, ctx->hulls, sizeof(*ctx->hulls) * ctx->hulls_n);
+		mem_free(a, ctx->xs, sizeof(*ctx->xs) * ctx->xs_n);
+		mem_free(a, ctx->ys, sizeof(*ctx->ys) * ctx->ys_n);
+		mem_free(a, ctx->found, sizeof(*ctx->found) * ctx->found_n);
+
+		mem_free(a, ctx, sizeof(dbscan_context_t));
+	}
 }
 
 
 /*
- * DBSCAN Algorithm implementation.
+ * Prepare the hashsets for size points.
  *
- * ref: A Density-Based Algorithm for Discovering Clusters in Large Spatial Databases with Noise
- *      Martin Ester, Hans-Peter Kriegel, Jorg Sander, Xiaowei Xu
- *
- *      A Fast Approach to Clustering Datasets using DBSCAN and Pruning Algorithms
- *      S. Vijayalaksmi, M Punithavalli
- *
- *
- * arguments: cpoints	all the points
- *            size		size of the points
- *            eps		eps in the algorithm, not sqrted
- *            min_pts	min pts in the algorithm
- *
- * returns: the clusters num, or -1 if failed
+ * Returns: 0 if succeed;
+ *         -1 if failed.
  */
-int dbscan_cluster(cpoint_p *cpoints, size_t size, double eps, size_t min_pts)
+static int reset_hashsets(dbscan_context_p ctx, size_t size)
 {
-	unsigned int i, j, k;
-	unsigned long next_id = 0;
-	size_t uni_size;
+	if (size > ctx->hashset_n || !ctx->visited || !ctx->nnset) {
+		hashset_destroy(ctx->visited);
+		hashset_destroy(ctx->nnset);
+		ctx->visited = hashset_create_with(ctx->alloc, size, NULL, NULL);
+		ctx->nnset = hashset_create_with(ctx->alloc, size, NULL, NULL);
+		ctx->hashset_n = size;
+
+		if (!ctx->visited || !ctx->nnset) {
+			return -1;
+		}
+		return 0;
+	}
 
-	eps *= eps;
+	hashset_remove_all(ctx->visited);
+	hashset_remove_all(ctx->nnset);
+	return 0;
+}
 
-	cpointset_p *cpointsets = NULL;
-	id_generator_p gen = NULL;
-	kdtree_p tree = NULL;
-	hashset_p visited = NULL; // maintaining pointers of cpoint_p
-	hashset_p nnset = NULL;
-	array_p noise = NULL;
-	cpointset_p *nn = NULL; // for knn result
 
-	/*
-	 * Considering that the input points may have duplicated points,
-	 * this will convert all single points to pointsets.
-	 */
-	cpointsets = convert_points(cpoints, size, &uni_size);
-	if (!cpointsets) {
+/*
+ * Lay ctx->sets out along a Hilbert curve.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int reorder_points(dbscan_context_p ctx, size_t size)
+{
+	unsigned int i;
+
+	if (RESERVE(ctx, sets2, size) || RESERVE(ctx, list, size) || RESERVE(ctx, perm, size)
+			|| reserve(ctx->alloc, (void **) &ctx->scratch, &ctx->scratch_n, SFC_SCRATCH_SIZE(size), 1)) {
 		return -1;
 	}
-	size = uni_size;
 
-	gen = id_generator_create();
-
-	/* create the kd-tree with pointsets, which is used as points */
-	tree = kdtree_create_static((point_p *) cpointsets, size);
+	for (i = 0; i < size; ++i) {
+		ctx->list[i] = &ctx->sets[i].cpoint.point;
+	}
 
-	visited = hashset_create(size, NULL, NULL);
-	nnset = hashset_create(size, NULL, NULL);
+	sfc_order_with(ctx->list, size, SFC_HILBERT, ctx->perm, ctx->scratch);
 
-	/* maintain border points */
-	noise = array_create(128);
+	for (i = 0; i < size; ++i) {
+		ctx->sets2[i] = ctx->sets[ctx->perm[i]];
+	}
 
-#define FREEALL()\
-	{\
-		for (i = 0; i < uni_size; ++i) {\
-			cpointset_destroy(cpointsets[i]);\
-			cpointsets[i] = NULL;\
-		}\
-		free(cpointsets); cpointsets = NULL;\
-		id_generator_destroy(gen); gen = NULL;\
-		kdtree_destroy(tree); tree = NULL;\
-		hashset_destroy(visited); visited = NULL;\
-		hashset_destroy(nnset); nnset = NULL;\
-		array_destroy(noise); noise = NULL;\
-		free(nn); nn = NULL;\
+	/*
+	 * copied back rather than swapped, so that the pointsets stay where they
+	 * are: the hulls, and the memory taken for them, depend on their addresses,
+	 * and clustering the same points again must take none
+	 */
+	for (i = 0; i < size; ++i) {
+		ctx->sets[i] = ctx->sets2[i];
 	}
+	return 0;
+}
 
-	if (!tree || !gen || !visited || !nnset || !noise) {
-		FREEALL();
+
+/*
+ * Collapse the runs of the same point in the source of int32_t coordinates,
+ * and sort them as cmp_index does, by radix, into ctx->items.
+ *
+ * Returns: the number of the runs if succeed;
+ *          -1 if failed.
+ */
+static long sort_fixed(dbscan_context_p ctx, source_p src)
+{
+	unsigned int i, m = 0, shift;
+	size_t size = src->size;
+	fixed_item_t *from = NULL, *to = NULL, *temp = NULL; // non-allocated pointers
+
+	if (RESERVE(ctx, fixed, size) || RESERVE(ctx, fixed2, size)) {
 		return -1;
 	}
+	from = ctx->fixed;
+	to = ctx->fixed2;
 
-	/* traverse all points, */
 	for (i = 0; i < size; ++i) {
-		size_t n = 0, total = 0;
-		cpointset_p point = cpointsets[i]; // notice, point is a pointset
+		const int32_t *p = (const int32_t *) (src->coords + src->stride * i);
+		uint64_t key = (uint64_t) ((uint32_t) p[0] ^ 0x80000000U) << 32 | ((uint32_t) p[1] ^ 0x80000000U);
 
-		/* , if the point has not been visited yet */
-		if (hashset_contains(visited, &point, sizeof(cpointset_p))) {
+		if (m && key == from[m - 1].key) {
+			++from[m - 1].count;
 			continue;
 		}
-		hashset_add(visited, &point, sizeof(cpointset_p));
+		from[m].key = key;
+		from[m].index = i;
+		from[m].count = 1;
+		++m;
+	}
 
-		/* find knn points in the kd-tree */
-		nn = (cpointset_p *) kdtree_k_nearest_neighbour(tree, (point_p) point, eps, &n);
+	/* a byte at a time from the lowest, being stable, skipping the bytes all the keys share */
+	for (shift = 0; shift < 64; shift += 8) {
+		size_t counts[256] = { 0 }, total = 0;
+		unsigned int b;
 
-		for (j = 0; j < n; ++j) {
-			total += array_size(nn[j]->cpoints);
+		for (i = 0; i < m; ++i) {
+			++counts[(from[i].key >> shift) & 0xff];
 		}
+		if (!m || counts[(from[0].key >> shift) & 0xff] == m) {
+			continue;
+		}
+		for (b = 0; b < 256; ++b) {
+			size_t c = counts[b];
+			counts[b] = total;
+			total += c;
+		}
+		for (i = 0; i < m; ++i) {
+			to[counts[(from[i].key >> shift) & 0xff]++] = from[i];
+		}
+		temp = from;
+		from = to;
+		to = temp;
+	}
 
-		if (total < min_pts) {
-			/* border point, add to noise */
-			array_append(noise, point);
-
-		} else {
-			/* core point, form a new cluster */
-			size_t n_hulls = 0;
-			cpointset_p *hulls = NULL, *new_hulls = NULL, *nnlist = NULL;
-			hashset_p hullset = NULL;
-
-#define FREEINNER()\
-			{\
-				free(hulls); hulls = NULL;\
-				free(new_hulls); new_hulls = NULL;\
-				free(nnlist); nnlist = NULL;\
-				hashset_destroy(hullset); hullset = NULL;\
-			}
-
-			/* form a new cluster and set cluster_id of all points */
-			next_id = id_generator_next_id(gen);
-			point->cpoint.cluster_id = next_id;
-			for (j = 0; j < array_size(point->cpoints); ++j) {
-				cpoint_p cp = NULL;
-				array_at(point->cpoints, j, (void **) &cp);
-				cp->cluster_id = next_id;
-			}
-
-			/* add all points found in knn into the hashset for finding convex hulls */
-			hashset_remove_all(nnset);
-			for (j = 1; j < n; ++j) {
-				hashset_add(nnset, &nn[j], sizeof(cpointset_p));
-			}
-
-			nnlist = (cpointset_p *) malloc(sizeof(cpointset_p) * (n - 1));
-			if (!nnlist) {
-				FREEINNER();
-				FREEALL();
-				return -1;
-			}
-			hashset_to_list(nnset, nnlist, sizeof(cpointset_p));
-			hulls = (cpointset_p *) convex_hulls((point_p *) nnlist, n - 1, &n_hulls);
-			free(nnlist);
-			nnlist = NULL;
-
-			hullset = hashset_create(0, NULL, NULL);
-			if (!hulls || !hullset) {
-				FREEINNER();
-				FREEALL();
-				return -1;
-			}
-			for (j = 0; j < n_hulls; ++j) {
-				hashset_add(hullset, &hulls[j], sizeof(point_p));
-			}
-
-			/* expand the current cluster */
-			while (hashset_size(nnset)) {
-				size_t n = 0, total = 0;
-				cpointset_p p = NULL; // non-allocated pointer
-
-				/* traverse current cluster, */
-				if (hashset_pop(nnset, &p, sizeof(cpointset_p))) {
-					FREEINNER();
-					FREEALL();
-					return -1;
-				}
+	for (i = 0; i < m; ++i) {
+		ctx->items[i].point.x = (int32_t) ((uint32_t) (from[i].key >> 32) ^ 0x80000000U);
+		ctx->items[i].point.y = (int32_t) ((uint32_t) from[i].key ^ 0x80000000U);
+		ctx->items[i].index = from[i].index;
+		ctx->items[i].count = from[i].count;
+	}
+	return (long) m;
+}
 
-				/* , if the point is not visited, */
-				if (!hashset_contains(visited, &p, sizeof(cpointset_p))) {
-					hashset_add(visited, &p, sizeof(cpointset_p));
 
-					/* , and if the point is in the convex hulls */
-					if (hashset_contains(hullset, &p, sizeof(cpointset_p))) {
+/*
+ * Convert the source points to pointsets, in ctx->sets.
+ *
+ * This is to avoid duplicated points in the input, which would cause an incorrect result.
+ *
+ * ctx->members is set to the source indexes of the points, grouped by pointset,
+ * in increasing order within each.
+ *
+ * With DBSCAN_SFC_ORDER in flags, the pointsets are laid out along a space-filling
+ * curve instead of the x-then-y order, so that points close in space are also
+ * close in memory. The members of each pointset map it back to the source order.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int convert_points(dbscan_context_p ctx, source_p src, int flags, size_t *ret_size)
+{
+	unsigned int i, j, k, m = 0;
+	size_t size = src->size, uni_size = 0;
+	source_item_t *temp = NULL;
+	cpointset_t *result = NULL;
 
-						/* as before, find knn points */
-						cpointset_p *nn_ = (cpointset_p *) kdtree_k_nearest_neighbour(tree, (point_p) p, eps, &n);
-						for (j = 0; j < n; ++j) {
-							total += array_size(nn_[j]->cpoints);
-						}
+	*ret_size = 0;
+	ctx->n_sets = 0;
 
-						if (total >= min_pts) {
-							/* core point, continue expanding */
-							for (k = 0; k < n; ++k) {
-								hashset_add(nnset, &nn_[k], sizeof(cpointset_p));
-							}
-						}
-						free(nn_);
-						nn_ = NULL;
+	if (RESERVE(ctx, items, size) || RESERVE(ctx, members, size)) {
+		return -1;
+	}
+	temp = ctx->items;
 
-						nnlist = (cpointset_p *) malloc(sizeof(cpointset_p) * hashset_size(nnset));
-						if (!nnlist) {
-							FREEINNER();
-							FREEALL();
-							return -1;
-						}
+	/*
+	 * first, take the runs of the same point in the source as a whole,
+	 * as a device staying still gives, so that only the runs are sorted
+	 */
+	if (src->fixed) {
+		long r = sort_fixed(ctx, src);
+		if (r < 0) {
+			return -1;
+		}
+		m = (unsigned int) r;
 
-						/* find the new convex hulls */
-						hashset_to_list(nnset, nnlist, sizeof(cpointset_p));
-						new_hulls = (cpointset_p *) convex_hulls((point_p *) nnlist, hashset_size(nnset), &n_hulls);
-						free(nnlist);
-						nnlist = NULL;
-
-						free(hulls);
-						hulls = new_hulls;
-						new_hulls = NULL;
-
-						hashset_remove_all(hullset);
-						for (j = 0; j < n_hulls; ++j) {
-							hashset_add(hullset, &hulls[j], sizeof(point_p));
-						}
-					}
-				}
+	} else {
+		for (i = 0; i < size; ++i) {
+			point_t point;
 
-				/* put current point into the current cluster while expanding current cluster */
-				if (p->cpoint.cluster_id == 0) {
-					p->cpoint.cluster_id = next_id;
-					for (j = 0; j < array_size(p->cpoints); ++j) {
-						cpoint_p cp = NULL;
-						array_at(p->cpoints, j, (void **) &cp);
-						cp->cluster_id = next_id;
-					}
-				}
-				/* else, p->cpoint.cluster_id should be equal to next_id */
+			source_point(src, i, &point);
+			if (m && point.x == temp[m - 1].point.x && point.y == temp[m - 1].point.y) {
+				++temp[m - 1].count;
+				continue;
 			}
+			temp[m].point = point;
+			temp[m].index = i;
+			temp[m].count = 1;
+			++m;
+		}
 
-			FREEINNER();
+		/* then, sort, temp being NULL if there are no points */
+		if (m) {
+			qsort(temp, m, sizeof(source_item_t), cmp_index);
 		}
+	}
 
-		free(nn);
-		nn = NULL;
+	for (i = 0; i < m; ++i) {
+		if (!i || cmp(&temp[i - 1], &temp[i])) {
+			++uni_size;
+		}
 	}
 
-	/* collect the noise (outliers), put them into new clusters */
-	if (array_size(noise)) {
-		array_p noise2 = array_create(array_size(noise));
+	if (RESERVE(ctx, sets, uni_size)) {
+		return -1;
+	}
+	result = ctx->sets;
 
-		for (i = 0; i < array_size(noise); ++i) {
-			cpoint_p point = NULL; // non-allocated pointer
+	/* then, uniq, the members of each pointset being in increasing order */
+	j = -1;
+	k = 0;
+	for (i = 0; i < m; ++i) {
+		unsigned int r, end = temp[i].index + temp[i].count;
 
-			array_at(noise, i, (void **) &point);
-			if (!point->cluster_id) {
-				array_append(noise2, point);
-			}
+		if (!i || cmp(&temp[i - 1], &temp[i])) {
+			/* not equal */
+			++j;
+			result[j].cpoint.point = temp[i].point;
+			result[j].cpoint.cluster_id = 0;
+			result[j].first = k;
+			result[j].count = 0;
+			result[j].weight = 0.0;
 		}
+		result[j].count += temp[i].count;
+		for (r = temp[i].index; r < end; ++r) {
+			ctx->members[k++] = r;
+			result[j].weight += src->weights ? src->weights[r] : 1.0;
+		}
+	}
 
-		if (array_size(noise2)) {
-			kdtree_p noise_tree = NULL;
-			point_p *list = (point_p *) malloc(sizeof(point_p) * array_size(noise2));
+	if ((flags & DBSCAN_SFC_ORDER) && reorder_points(ctx, uni_size)) {
+		return -1;
+	}
 
-			if (!list) {
-				array_destroy(noise2);
-				FREEALL();
-				return -1;
-			}
+	ctx->n_sets = uni_size;
+	*ret_size = uni_size;
+	return 0;
+}
 
-			array_to_list(noise2, (void **) list);
-			noise_tree = kdtree_create_static(list, array_size(noise2));
-			free(list);
 
-			if (!noise_tree) {
-				array_destroy(noise2);
-				FREEALL();
-				return -1;
-			}
+/*
+ * Index the size pointsets of ctx->sets for neighbours, ctx->cpointsets
+ * listing them.
+ *
+ * With scan, up to SCAN_SETS_MAX pointsets, the kd-tree is not built at all:
+ * the coordinates are copied to ctx->xs and ctx->ys, and each search scans
+ * all of them with the batch kernels, which is much faster for so few points.
+ *
+ * scan: whether the clustering is the same whatever order the neighbours are found in
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int index_sets(dbscan_context_p ctx, size_t size, int scan)
+{
+	unsigned int i;
 
-			for (i = 0; i < array_size(noise2); ++i) {
-				cpointset_p cp = NULL; // non-allocated pointer
-				array_at(noise2, i, (void **) &cp);
-
-				if (!cp->cpoint.cluster_id) {
-					size_t n = 0;
-					cpointset_p *nn = (cpointset_p *) kdtree_k_nearest_neighbour(noise_tree, (point_p) cp, eps, &n);
-
-					next_id = id_generator_next_id(gen);
-					for (j = 0; j < n; ++j) {
-						nn[j]->cpoint.cluster_id = next_id;
-						for (k = 0; k < array_size(nn[j]->cpoints); ++k) {
-							cpointset_p cp_ = NULL; // non-allocated pointer
-							array_at(nn[j]->cpoints, k, (void **) &cp_);
-							cp_->cpoint.cluster_id = next_id;
+	ctx->scan = scan && size && size <= SCAN_SETS_MAX;
+	if (!ctx->scan) {
+		return kdtree_build(ctx->tree, (point_p *) ctx->cpointsets, size);
+	}
+
+	if (RESERVE(ctx, xs, size) || RESERVE(ctx, ys, size) || RESERVE(ctx, found, size)) {
+		return -1;
+	}
+	for (i = 0; i < size; ++i) {
+		ctx->xs[i] = ctx->sets[i].cpoint.point.x;
+		ctx->ys[i] = ctx->sets[i].cpoint.point.y;
+	}
+	return 0;
+}
+
+
+/*
+ * Append the pointsets within eps, a squared distance, from point to result,
+ * as kdtree_neighbours_filter does, filter being NULL to take all of them.
+ *
+ * NOTE: the pointsets are appended in no specific order, which is different
+ * for a scan and for the kd-tree.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int neighbours(dbscan_context_p ctx, point_p point, double eps,
+		kdtree_filter_t filter, void *arg, array_p result)
+{
+	size_t i, n;
+
+	if (!ctx->scan) {
+		return filter ? kdtree_neighbours_filter(ctx->tree, point, eps, filter, arg, result)
+				: kdtree_neighbours(ctx->tree, point, eps, result);
+	}
+
+	n = batch_within(ctx->xs, ctx->ys, ctx->n_sets, point, eps, ctx->found);
+	for (i = 0; i < n; ++i) {
+		cpointset_p q = &ctx->sets[ctx->found[i]];
+
+		if ((!filter || filter((point_p) q, arg)) && array_append(result, q)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * Put the convex hulls of the points in ctx->nnset into ctx->hullset.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int find_hulls(dbscan_context_p ctx)
+{
+	unsigned int i;
+	size_t n = hashset_size(ctx->nnset), n_hulls = 0;
+	point_p *hulls = NULL; // non-allocated pointer
+
+	if (RESERVE(ctx, nnlist, n) || RESERVE(ctx, list, n + 1)) {
+		return -1;
+	}
+	hashset_to_list(ctx->nnset, ctx->nnlist, sizeof(cpointset_p));
+
+	/* with 3 points or less, all of them are taken as the hulls */
+	if (n <= 3) {
+		hulls = (point_p *) ctx->nnlist;
+		n_hulls = n;
+	} else {
+		hulls = ctx->list;
+		n_hulls = convex_hull((point_p *) ctx->nnlist, n, hulls);
+	}
+
+	hashset_remove_all(ctx->hullset);
+	for (i = 0; i < n_hulls; ++i) {
+		cpointset_p hull = (cpointset_p) hulls[i];
+		hashset_add(ctx->hullset, &hull, sizeof(cpointset_p));
+	}
+
+	return 0;
+}
+
+
+/*
+ * Same as cluster, over the neighbour graph of the pointsets.
+ *
+ * Each pointset is searched in the kd-tree exactly once, and the noise
+ * is grouped over the graph too, instead of another tree.
+ */
+static int cluster_graph(dbscan_context_p ctx, source_p src, double eps, size_t min_pts, int flags)
+{
+	int r;
+	unsigned int i;
+	size_t size;
+
+	if (convert_points(ctx, src, flags, &size)
+			|| RESERVE(ctx, weights, size) || RESERVE(ctx, ids, size)) {
+		return -1;
+	}
+
+	for (i = 0; i < size; ++i) {
+		ctx->weights[i] = ctx->sets[i].weight;
+	}
+
+	if (nbgraph_build(ctx->graph, &ctx->sets[0].cpoint.point, sizeof(cpointset_t), size, eps, 0, 0)) {
+		return -1;
+	}
+
+	r = nbgraph_cluster(ctx->graph, ctx->weights, eps, min_pts, ctx->ids);
+	if (r < 0) {
+		return -1;
+	}
+
+	for (i = 0; i < size; ++i) {
+		cpointset_label(&ctx->sets[i], src, ctx->members, ctx->ids[i]);
+	}
+	return r;
+}
+
+
+/*
+ * Make the clusters of cluster_core canonical, see DBSCAN_CANONICAL.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int canonicalize_ids(dbscan_context_p ctx, size_t size, unsigned long n_ids, double eps)
+{
+	unsigned int i, j;
+	unsigned long id;
+	cluster_key_t *keys = NULL; // non-allocated pointer
+	array_p nn = ctx->nn;
+
+	if (RESERVE(ctx, keys, n_ids + 1)) {
+		return -1;
+	}
+	keys = ctx->keys;
+
+	/* the key of each cluster is its first core point */
+	for (id = 0; id <= n_ids; ++id) {
+		keys[id].key = (unsigned long) -1;
+		keys[id].id = id;
+	}
+	for (i = 0; i < size; ++i) {
+		cpointset_p set = &ctx->sets[i];
+
+		if (!ctx->core[i]) {
+			continue;
+		}
+		for (j = set->first; j < set->first + set->count; ++j) {
+			if (ctx->members[j] < keys[ctx->ids[i]].key) {
+				keys[ctx->ids[i]].key = ctx->members[j];
+			}
+		}
+	}
+
+	/* each border point joins the cluster of the smallest key around it */
+	for (i = 0; i < size; ++i) {
+		if (ctx->core[i] || !ctx->ids[i]) {
+			continue;
+		}
+
+		array_clear(nn);
+		if (neighbours(ctx, &ctx->sets[i].cpoint.point, eps, NULL, NULL, nn)) {
+			return -1;
+		}
+		for (j = 0; j < array_size(nn); ++j) {
+			cpointset_p q = NULL; // non-allocated pointer
+			unsigned int v;
+
+			array_at(nn, j, (void **) &q);
+			v = (unsigned int) (q - ctx->sets);
+			if (ctx->core[v] && keys[ctx->ids[v]].key < keys[ctx->ids[i]].key) {
+				ctx->ids[i] = ctx->ids[v];
+			}
+		}
+	}
+
+	/* then, number the clusters by their keys, keys[0] being the noise */
+	qsort(keys + 1, n_ids, sizeof(cluster_key_t), cmp_key);
+	for (id = 1; id <= n_ids; ++id) {
+		ctx->stack[keys[id].id] = (unsigned int) id;
+	}
+	ctx->stack[0] = 0;
+	for (i = 0; i < size; ++i) {
+		ctx->ids[i] = ctx->stack[ctx->ids[i]];
+	}
+
+	return 0;
+}
+
+
+/*
+ * Cluster the pointsets by a plane sweep over their x order, see DBSCAN_PLANE_SWEEP.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+static int sweep_sets(dbscan_context_p ctx, size_t size, double eps, size_t min_pts)
+{
+	size_t i;
+	int n_ids;
+	strip_p strip = ctx->strip;
+
+	strip_reset(strip, eps, (double) min_pts);
+	for (i = 0; i < size; ++i) {
+		if (strip_push(strip, &ctx->sets[i].cpoint.point, ctx->sets[i].weight)) {
+			return -1;
+		}
+	}
+
+	n_ids = strip_finish(strip);
+	for (i = 0; n_ids >= 0 && i < size; ++i) {
+		ctx->ids[i] = (unsigned long) strip_label(strip, i);
+		ctx->core[i] = (unsigned char) strip_core(strip, i);
+	}
+
+	return n_ids;
+}
+
+
+/*
+ * Same as cluster, but clustering exactly as the DBSCAN paper does, leaving
+ * the noise as 0 and telling the core points, with no more memory than
+ * the kd-tree.
+ *
+ * Each core pointset is searched twice, once for the core test and once
+ * to expand the cluster, by a scan for a few pointsets, see index_sets.
+ *
+ * core: receives whether each source point is a core point, or NULL
+ */
+static int cluster_core(dbscan_context_p ctx, source_p src, double eps, size_t min_pts, int flags,
+		unsigned char *core)
+{
+	unsigned int i, j, top = 0;
+	unsigned long next_id = 0;
+	size_t size;
+	array_p nn = ctx->nn;
+
+	/* the sweep needs the pointsets in x order, as sorted */
+	if (convert_points(ctx, src, flags & DBSCAN_PLANE_SWEEP ? flags & ~DBSCAN_SFC_ORDER : flags, &size)) {
+		return -1;
+	}
+
+	if (RESERVE(ctx, cpointsets, size) || RESERVE(ctx, ids, size)
+			|| RESERVE(ctx, core, size) || RESERVE(ctx, stack, size + 1)) {
+		return -1;
+	}
+	for (i = 0; i < size; ++i) {
+		ctx->cpointsets[i] = &ctx->sets[i];
+	}
+
+	if (flags & DBSCAN_PLANE_SWEEP) {
+		int n_ids = sweep_sets(ctx, size, eps, min_pts);
+
+		if (n_ids < 0 || ((flags & DBSCAN_CANONICAL) && index_sets(ctx, size, 1))) {
+			return -1;
+		}
+		next_id = (unsigned long) n_ids;
+	} else {
+		if (index_sets(ctx, size, 1)) {
+			return -1;
+		}
+
+		/* find all the core points */
+		for (i = 0; i < size; ++i) {
+			double total = 0.0;
+
+			/* a pointset weighing min_pts is a core point by itself, without searching */
+			ctx->ids[i] = 0;
+			if (ctx->sets[i].weight >= min_pts) {
+				ctx->core[i] = 1;
+				continue;
+			}
+
+			array_clear(nn);
+			if (neighbours(ctx, &ctx->sets[i].cpoint.point, eps, NULL, NULL, nn)) {
+				return -1;
+			}
+			for (j = 0; j < array_size(nn); ++j) {
+				cpointset_p q = NULL; // non-allocated pointer
+				array_at(nn, j, (void **) &q);
+				total += q->weight;
+			}
+			ctx->core[i] = total >= min_pts;
+		}
+
+		/* expand a cluster from each core point not in any cluster yet */
+		for (i = 0; i < size; ++i) {
+			if (!ctx->core[i] || ctx->ids[i]) {
+				continue;
+			}
+
+			ctx->ids[i] = ++next_id;
+			ctx->stack[top++] = i;
+
+			while (top) {
+				unsigned int u = ctx->stack[--top];
+
+				array_clear(nn);
+				if (neighbours(ctx, &ctx->sets[u].cpoint.point, eps, NULL, NULL, nn)) {
+					return -1;
+				}
+				for (j = 0; j < array_size(nn); ++j) {
+					cpointset_p q = NULL; // non-allocated pointer
+					unsigned int v;
+
+					array_at(nn, j, (void **) &q);
+					v = (unsigned int) (q - ctx->sets);
+					if (!ctx->ids[v]) {
+						ctx->ids[v] = next_id;
+						if (ctx->core[v]) {
+							ctx->stack[top++] = v;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	if ((flags & DBSCAN_CANONICAL) && canonicalize_ids(ctx, size, next_id, eps)) {
+		return -1;
+	}
+
+	for (i = 0; i < size; ++i) {
+		cpointset_p set = &ctx->sets[i];
+
+		cpointset_label(set, src, ctx->members, ctx->ids[i]);
+		for (j = set->first; core && j < set->first + set->count; ++j) {
+			core[ctx->members[j]] = ctx->core[i];
+		}
+	}
+
+	return (int) next_id;
+}
+
+
+/*
+ * Sample m of the size pointsets uniformly, by selection sampling, into
+ * ctx->stack in increasing order.
+ */
+static void sample_sets(dbscan_context_p ctx, size_t size, size_t m)
+{
+	unsigned int i, k = 0;
+	unsigned long long seed = SAMPLE_SEED;
+
+	for (i = 0; i < size && k < m; ++i) {
+		double u;
+
+		/* xorshift64*, not to depend on nor disturb the state of random() */
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		u = (double) ((seed * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0;
+
+		if (u * (double) (size - i) < (double) (m - k)) {
+			ctx->stack[k++] = i;
+		}
+	}
+}
+
+
+/*
+ * Same as cluster_core, but searching the neighbours of a sample of the
+ * pointsets only, as DBSCAN++ does.
+ *
+ * The sampled core pointsets within eps of each other are clustered together,
+ * and every pointset then joins the cluster of its nearest sampled core
+ * pointset within eps, found in a kd-tree of those only.
+ *
+ * ref: DBSCAN++: Towards fast and scalable density clustering
+ *      Jennifer Jang, Heinrich Jiang
+ *
+ * sample: the number of pointsets sampled, or the fraction of them up to 1
+ * core: receives whether each source point is a sampled core point, or NULL
+ */
+static int cluster_sample(dbscan_context_p ctx, source_p src, double eps, size_t min_pts, double sample,
+		int flags, unsigned char *core)
+{
+	unsigned int i, j, k, n_core = 0;
+	unsigned long next_id = 0;
+	size_t size, m;
+	array_p nn = ctx->nn, pairs = ctx->pairs;
+	unionfind_p uf = NULL;
+
+	if (convert_points(ctx, src, flags, &size)) {
+		return -1;
+	}
+
+	m = sample <= 1.0 ? (size_t) ceil(sample * (double) size) : (size_t) sample;
+	m = m < size ? m : size;
+
+	if (RESERVE(ctx, cpointsets, size) || RESERVE(ctx, ids, size)
+			|| RESERVE(ctx, core, size) || RESERVE(ctx, stack, size + 1) || RESERVE(ctx, perm, m + 1)) {
+		return -1;
+	}
+	for (i = 0; i < size; ++i) {
+		ctx->cpointsets[i] = &ctx->sets[i];
+		ctx->ids[i] = 0;
+		ctx->core[i] = 0;
+	}
+	if (index_sets(ctx, size, 1)) {
+		return -1;
+	}
+
+	/* ids tells the sampled pointsets, by their place in the sample plus 1 */
+	sample_sets(ctx, size, m);
+	for (k = 0; k < m; ++k) {
+		ctx->ids[ctx->stack[k]] = k + 1;
+	}
+
+	/* the core test of each sampled pointset, keeping the pairs with the sampled ones before it */
+	array_clear(pairs);
+	for (k = 0; k < m; ++k) {
+		unsigned int u = ctx->stack[k];
+		double total = 0.0;
+
+		array_clear(nn);
+		if (neighbours(ctx, &ctx->sets[u].cpoint.point, eps, NULL, NULL, nn)) {
+			return -1;
+		}
+		for (j = 0; j < array_size(nn); ++j) {
+			cpointset_p q = NULL; // non-allocated pointer
+			unsigned int v;
+
+			array_at(nn, j, (void **) &q);
+			v = (unsigned int) (q - ctx->sets);
+			total += q->weight;
+			if (ctx->ids[v] && ctx->ids[v] - 1 < k) {
+				unsigned int pair[2] = { (unsigned int) ctx->ids[v] - 1, k };
+				if (array_push(pairs, pair)) {
+					return -1;
+				}
+			}
+		}
+		ctx->core[u] = total >= min_pts;
+	}
+
+	/* cluster the sampled core pointsets, numbering the clusters in the order of the sample */
+	uf = unionfind_create_with(arena_allocator(ctx->arena), m);
+	if (!uf) {
+		return -1;
+	}
+	for (j = 0; j < array_size(pairs); ++j) {
+		unsigned int *pair = (unsigned int *) array_get(pairs, j);
+
+		if (ctx->core[ctx->stack[pair[0]]] && ctx->core[ctx->stack[pair[1]]]) {
+			unionfind_union(uf, pair[0], pair[1]);
+		}
+	}
+	for (k = 0; k < m; ++k) {
+		unsigned int u = ctx->stack[k], r = unionfind_find(uf, k);
+
+		if (ctx->core[u]) {
+			ctx->perm[k] = r == k ? (unsigned int) ++next_id : ctx->perm[r];
+			ctx->cpointsets[n_core++] = &ctx->sets[u];
+		}
+	}
+	unionfind_destroy(uf);
+
+	/* then, every pointset joins the cluster of its nearest sampled core pointset */
+	if (n_core && kdtree_build(ctx->tree, (point_p *) ctx->cpointsets, n_core)) {
+		return -1;
+	}
+	for (i = 0; i < size; ++i) {
+		cpointset_p set = &ctx->sets[i];
+		cpointset_p q = n_core ? (cpointset_p) kdtree_nearest_within(ctx->tree, &set->cpoint.point, eps, NULL) : NULL;
+
+		cpointset_label(set, src, ctx->members, q ? ctx->perm[ctx->ids[q - ctx->sets] - 1] : 0);
+		for (j = set->first; core && j < set->first + set->count; ++j) {
+			core[ctx->members[j]] = ctx->core[i];
+		}
+	}
+
+	return (int) next_id;
+}
+
+
+/*
+ * Filter of the pointsets left as noise by the expansion of the clusters,
+ * arg pointing to the first id given to a group of noise: the noise
+ * is either not grouped yet, or grouped with an id no smaller than it.
+ */
+static int is_noise(point_p point, void *arg)
+{
+	unsigned long id = ((cpoint_p) point)->cluster_id;
+
+	return !id || id >= *(unsigned long *) arg;
+}
+
+
+/*
+ * DBSCAN Algorithm implementation.
+ *
+ * ref: A Density-Based Algorithm for Discovering Clusters in Large Spatial Databases with Noise
+ *      Martin Ester, Hans-Peter Kriegel, Jorg Sander, Xiaowei Xu
+ *
+ *      A Fast Approach to Clustering Datasets using DBSCAN and Pruning Algorithms
+ *      S. Vijayalaksmi, M Punithavalli
+ *
+ *
+ * arguments: ctx		the context to work in
+ *            src		all the points
+ *            eps		eps in the algorithm, not sqrted
+ *            min_pts	min pts in the algorithm
+ *            flags		DBSCAN_* flags
+ *
+ * returns: the clusters num, or -1 if failed
+ */
+static int cluster(dbscan_context_p ctx, source_p src, double eps, size_t min_pts, int flags)
+{
+	unsigned int i, j, k;
+	unsigned long next_id = 0, first_noise_id = 0;
+	size_t size;
+
+	cpointset_p *cpointsets = NULL; // non-allocated pointer
+	unsigned int *members = NULL; // non-allocated pointer
+	hashset_p visited = NULL, nnset = NULL, hullset = ctx->hullset;
+	array_p noise = ctx->noise, nn = ctx->nn, nn_ = ctx->nn_;
+
+	eps *= eps;
+
+	if (flags & (DBSCAN_CANONICAL | DBSCAN_PLANE_SWEEP)) {
+		return cluster_core(ctx, src, eps, min_pts, flags, NULL);
+	}
+
+	if (flags & DBSCAN_NBGRAPH) {
+		return cluster_graph(ctx, src, eps, min_pts, flags);
+	}
+
+	/*
+	 * Considering that the input points may have duplicated points,
+	 * this will convert all single points to pointsets.
+	 */
+	if (convert_points(ctx, src, flags, &size)) {
+		return -1;
+	}
+	members = ctx->members;
+
+	if (RESERVE(ctx, cpointsets, size) || reset_hashsets(ctx, size)) {
+		return -1;
+	}
+	cpointsets = ctx->cpointsets;
+	for (i = 0; i < size; ++i) {
+		cpointsets[i] = &ctx->sets[i];
+	}
+	visited = ctx->visited;
+	nnset = ctx->nnset;
+
+	id_generator_reset(ctx->gen);
+
+	/*
+	 * create the kd-tree with pointsets, which is used as points,
+	 * never scanning them: the hulls pruning the expansion depend on
+	 * the order the neighbours are found in
+	 */
+	if (index_sets(ctx, size, 0)) {
+		return -1;
+	}
+
+	/* maintain border points */
+	array_clear(noise);
+
+	/* traverse all points, */
+	for (i = 0; i < size; ++i) {
+		size_t n = 0;
+		double total = 0.0;
+		cpointset_p point = cpointsets[i]; // notice, point is a pointset
+
+		/* , if the point has not been visited yet */
+		if (hashset_contains(visited, &point, sizeof(cpointset_p))) {
+			continue;
+		}
+		hashset_add(visited, &point, sizeof(cpointset_p));
+
+		/* find knn points in the kd-tree */
+		array_clear(nn);
+		if (neighbours(ctx, (point_p) point, eps, NULL, NULL, nn)) {
+			return -1;
+		}
+		n = array_size(nn);
+
+		for (j = 0; j < n; ++j) {
+			cpointset_p q = NULL; // non-allocated pointer
+			array_at(nn, j, (void **) &q);
+			total += q->weight;
+		}
+
+		if (total < min_pts) {
+			/* border point, add to noise */
+			array_append(noise, point);
+
+		} else {
+			/* core point, form a new cluster */
+			/* form a new cluster, the points being labelled at the end */
+			next_id = id_generator_next_id(ctx->gen);
+			point->cpoint.cluster_id = next_id;
+
+			/* add all points found in knn into the hashset for finding convex hulls */
+			hashset_remove_all(nnset);
+			for (j = 0; j < n; ++j) {
+				cpointset_p q = NULL; // non-allocated pointer
+				array_at(nn, j, (void **) &q);
+				if (q != point) {
+					hashset_add(nnset, &q, sizeof(cpointset_p));
+				}
+			}
+
+			if (find_hulls(ctx)) {
+				return -1;
+			}
+
+			/* expand the current cluster */
+			while (hashset_size(nnset)) {
+				size_t n = 0;
+				double total = 0.0;
+				cpointset_p p = NULL; // non-allocated pointer
+
+				/* traverse current cluster, */
+				if (hashset_pop(nnset, &p, sizeof(cpointset_p))) {
+					return -1;
+				}
+
+				/* , if the point is not visited, */
+				if (!hashset_contains(visited, &p, sizeof(cpointset_p))) {
+					hashset_add(visited, &p, sizeof(cpointset_p));
+
+					/* , and if the point is in the convex hulls */
+					if (hashset_contains(hullset, &p, sizeof(cpointset_p))) {
+
+						/* as before, find knn points */
+						array_clear(nn_);
+						if (neighbours(ctx, (point_p) p, eps, NULL, NULL, nn_)) {
+							return -1;
+						}
+						n = array_size(nn_);
+
+						for (j = 0; j < n; ++j) {
+							cpointset_p q = NULL; // non-allocated pointer
+							array_at(nn_, j, (void **) &q);
+							total += q->weight;
+						}
+
+						if (total >= min_pts) {
+							/* core point, continue expanding */
+							for (k = 0; k < n; ++k) {
+								cpointset_p q = NULL; // non-allocated pointer
+								array_at(nn_, k, (void **) &q);
+								hashset_add(nnset, &q, sizeof(cpointset_p));
+							}
+						}
+
+						/* find the new convex hulls */
+						if (find_hulls(ctx)) {
+							return -1;
 						}
 					}
-					free(nn);
 				}
+
+				/* put current point into the current cluster while expanding current cluster */
+				if (p->cpoint.cluster_id == 0) {
+					p->cpoint.cluster_id = next_id;
+				}
+				/* else, p->cpoint.cluster_id should be equal to next_id */
+			}
+		}
+	}
+
+	/*
+	 * collect the noise (outliers), put them into new clusters,
+	 * searching the tree for the points of the noise only
+	 */
+	first_noise_id = next_id + 1;
+	for (i = 0; i < array_size(noise); ++i) {
+		cpointset_p cp = NULL; // non-allocated pointer
+		array_at(noise, i, (void **) &cp);
+
+		if (!cp->cpoint.cluster_id) {
+			array_clear(nn);
+			if (neighbours(ctx, (point_p) cp, eps, is_noise, &first_noise_id, nn)) {
+				return -1;
+			}
+
+			next_id = id_generator_next_id(ctx->gen);
+			for (j = 0; j < array_size(nn); ++j) {
+				cpointset_p q = NULL; // non-allocated pointer
+				array_at(nn, j, (void **) &q);
+				q->cpoint.cluster_id = next_id;
+			}
+		}
+	}
+
+	/* label all the points, the ones of each pointset at once */
+	for (i = 0; i < size; ++i) {
+		cpointset_label(cpointsets[i], src, members, cpointsets[i]->cpoint.cluster_id);
+	}
+
+	return next_id;
+}
+
+
+/*
+ * Add weight points, whose centroid is point and m2 is m2, to the statistics.
+ */
+static void stats_add(dbscan_stats_p stats, point_p point, double weight, double m2)
+{
+	double n = (double) stats->size + weight;
+	double dx = point->x - stats->centroid.x;
+	double dy = point->y - stats->centroid.y;
+
+	if (!stats->size) {
+		stats->centroid = *point;
+		stats->m2 = m2;
+		stats->size = (size_t) weight;
+		return;
+	}
+
+	/* the parallel form of Welford's update, by Chan et al. */
+	stats->centroid.x += dx * weight / n;
+	stats->centroid.y += dy * weight / n;
+	stats->m2 += m2 + (dx * dx + dy * dy) * stats->size * weight / n;
+	stats->size += (size_t) weight;
+}
+
+
+/*
+ * Compute the statistics of the n_ids clusters just found, into ctx->stats.
+ *
+ * Each pointset is added at once with the weight of its points,
+ * and the hulls are found over the pointsets of each cluster.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int collect_stats(dbscan_context_p ctx, unsigned long n_ids)
+{
+	unsigned int i;
+	unsigned long id;
+	size_t size = ctx->n_sets, labelled = 0, n_hulls = 0;
+	dbscan_stats_p stats = NULL; // non-allocated pointer
+	unsigned int *starts = NULL; // non-allocated pointer
+
+	if (RESERVE(ctx, stats, n_ids ? n_ids : 1) || RESERVE(ctx, perm, n_ids + 1)
+			|| RESERVE(ctx, cpointsets, size ? size : 1) || RESERVE(ctx, hulls, size ? size : 1)
+			|| RESERVE(ctx, list, size + 1)) {
+		return -1;
+	}
+	stats = ctx->stats;
+	starts = ctx->perm;
+
+	memset(stats, 0, sizeof(dbscan_stats_t) * n_ids);
+	memset(starts, 0, sizeof(unsigned int) * (n_ids + 1));
+	for (i = 0; i < size; ++i) {
+		cpointset_p set = &ctx->sets[i];
+
+		id = set->cpoint.cluster_id;
+		if (!id) {
+			continue;
+		}
+
+		if (!stats[id - 1].size) {
+			rect_init_point(&stats[id - 1].rect, &set->cpoint.point);
+		}
+		rect_enlarge_to(&stats[id - 1].rect, &set->cpoint.point);
+		stats_add(&stats[id - 1], &set->cpoint.point, set->count, 0.0);
+
+		++starts[id];
+		++labelled;
+	}
+
+	/* group the pointsets by cluster, cluster id being cpointsets[starts[id], starts[id + 1]) */
+	for (id = 1; id <= n_ids; ++id) {
+		starts[id] += starts[id - 1];
+	}
+	for (i = size; i-- > 0;) {
+		id = ctx->sets[i].cpoint.cluster_id;
+		if (id) {
+			ctx->cpointsets[--starts[id]] = &ctx->sets[i];
+		}
+	}
+
+	for (id = 1; id <= n_ids; ++id) {
+		size_t end = id < n_ids ? starts[id + 1] : labelled, k, n;
+
+		n = convex_hull((point_p *) &ctx->cpointsets[starts[id]], end - starts[id], ctx->list);
+		stats[id - 1].hull = &ctx->hulls[n_hulls];
+		stats[id - 1].hull_size = n;
+		for (k = 0; k < n; ++k) {
+			ctx->hulls[n_hulls++] = *ctx->list[k];
+		}
+	}
+
+	ctx->n_stats = n_ids;
+	ctx->has_stats = 1;
+	return 0;
+}
+
+
+/*
+ * Run a clustering in the context, as every dbscan_context_* function
+ * clustering at a single eps does, with the engine the flags pick.
+ *
+ * The labels, if any, are reset first. No points make no clusters, whatever
+ * the engine: none of them is given an empty input, which the kd-tree of
+ * no points would refuse. What the engine builds for this clustering only
+ * is taken from ctx->arena, and all given back at the end.
+ *
+ * arguments: ctx		the context to work in
+ *            src		all the points
+ *            eps		eps in the algorithm, sqrted
+ *            min_pts	min pts in the algorithm
+ *            sample	see dbscan_context_sample_labels, with RUN_SAMPLE only
+ *            flags		DBSCAN_* and RUN_* flags
+ *            core		see dbscan_context_core_labels, with RUN_CORE or RUN_SAMPLE only
+ *
+ * returns: the clusters num, or -1 if failed
+ */
+static int run(dbscan_context_p ctx, source_p src, double eps, size_t min_pts, double sample, int flags,
+		unsigned char *core)
+{
+	int r;
+	arena_mark_t mark;
+
+	if (src->labels) {
+		memset(src->labels, 0, sizeof(int32_t) * src->size);
+	}
+	ctx->has_stats = 0;
+
+	if (!src->size) {
+		ctx->n_sets = 0; // no clusters, for the statistics too
+		r = 0;
+	} else {
+		mark = arena_mark(ctx->arena);
+		if (flags & RUN_SAMPLE) {
+			r = cluster_sample(ctx, src, eps * eps, min_pts, sample, flags, core);
+		} else if (flags & RUN_CORE) {
+			r = cluster_core(ctx, src, eps * eps, min_pts, flags, core);
+		} else {
+			r = cluster(ctx, src, eps, min_pts, flags);
+		}
+		arena_reset_to(ctx->arena, mark);
+	}
+
+	if (r >= 0 && (flags & DBSCAN_STATS) && collect_stats(ctx, r)) {
+		return -1;
+	}
+	return r;
+}
+
+
+int dbscan_cluster(cpoint_p *cpoints, size_t size, double eps, size_t min_pts)
+{
+	return dbscan_cluster_ex(cpoints, size, eps, min_pts, 0);
+}
+
+
+int dbscan_cluster_ex(cpoint_p *cpoints, size_t size, double eps, size_t min_pts, int flags)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_cluster(ctx, cpoints, size, eps, min_pts, flags);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_cluster_labels(const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_cluster_labels(ctx, coords, stride, size, eps, min_pts, flags, labels);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_cluster(dbscan_context_p ctx, cpoint_p *cpoints, size_t size,
+		double eps, size_t min_pts, int flags)
+{
+	source_t src = { .cpoints = cpoints, .size = size };
+
+	return run(ctx, &src, eps, min_pts, 0.0, flags, NULL);
+}
+
+
+int dbscan_context_cluster_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	return dbscan_context_weighted_labels(ctx, coords, stride, size, NULL, eps, min_pts, flags, labels);
+}
+
+
+int dbscan_fixed_labels(const int32_t *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_fixed_labels(ctx, coords, stride, size, eps, min_pts, flags, labels);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_fixed_labels(dbscan_context_p ctx, const int32_t *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	source_t src = {
+		.coords = (const char *) coords,
+		.stride = stride ? stride : sizeof(int32_t) * 2,
+		.fixed = 1,
+		.labels = labels,
+		.size = size
+	};
+
+	return run(ctx, &src, eps, min_pts, 0.0, flags, NULL);
+}
+
+
+int dbscan_weighted_labels(const double *coords, size_t stride, size_t size, const double *weights,
+		double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_weighted_labels(ctx, coords, stride, size, weights, eps, min_pts, flags, labels);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_weighted_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t size,
+		const double *weights, double eps, size_t min_pts, int flags, int32_t *labels)
+{
+	source_t src = {
+		.coords = (const char *) coords,
+		.stride = stride ? stride : sizeof(double) * 2,
+		.labels = labels,
+		.weights = weights,
+		.size = size
+	};
+
+	return run(ctx, &src, eps, min_pts, 0.0, flags, NULL);
+}
+
+
+const dbscan_stats_t *dbscan_context_stats(dbscan_context_p ctx, size_t *n)
+{
+	if (!ctx->has_stats) {
+		*n = 0;
+		return NULL;
+	}
+	*n = ctx->n_stats;
+	return ctx->stats;
+}
+
+
+int dbscan_stats_merge(dbscan_stats_p into, const dbscan_stats_t *from, point_t *hull)
+{
+	size_t i, n = 0, total = into->hull_size + from->hull_size;
+	point_p *list = NULL, *result = NULL; // result follows list
+
+	if (!from->size) {
+		return 0;
+	}
+
+	list = (point_p *) malloc(sizeof(point_p) * (total * 2 + 1));
+	if (!list) {
+		return -1;
+	}
+	result = list + total;
+	for (i = 0; i < into->hull_size; ++i) {
+		list[i] = &into->hull[i];
+	}
+	for (i = 0; i < from->hull_size; ++i) {
+		list[into->hull_size + i] = &from->hull[i];
+	}
+
+	n = convex_hull(list, total, result);
+	for (i = 0; i < n; ++i) {
+		hull[i] = *result[i];
+	}
+	free(list);
+
+	if (!into->size) {
+		into->rect = from->rect;
+	} else {
+		rect_enlarge_to(&into->rect, &(point_t) { .x = from->rect.x_itv.lower, .y = from->rect.y_itv.lower });
+		rect_enlarge_to(&into->rect, &(point_t) { .x = from->rect.x_itv.upper, .y = from->rect.y_itv.upper });
+	}
+	stats_add(into, (point_p) &from->centroid, from->size, from->m2);
+	into->hull = hull;
+	into->hull_size = n;
+	return 0;
+}
+
+
+int dbscan_sweep_labels(const double *coords, size_t stride, size_t size,
+		dbscan_params_p params, size_t n_params, int flags, int32_t *labels, int *clusters)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_sweep_labels(ctx, coords, stride, size, params, n_params, flags, labels, clusters);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_sweep_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t size,
+		dbscan_params_p params, size_t n_params, int flags, int32_t *labels, int *clusters)
+{
+	unsigned int i, k;
+	size_t uni_size = 0;
+	double max_eps = 0.0;
+	source_t src = {
+		.coords = (const char *) coords,
+		.stride = stride ? stride : sizeof(double) * 2,
+		.labels = labels,
+		.size = size
+	};
+
+	memset(labels, 0, sizeof(int32_t) * size * n_params);
+
+	for (k = 0; k < n_params; ++k) {
+		if (params[k].eps > max_eps) {
+			max_eps = params[k].eps;
+		}
+	}
+
+	if (convert_points(ctx, &src, flags, &uni_size)) {
+		return -1;
+	}
+	if (!uni_size) {
+		for (k = 0; clusters && k < n_params; ++k) {
+			clusters[k] = 0;
+		}
+		return 0;
+	}
+
+	if (RESERVE(ctx, weights, uni_size) || RESERVE(ctx, ids, uni_size)) {
+		return -1;
+	}
+	for (i = 0; i < uni_size; ++i) {
+		ctx->weights[i] = ctx->sets[i].weight;
+	}
+
+	/* search the neighbours once, at the largest eps */
+	if (nbgraph_build(ctx->graph, &ctx->sets[0].cpoint.point, sizeof(cpointset_t), uni_size,
+			max_eps * max_eps, NBGRAPH_KEEP_DIST, 0)) {
+		return -1;
+	}
+
+	for (k = 0; k < n_params; ++k) {
+		int r = nbgraph_cluster(ctx->graph, ctx->weights, params[k].eps * params[k].eps,
+				params[k].min_pts, ctx->ids);
+		if (r < 0) {
+			return -1;
+		}
+
+		src.labels = labels + size * k;
+		for (i = 0; i < uni_size; ++i) {
+			cpointset_label(&ctx->sets[i], &src, ctx->members, ctx->ids[i]);
+		}
+
+		if (clusters) {
+			clusters[k] = r;
+		}
+	}
+
+	return 0;
+}
+
+
+int dbscan_optics(const double *coords, size_t stride, size_t size, double eps, size_t min_pts, int flags,
+		unsigned int *order, double *core_dist, double *reach)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_optics(ctx, coords, stride, size, eps, min_pts, flags, order, core_dist, reach);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_optics(dbscan_context_p ctx, const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, unsigned int *order, double *core_dist, double *reach)
+{
+	unsigned int i, j, k = 0;
+	size_t uni_size = 0;
+	optics_p optics = NULL;
+	arena_mark_t mark;
+	source_t src = {
+		.coords = (const char *) coords,
+		.stride = stride ? stride : sizeof(double) * 2,
+		.size = size
+	};
+
+	if (convert_points(ctx, &src, flags, &uni_size)) {
+		return -1;
+	}
+	if (!uni_size) {
+		return 0;
+	}
+
+	if (RESERVE(ctx, weights, uni_size)) {
+		return -1;
+	}
+	for (i = 0; i < uni_size; ++i) {
+		ctx->weights[i] = ctx->sets[i].weight;
+	}
+
+	/* the ordering is only needed until it is expanded */
+	mark = arena_mark(ctx->arena);
+	optics = optics_create_with(arena_allocator(ctx->arena), &ctx->sets[0].cpoint.point, sizeof(cpointset_t),
+			uni_size, ctx->weights, eps * eps, min_pts);
+	if (!optics) {
+		arena_reset_to(ctx->arena, mark);
+		return -1;
+	}
+
+	/*
+	 * Expand each pointset to the points it represents: the first one is reached
+	 * as the pointset is, and the rest of them as well, or, at distance 0, within
+	 * its core distance if that's less, as when the first one starts a cluster.
+	 */
+	for (i = 0; i < uni_size; ++i) {
+		unsigned int p = optics->order[i];
+		cpointset_p set = &ctx->sets[p];
+		double core = sqrt(optics->core_dist[p]), r = sqrt(optics->reach[p]);
+
+		for (j = set->first; j < set->first + set->count; ++j) {
+			unsigned int m = ctx->members[j];
+
+			order[k++] = m;
+			core_dist[m] = core;
+			reach[m] = j == set->first || r < core ? r : core;
+		}
+	}
+
+	optics_destroy(optics);
+	arena_reset_to(ctx->arena, mark);
+	return 0;
+}
+
+
+int dbscan_optics_labels(const unsigned int *order, const double *core_dist, const double *reach,
+		size_t size, double eps, int32_t *labels)
+{
+	return optics_extract(order, core_dist, reach, size, eps, labels);
+}
+
+
+int dbscan_sample_labels(const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, double sample, int flags, int32_t *labels, unsigned char *core)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_sample_labels(ctx, coords, stride, size, eps, min_pts, sample, flags, labels, core);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_sample_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, double sample, int flags, int32_t *labels, unsigned char *core)
+{
+	source_t src = {
+		.coords = (const char *) coords,
+		.stride = stride ? stride : sizeof(double) * 2,
+		.labels = labels,
+		.size = size
+	};
+
+	return run(ctx, &src, eps, min_pts, sample, (flags & ~DBSCAN_STATS) | RUN_SAMPLE, core);
+}
+
+
+int dbscan_rho_labels(const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, double rho, int32_t *labels, unsigned char *core)
+{
+	return rho_cluster((point_p) coords, stride ? stride : sizeof(double) * 2, size, NULL,
+			eps, (double) min_pts, rho, labels, core);
+}
+
+
+int dbscan_core_labels(const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, int32_t *labels, unsigned char *core)
+{
+	int r;
+	dbscan_context_p ctx = dbscan_context_create();
+
+	if (!ctx) {
+		return -1;
+	}
+
+	r = dbscan_context_core_labels(ctx, coords, stride, size, eps, min_pts, flags, labels, core);
+
+	dbscan_context_destroy(ctx);
+	return r;
+}
+
+
+int dbscan_context_core_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t size,
+		double eps, size_t min_pts, int flags, int32_t *labels, unsigned char *core)
+{
+	source_t src = {
+		.coords = (const char *) coords,
+		.stride = stride ? stride : sizeof(double) * 2,
+		.labels = labels,
+		.size = size
+	};
+
+	return run(ctx, &src, eps, min_pts, 0.0, (flags & ~DBSCAN_STATS) | RUN_CORE, core);
+}
+
+
+
+/*
+ * A point spilled to a tile, which it belongs to or is in the halo of.
+ */
+typedef struct s_spill
+{
+	double x;
+	double y;
+
+	/* index of the point in the file, with SPILL_OWNED if it belongs to the tile */
+	unsigned long long index;
+}
+spill_t, *spill_p;
+
+
+#define SPILL_OWNED (1ULL << 63)
+
+
+/*
+ * A run of points of a tile in the spill file.
+ */
+typedef struct s_spill_run
+{
+	off_t offset;
+	size_t count;
+}
+spill_run_t, *spill_run_p;
+
+
+/*
+ * The points spilled tile by tile, each tile buffering up to per_tile points.
+ */
+typedef struct s_spiller
+{
+	FILE *file;
+	off_t size;
+
+	size_t n_tiles;
+	size_t per_tile;
+	spill_t *bufs;
+	size_t *counts;
+
+	/* the runs of each tile, typed arrays of spill_run_t */
+	array_p *runs;
+}
+spiller_t, *spiller_p;
+
+
+/*
+ * A halo point found in a cluster of another tile than its own.
+ */
+typedef struct s_halo
+{
+	unsigned long long index;
+	int32_t id;
+}
+halo_t, *halo_p;
+
+
+/*
+ * Read the points [i, i + READ_RECORDS) of n, or less at the end, from the
+ * records of stride bytes, x and y being at offset of each record.
+ *
+ * Returns: the number of points read, 0 if failed.
+ */
+static size_t read_points(FILE *in, size_t offset, size_t stride, size_t n, size_t i,
+		char *buf, point_t *points)
+{
+	size_t k, m = n - i < READ_RECORDS ? n - i : READ_RECORDS;
+
+	if (fread(buf, stride, m, in) != m) {
+		return 0;
+	}
+	for (k = 0; k < m; ++k) {
+		memcpy(&points[k], buf + stride * k + offset, sizeof(point_t));
+	}
+	return m;
+}
+
+
+static int spill_flush(spiller_p sp, unsigned int tile)
+{
+	spill_run_t run = { .offset = sp->size, .count = sp->counts[tile] };
+
+	if (!run.count) {
+		return 0;
+	}
+	if (fwrite(sp->bufs + sp->per_tile * tile, sizeof(spill_t), run.count, sp->file) != run.count
+			|| array_push(sp->runs[tile], &run)) {
+		return -1;
+	}
+	sp->size += sizeof(spill_t) * run.count;
+	sp->counts[tile] = 0;
+	return 0;
+}
+
+
+static int spill(spiller_p sp, unsigned int tile, point_p point, unsigned long long index)
+{
+	spill_t *rec = sp->bufs + sp->per_tile * tile + sp->counts[tile]++;
+
+	rec->x = point->x;
+	rec->y = point->y;
+	rec->index = index;
+
+	return sp->counts[tile] == sp->per_tile ? spill_flush(sp, tile) : 0;
+}
+
+
+int dbscan_cluster_file(const char *path, size_t offset, size_t stride, double eps, size_t min_pts,
+		int flags, size_t mem_bytes, const char *labels_path)
+{
+	unsigned int t, halo[3];
+	size_t i, k, m, n = 0, n_tiles = 0, tile_n = 0, labels_n = 0, core_n = 0;
+	int r = -1, fd = -1;
+	struct stat st;
+	FILE *in = NULL, *halo_file = NULL;
+	char *buf = NULL;
+	point_t *points = NULL;
+	int32_t *out = NULL, *labels = NULL, *compact = NULL;
+	unsigned char *core = NULL;
+	spill_t *tile = NULL;
+	rect_t bounds;
+	tiles_p tiles = NULL;
+	unionfind_p uf = NULL;
+	dbscan_context_p ctx = NULL;
+	spiller_t sp = { .file = NULL };
+
+#define FREEALL()\
+	{\
+		if (in) { fclose(in); in = NULL; }\
+		if (halo_file) { fclose(halo_file); halo_file = NULL; }\
+		if (sp.file) { fclose(sp.file); sp.file = NULL; }\
+		if (out) { munmap(out, sizeof(int32_t) * n); out = NULL; }\
+		if (fd >= 0) { close(fd); fd = -1; }\
+		free(buf); buf = NULL;\
+		free(points); points = NULL;\
+		free(labels); labels = NULL;\
+		free(core); core = NULL;\
+		free(tile); tile = NULL;\
+		free(compact); compact = NULL;\
+		free(sp.bufs); sp.bufs = NULL;\
+		free(sp.counts); sp.counts = NULL;\
+		if (sp.runs) {\
+			for (t = 0; t < sp.n_tiles; ++t) {\
+				array_destroy(sp.runs[t]);\
+			}\
+			free(sp.runs); sp.runs = NULL;\
+		}\
+		tiles_destroy(tiles); tiles = NULL;\
+		unionfind_destroy(uf); uf = NULL;\
+		dbscan_context_destroy(ctx); ctx = NULL;\
+	}
+
+	stride = stride ? stride : sizeof(double) * 2;
+
+	/* the point must lie within its record */
+	if (offset > stride || stride - offset < sizeof(point_t)) {
+		return -1;
+	}
+
+	in = fopen(path, "rb");
+	fd = open(labels_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	buf = (char *) malloc(stride * READ_RECORDS);
+	points = (point_t *) malloc(sizeof(point_t) * READ_RECORDS);
+	if (!in || fd < 0 || !buf || !points || fstat(fileno(in), &st)) {
+		FREEALL();
+		return -1;
+	}
+
+	n = (size_t) st.st_size / stride;
+	if (!n) {
+		FREEALL();
+		return 0;
+	}
+
+	/* the labels are written in place, so they need not fit in memory either */
+	if (ftruncate(fd, (off_t) (sizeof(int32_t) * n))) {
+		FREEALL();
+		return -1;
+	}
+	out = (int32_t *) mmap(NULL, sizeof(int32_t) * n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (out == MAP_FAILED) {
+		out = NULL;
+		FREEALL();
+		return -1;
+	}
+
+	/* first, find the bounds */
+	for (i = 0; i < n; i += m) {
+		m = read_points(in, offset, stride, n, i, buf, points);
+		if (!m) {
+			FREEALL();
+			return -1;
+		}
+		for (k = 0; k < m; ++k) {
+			if (!i && !k) {
+				rect_init_point(&bounds, &points[0]);
+			} else {
+				rect_enlarge_to(&bounds, &points[k]);
+			}
+		}
+	}
+
+	/* then, count the points in the grid, and split it into tiles */
+	tiles = tiles_create(&bounds, eps);
+	if (!tiles) {
+		FREEALL();
+		return -1;
+	}
+
+	rewind(in);
+	for (i = 0; i < n; i += m) {
+		m = read_points(in, offset, stride, n, i, buf, points);
+		if (!m) {
+			FREEALL();
+			return -1;
+		}
+		for (k = 0; k < m; ++k) {
+			tiles_count(tiles, &points[k]);
+		}
+	}
+
+	if (tiles_split(tiles, (mem_bytes - mem_bytes / 4) / TILE_POINT_BYTES + 1)) {
+		FREEALL();
+		return -1;
+	}
+	n_tiles = tiles_size(tiles);
+
+	/* then, spill each point to its tile, and the tiles it is in the halo of, a quarter of the memory buffering them */
+	sp.file = tmpfile();
+	sp.n_tiles = n_tiles;
+	sp.per_tile = mem_bytes / 4 / n_tiles / sizeof(spill_t);
+	sp.per_tile = sp.per_tile < SPILL_RECORDS_MIN ? SPILL_RECORDS_MIN
+		: sp.per_tile > SPILL_RECORDS_MAX ? SPILL_RECORDS_MAX : sp.per_tile;
+	sp.bufs = (spill_t *) malloc(sizeof(spill_t) * sp.per_tile * n_tiles);
+	sp.counts = (size_t *) calloc(n_tiles, sizeof(size_t));
+	sp.runs = (array_p *) calloc(n_tiles, sizeof(array_p));
+	if (!sp.file || !sp.bufs || !sp.counts || !sp.runs) {
+		FREEALL();
+		return -1;
+	}
+	for (t = 0; t < n_tiles; ++t) {
+		sp.runs[t] = array_create_typed(sizeof(spill_run_t), 16);
+		if (!sp.runs[t]) {
+			FREEALL();
+			return -1;
+		}
+	}
+
+	rewind(in);
+	for (i = 0; i < n; i += m) {
+		m = read_points(in, offset, stride, n, i, buf, points);
+		if (!m) {
+			FREEALL();
+			return -1;
+		}
+		for (k = 0; k < m; ++k) {
+			size_t h, n_halo = tiles_halo(tiles, &points[k], halo);
+
+			if (spill(&sp, tiles_owner(tiles, &points[k]), &points[k], (i + k) | SPILL_OWNED)) {
+				FREEALL();
+				return -1;
+			}
+			for (h = 0; h < n_halo; ++h) {
+				if (spill(&sp, halo[h], &points[k], i + k)) {
+					FREEALL();
+					return -1;
+				}
+			}
+		}
+	}
+	for (t = 0; t < n_tiles; ++t) {
+		if (spill_flush(&sp, t)) {
+			FREEALL();
+			return -1;
+		}
+	}
+	free(sp.bufs);
+	sp.bufs = NULL;
+	fclose(in);
+	in = NULL;
+
+	/*
+	 * Cluster tile by tile. The ids of the clusters of all the tiles are
+	 * distinct, 0 standing for the noise, and the ids of the core points
+	 * are written negated, to be merged later.
+	 */
+	ctx = dbscan_context_create();
+	uf = unionfind_create(1);
+	halo_file = tmpfile();
+	if (!ctx || !uf || !halo_file) {
+		FREEALL();
+		return -1;
+	}
+
+	for (t = 0; t < n_tiles; ++t) {
+		array_p runs = sp.runs[t];
+		size_t base = unionfind_size(uf), count = 0;
+		int c;
+
+		for (k = 0; k < array_size(runs); ++k) {
+			count += ((spill_run_p) array_get(runs, k))->count;
+		}
+		if (!count) {
+			continue;
+		}
+
+		if (reserve(NULL, (void **) &tile, &tile_n, count, sizeof(spill_t))
+				|| reserve(NULL, (void **) &labels, &labels_n, count, sizeof(int32_t))
+				|| reserve(NULL, (void **) &core, &core_n, count, sizeof(unsigned char))) {
+			FREEALL();
+			return -1;
+		}
+
+		count = 0;
+		for (k = 0; k < array_size(runs); ++k) {
+			spill_run_p run = (spill_run_p) array_get(runs, k);
+
+			if (fseeko(sp.file, run->offset, SEEK_SET)
+					|| fread(tile + count, sizeof(spill_t), run->count, sp.file) != run->count) {
+				FREEALL();
+				return -1;
+			}
+			count += run->count;
+		}
+
+		c = dbscan_context_core_labels(ctx, &tile[0].x, sizeof(spill_t), count, eps, min_pts, flags, labels, core);
+		if (c < 0 || unionfind_grow(uf, base + c)) {
+			FREEALL();
+			return -1;
+		}
+
+		for (k = 0; k < count; ++k) {
+			unsigned long long index = tile[k].index & ~SPILL_OWNED;
+			int32_t id = labels[k] ? (int32_t) (base + labels[k] - 1) : 0;
+
+			if (tile[k].index & SPILL_OWNED) {
+				out[index] = core[k] ? -id : id;
+			} else if (id) {
+				halo_t h = { .index = index, .id = id };
+
+				if (fwrite(&h, sizeof(halo_t), 1, halo_file) != 1) {
+					FREEALL();
+					return -1;
+				}
+			}
+		}
+	}
+
+	/*
+	 * Merge the clusters across the tiles: a cluster reaching a core point
+	 * of another tile is the same cluster as that point's, and a border
+	 * point left as noise in its own tile joins the cluster reaching it.
+	 */
+	rewind(halo_file);
+	for (;;) {
+		halo_t hs[READ_RECORDS / 4];
+		size_t got = fread(hs, sizeof(halo_t), READ_RECORDS / 4, halo_file);
+
+		for (k = 0; k < got; ++k) {
+			int32_t own = out[hs[k].index];
+
+			if (own < 0) {
+				unionfind_union(uf, (unsigned int) -own, (unsigned int) hs[k].id);
+			} else if (!own) {
+				out[hs[k].index] = hs[k].id;
+			}
+		}
+		if (got < READ_RECORDS / 4) {
+			break;
+		}
+	}
+	if (ferror(halo_file)) {
+		FREEALL();
+		return -1;
+	}
+
+	/* at last, number the merged clusters in the order they first appear */
+	compact = (int32_t *) calloc(unionfind_size(uf), sizeof(int32_t));
+	if (!compact) {
+		FREEALL();
+		return -1;
+	}
+
+	r = 0;
+	for (i = 0; i < n; ++i) {
+		int32_t id = out[i] < 0 ? -out[i] : out[i];
+
+		if (id) {
+			unsigned int root = unionfind_find(uf, (unsigned int) id);
+
+			if (!compact[root]) {
+				compact[root] = ++r;
 			}
-			kdtree_destroy(noise_tree);
+			out[i] = compact[root];
 		}
-		array_destroy(noise2);
+	}
+
+	if (msync(out, sizeof(int32_t) * n, MS_SYNC)) {
+		r = -1;
 	}
 
 	FREEALL();
-	return next_id;
+	return r;
 
 #undef FREEALL
 
 }
 
+
+int dbscan_cluster_sorted_file(const char *path, size_t offset, size_t stride, double eps, size_t min_pts,
+		const char *labels_path)
+{
+	size_t i, k, m, n = 0;
+	int r = -1;
+	struct stat st;
+	FILE *in = NULL, *out = NULL;
+	char *buf = NULL;
+	point_t *points = NULL;
+	int32_t *labels = NULL;
+	strip_p strip = NULL;
+
+#define FREEALL()\
+	{\
+		if (in) { fclose(in); in = NULL; }\
+		if (out) { fclose(out); out = NULL; }\
+		free(buf); buf = NULL;\
+		free(points); points = NULL;\
+		free(labels); labels = NULL;\
+		strip_destroy(strip); strip = NULL;\
+	}
+
+	stride = stride ? stride : sizeof(double) * 2;
+
+	/* the point must lie within its record */
+	if (offset > stride || stride - offset < sizeof(point_t)) {
+		return -1;
+	}
+
+	in = fopen(path, "rb");
+	out = fopen(labels_path, "wb");
+	buf = (char *) malloc(stride * READ_RECORDS);
+	points = (point_t *) malloc(sizeof(point_t) * READ_RECORDS);
+	labels = (int32_t *) malloc(sizeof(int32_t) * READ_RECORDS);
+	strip = strip_create(eps * eps, (double) min_pts);
+	if (!in || !out || !buf || !points || !labels || !strip || fstat(fileno(in), &st)) {
+		FREEALL();
+		return -1;
+	}
+
+	/* sweep the points as they are read, the strip failing on any point out of x order */
+	n = (size_t) st.st_size / stride;
+	for (i = 0; i < n; i += m) {
+		m = read_points(in, offset, stride, n, i, buf, points);
+		if (!m) {
+			FREEALL();
+			return -1;
+		}
+		for (k = 0; k < m; ++k) {
+			if (strip_push(strip, &points[k], 1.0)) {
+				FREEALL();
+				return -1;
+			}
+		}
+	}
+
+	r = strip_finish(strip);
+	for (i = 0; r >= 0 && i < n; i += m) {
+		m = n - i < READ_RECORDS ? n - i : READ_RECORDS;
+		for (k = 0; k < m; ++k) {
+			labels[k] = strip_label(strip, i + k);
+		}
+		if (fwrite(labels, sizeof(int32_t), m, out) != m) {
+			r = -1;
+		}
+	}
+
+	if (fclose(out)) {
+		r = -1;
+	}
+	out = NULL;
+
+	FREEALL();
+	return r;
+
+#undef FREEALL
+
+}
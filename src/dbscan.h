@@ -2,8 +2,10 @@
 #define _DBSCAN_H_
 
 #include "geo.h"
+#include "alloc.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 
 
 /*
@@ -38,5 +40,437 @@ void cpoint_init(cpoint_p cpoint, double x, double y);
 int dbscan_cluster(cpoint_p *cpoints, size_t n, double eps, size_t min_pts);
 
 
+/*
+ * Flags for dbscan_cluster_ex.
+ */
+
+/* lay the points out along a Hilbert curve before indexing them */
+#define DBSCAN_SFC_ORDER 0x01
+
+/*
+ * search all the neighbourhoods once, in parallel, into a neighbour graph
+ * of 4 bytes per pair of neighbours, and expand the clusters over it
+ */
+#define DBSCAN_NBGRAPH 0x02
+
+/*
+ * cluster exactly as the DBSCAN paper does, with a result depending only on
+ * the points and their order, byte-identical from run to run:
+ * - the noise is 0, instead of being grouped into clusters of its own;
+ * - a border point joins the cluster with the first core point among
+ *   the clusters of the core points within eps of it;
+ * - the clusters are numbered in the order of their first core points.
+ * It's the same result as distrib_cluster_labels, and takes precedence
+ * over DBSCAN_NBGRAPH.
+ */
+#define DBSCAN_CANONICAL 0x04
+
+/*
+ * keep the statistics of each cluster in the context, computed from the
+ * pointsets the clustering holds, see dbscan_context_stats
+ */
+#define DBSCAN_STATS 0x08
+
+/*
+ * cluster as DBSCAN_CANONICAL describes, but with no kd-tree: sweeping the
+ * pointsets in the x order they are sorted in, with only the strip of the
+ * ones within eps in x in the sweep, see strip.h. Without DBSCAN_CANONICAL,
+ * a border point joins the cluster of the first core point within eps of it
+ * in x order, and the clusters are numbered in x order. DBSCAN_SFC_ORDER
+ * doesn't apply.
+ */
+#define DBSCAN_PLANE_SWEEP 0x10
+
+
+/*
+ * Same as dbscan_cluster, with flags being the bitwise OR of the DBSCAN_* flags above.
+ */
+int dbscan_cluster_ex(cpoint_p *cpoints, size_t n, double eps, size_t min_pts, int flags);
+
+
+/*
+ * Cluster the points in a coordinate buffer, using DBSCAN.
+ *
+ * The x of each point is a double, immediately followed by its y.
+ * Neither the points nor cpoint_p pointers to them are copied, so coords
+ * can point into the caller's own records, or into mmapped data.
+ *
+ * coords: coordinates of the first point
+ * stride: bytes from one point to the next, 0 for tightly packed points
+ * labels: receives the cluster id of each point, MUST have space for n items
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int dbscan_cluster_labels(const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+
+/*
+ * Context for clustering repeatedly.
+ *
+ * It keeps the memory used by a clustering for the next one, so clustering
+ * many inputs of similar sizes with the same context stops allocating.
+ */
+typedef struct s_dbscan_context *dbscan_context_p;
+
+
+/*
+ * Create a context.
+ *
+ * NOTE: the context created by this function MUST be destroyed by the caller,
+ * using dbscan_context_destroy.
+ */
+dbscan_context_p dbscan_context_create();
+
+
+/*
+ * Same as dbscan_context_create, with the memory the context keeps coming from the allocator.
+ *
+ * The structures built for one clustering only, as the union-find of
+ * dbscan_context_sample_labels and the ordering of dbscan_context_optics,
+ * come from an arena of the context, kept for the next clustering too.
+ */
+dbscan_context_p dbscan_context_create_with(allocator_p a);
+
+
+/*
+ * Destroy the context, release all memories it uses.
+ */
+void dbscan_context_destroy(dbscan_context_p ctx);
+
+
+/*
+ * Same as dbscan_cluster_ex, working in the context.
+ *
+ * NOTE: a context MUST NOT be used by more than one clustering at a time.
+ */
+int dbscan_context_cluster(dbscan_context_p ctx, cpoint_p *cpoints, size_t n,
+		double eps, size_t min_pts, int flags);
+
+
+/*
+ * Same as dbscan_cluster_labels, working in the context.
+ */
+int dbscan_context_cluster_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+/*
+ * Same as dbscan_cluster_labels, for fixed-point coordinates, e.g. micro-degrees,
+ * as int32_t: x of a point, followed by y; stride bytes from one point to the
+ * next, 0 for 2 int32_t.
+ *
+ * The points are deduplicated by a radix sort of their coordinates, instead
+ * of comparing them as doubles, and the buffer takes half the memory. The
+ * distances are exact for eps below 2^26 units of the coordinates, as the
+ * squared distances within eps are integers a double holds.
+ *
+ * eps: radius of the neighbourhood, in units of the coordinates
+ */
+int dbscan_fixed_labels(const int32_t *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+/*
+ * Same as dbscan_fixed_labels, working in the context.
+ */
+int dbscan_context_fixed_labels(dbscan_context_p ctx, const int32_t *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+/*
+ * Same as dbscan_cluster_labels, each point weighing its weight instead of 1
+ * in the min_pts test, e.g. for the counts of pre-aggregated bins.
+ *
+ * weights: the weight of each point, an integer or not, MUST be n items
+ *
+ * NOTE: the statistics of DBSCAN_STATS still count each point once.
+ */
+int dbscan_weighted_labels(const double *coords, size_t stride, size_t n, const double *weights,
+		double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+/*
+ * Same as dbscan_weighted_labels, working in the context.
+ */
+int dbscan_context_weighted_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		const double *weights, double eps, size_t min_pts, int flags, int32_t *labels);
+
+
+/*
+ * Statistics of a cluster, in a form two of which can be merged,
+ * e.g. for the parts of a cluster clustered apart.
+ */
+typedef struct s_dbscan_stats
+{
+	/* number of points */
+	size_t size;
+
+	point_t centroid;
+
+	/* sum of the squared distances from the points to the centroid, the variance being m2 / size */
+	double m2;
+
+	rect_t rect;
+
+	/* vertices of the convex hull */
+	point_t *hull;
+	size_t hull_size;
+}
+dbscan_stats_t, *dbscan_stats_p;
+
+
+/*
+ * Get the statistics of the clusters of the last clustering in the context,
+ * done with DBSCAN_STATS by dbscan_context_cluster or dbscan_context_cluster_labels.
+ *
+ * The statistics of cluster id are at index id - 1, a cluster left
+ * without any point having size 0.
+ *
+ * n: receives the number of clusters
+ *
+ * NOTE: the statistics, hulls included, belong to the context, and are valid
+ * until its next clustering.
+ *
+ * Returns: the statistics if any;
+ *          NULL if the last clustering is done without DBSCAN_STATS.
+ */
+const dbscan_stats_t *dbscan_context_stats(dbscan_context_p ctx, size_t *n);
+
+
+/*
+ * Merge the statistics from into the statistics into.
+ *
+ * hull: receives the convex hull of both hulls, the hull of into being set to it,
+ *       MUST have space for into->hull_size + from->hull_size points,
+ *       and MUST NOT overlap any of them
+ *
+ * NOTE: the hulls are merged in a buffer from malloc.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int dbscan_stats_merge(dbscan_stats_p into, const dbscan_stats_t *from, point_t *hull);
+
+
+
+/*
+ * Cluster the points in a coordinate buffer exactly as the DBSCAN paper does,
+ * telling which points are core points.
+ *
+ * Unlike dbscan_cluster_labels, the points which belong to no cluster are
+ * left as 0, so that the clusterings of the parts of a point set can be
+ * merged: two clusters sharing a core point are the same cluster.
+ *
+ * A few thousand points or less are clustered without any kd-tree, scanning
+ * all of them for the neighbours of each, which makes it the fastest way to
+ * cluster many small tiles, in a context.
+ *
+ * core: receives 1 for each core point, 0 for the others, MUST have space for n items
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int dbscan_core_labels(const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels, unsigned char *core);
+
+
+/*
+ * Same as dbscan_core_labels, working in the context.
+ */
+int dbscan_context_core_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, int32_t *labels, unsigned char *core);
+
+
+
+/*
+ * Cluster the points in a file, which may be larger than the memory,
+ * as dbscan_core_labels does.
+ *
+ * The file is a sequence of records of stride bytes, 0 for 2 doubles, with the
+ * x of each point at offset bytes of its record, immediately followed by its y.
+ *
+ * The space is split into tiles, each holding about mem_bytes of points with
+ * its halo, i.e. the points of the other tiles within eps of it. The points are
+ * spilled to a temporary file tile by tile, and each tile is read back and
+ * clustered in turn. The clusters of the tiles are merged through their halo
+ * points, so the clusters are the ones of clustering the whole file at once.
+ *
+ * labels_path: the file receiving the cluster id of each point as an int32_t,
+ *              0 for noise, created or truncated
+ *
+ * NOTE: a tile can't be smaller than a cell of 2 eps wide, which may hold
+ * more than mem_bytes of points.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed, or the point at offset doesn't fit in stride bytes.
+ */
+int dbscan_cluster_file(const char *path, size_t offset, size_t stride, double eps, size_t min_pts,
+		int flags, size_t mem_bytes, const char *labels_path);
+
+
+/*
+ * Cluster the points in a file sorted by x, which may be larger than the
+ * memory, as dbscan_core_labels does with DBSCAN_PLANE_SWEEP.
+ *
+ * The file is read once, as dbscan_cluster_file reads it, and swept along x,
+ * only the points within eps in x of the ones being searched being in memory,
+ * and 9 bytes for each point besides. The labels are written once finished.
+ *
+ * labels_path: the file receiving the cluster id of each point as an int32_t,
+ *              0 for noise, created or truncated
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed, the points are not sorted by x, or the point at
+ *             offset doesn't fit in stride bytes.
+ */
+int dbscan_cluster_sorted_file(const char *path, size_t offset, size_t stride, double eps, size_t min_pts,
+		const char *labels_path);
+
+
+
+/*
+ * Parameters of one clustering.
+ */
+typedef struct s_dbscan_params
+{
+	double eps;
+	size_t min_pts;
+}
+dbscan_params_t, *dbscan_params_p;
+
+
+/*
+ * Cluster the points in a coordinate buffer with each of the params,
+ * as dbscan_cluster_labels does.
+ *
+ * The neighbours are searched only once, at the largest eps, and every
+ * clustering is derived from them. The clusters are expanded over all the
+ * neighbours of the core points, so they may differ from the ones of
+ * dbscan_cluster_labels, which expands only from the convex hulls.
+ *
+ * labels: receives the cluster ids for params[k] at labels + n * k,
+ *         MUST have space for n * n_params items
+ * clusters: receives the numbers of clusters for params[k] at clusters[k],
+ *           or NULL
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int dbscan_sweep_labels(const double *coords, size_t stride, size_t n,
+		dbscan_params_p params, size_t n_params, int flags, int32_t *labels, int *clusters);
+
+
+/*
+ * Same as dbscan_sweep_labels, working in the context.
+ */
+int dbscan_context_sweep_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		dbscan_params_p params, size_t n_params, int flags, int32_t *labels, int *clusters);
+
+
+
+/*
+ * Compute the OPTICS cluster ordering of the points in a coordinate buffer,
+ * from which the clusterings for any eps no larger than the one given here
+ * can be extracted by dbscan_optics_labels.
+ *
+ * Each point is visited once, its neighbours within eps being searched
+ * in a kd-tree, and the points to visit next are kept in an indexed
+ * priority queue.
+ *
+ * order: receives the indexes of the points in the order they are visited,
+ *        MUST have space for n items
+ * core_dist: receives the core distance of each point, INFINITY if it is not
+ *            a core point within eps, MUST have space for n items
+ * reach: receives the reachability distance of each point, INFINITY if it is
+ *        not reached from any core point, MUST have space for n items
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int dbscan_optics(const double *coords, size_t stride, size_t n, double eps, size_t min_pts, int flags,
+		unsigned int *order, double *core_dist, double *reach);
+
+
+/*
+ * Same as dbscan_optics, working in the context.
+ */
+int dbscan_context_optics(dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, int flags, unsigned int *order, double *core_dist, double *reach);
+
+
+/*
+ * Extract the clustering at eps from the ordering computed by dbscan_optics,
+ * in a single pass over it.
+ *
+ * labels: receives the cluster id of each point, 0 for noise
+ *
+ * NOTE: unlike the other functions, the points which belong to no cluster are
+ * left as noise. A border point visited before all of its core points is
+ * also left as noise.
+ *
+ * Returns: the numbers of clusters.
+ */
+int dbscan_optics_labels(const unsigned int *order, const double *core_dist, const double *reach,
+		size_t n, double eps, int32_t *labels);
+
+
+
+/*
+ * Cluster the points in a coordinate buffer from a sample of them, as DBSCAN++
+ * does, otherwise as dbscan_core_labels does.
+ *
+ * Only the sampled points are searched for their neighbours, among all the
+ * points, to tell the core points among them. The sampled core points within
+ * eps of each other are in the same cluster, and every point then joins the
+ * cluster of its nearest sampled core point within eps, or is left as noise.
+ * The sample is uniform among the distinct points, and the same from run to run.
+ *
+ * With all the points sampled, the core points are clustered exactly as
+ * DBSCAN does.
+ *
+ * sample: the number of distinct points sampled, or the fraction of them up to 1
+ * core: receives 1 for each sampled core point, 0 for the others, or NULL
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int dbscan_sample_labels(const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, double sample, int flags, int32_t *labels, unsigned char *core);
+
+
+/*
+ * Same as dbscan_sample_labels, working in the context.
+ */
+int dbscan_context_sample_labels(dbscan_context_p ctx, const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, double sample, int flags, int32_t *labels, unsigned char *core);
+
+
+
+/*
+ * Cluster the points in a coordinate buffer by rho-approximate DBSCAN,
+ * in expected linear time, as dbscan_core_labels does otherwise.
+ *
+ * The points are put in a grid of cells eps wide across their diagonal, and
+ * no kd-tree is built. The core points are exactly the ones of DBSCAN, but
+ * two core points may be in the same cluster if they are linked through core
+ * points within eps * (1 + rho) of each other, not only eps: the clusters are
+ * unions of the clusters of DBSCAN at eps, and each is within a cluster of
+ * DBSCAN at eps * (1 + rho).
+ *
+ * rho: the approximation, e.g. 0.001, or 0 to cluster exactly
+ * core: receives 1 for each core point, 0 for the others, or NULL
+ *
+ * NOTE: the cluster ids are not the ones of dbscan_core_labels, even with rho 0.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int dbscan_rho_labels(const double *coords, size_t stride, size_t n,
+		double eps, size_t min_pts, double rho, int32_t *labels, unsigned char *core);
+
+
 #endif /* _DBSCAN_H_ */
 
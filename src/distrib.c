@@ -0,0 +1,675 @@
+#include "distrib.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "geo.h"
+#include "array.h"
+#include "kdtree.h"
+#include "tiles.h"
+#include "unionfind.h"
+#include "dbscan.h"
+
+
+/* tiles split for each part, so that the parts can be balanced */
+#define TILES_PER_PART 4
+
+
+/*
+ * What a worker is asked to do, sent before its points.
+ */
+typedef struct s_job
+{
+	uint64_t n;
+	double eps;
+	uint64_t min_pts;
+	int32_t flags;
+}
+job_t;
+
+
+/*
+ * The points of a part and the halo around it, and how the worker
+ * clustering them is reached.
+ */
+typedef struct s_part
+{
+	/* indexes of the points, the first owned of them belonging to the part */
+	array_p index;
+	size_t owned;
+
+	/* points in the tiles of the part */
+	size_t load;
+
+	/* the socket of the worker and its pid, or -1 for this process */
+	int fd;
+	pid_t pid;
+
+	point_t *points;
+
+	/* cluster of each point in the part, negated for the core points */
+	int32_t *ids;
+
+	/* first core point of the cluster of each point, -1 if it is not a core point */
+	int64_t *keys;
+}
+part_t, *part_p;
+
+
+static int write_full(int fd, const void *buf, size_t bytes)
+{
+	const char *p = (const char *) buf;
+
+	while (bytes) {
+		ssize_t w = send(fd, p, bytes, MSG_NOSIGNAL);
+
+		if (w < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		p += w;
+		bytes -= (size_t) w;
+	}
+	return 0;
+}
+
+
+static int read_full(int fd, void *buf, size_t bytes)
+{
+	char *p = (char *) buf;
+
+	while (bytes) {
+		ssize_t r = recv(fd, p, bytes, 0);
+
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		if (!r) {
+			return -1;
+		}
+		p += r;
+		bytes -= (size_t) r;
+	}
+	return 0;
+}
+
+
+/*
+ * Cluster the points of a part.
+ *
+ * ids: receives the cluster of each point, negated for the core points
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int work_cluster(point_t *points, size_t n, double eps, size_t min_pts, int flags, int32_t *ids)
+{
+	size_t k;
+	unsigned char *core = (unsigned char *) malloc(n ? n : 1);
+
+	if (!core || dbscan_core_labels(&points[0].x, sizeof(point_t), n, eps, min_pts, flags, ids, core) < 0) {
+		free(core);
+		return -1;
+	}
+
+	for (k = 0; k < n; ++k) {
+		if (core[k]) {
+			ids[k] = -ids[k];
+		}
+	}
+
+	free(core);
+	return 0;
+}
+
+
+/*
+ * Assign the border points of a part, given the keys of the core points.
+ *
+ * Since the duplicates of a point are all core points or none, and
+ * all in the same cluster, the kd-tree keeping only one of them is enough.
+ *
+ * keys: the key of each point, -1 if it is not a core point
+ * result: receives the key of each core point, and the smallest key of the core
+ *         points within eps of each other point, -1 if none
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int work_borders(point_t *points, size_t n, double eps, const int64_t *keys, int64_t *result)
+{
+	size_t k, j;
+	point_p *list = (point_p *) malloc(sizeof(point_p) * (n ? n : 1));
+	array_p nn = array_create(64);
+	kdtree_p tree = NULL;
+
+#define FREEALL()\
+	{\
+		free(list); list = NULL;\
+		array_destroy(nn); nn = NULL;\
+		kdtree_destroy(tree); tree = NULL;\
+	}
+
+	if (!list || !nn) {
+		FREEALL();
+		return -1;
+	}
+	if (!n) {
+		FREEALL();
+		return 0;
+	}
+
+	for (k = 0; k < n; ++k) {
+		list[k] = &points[k];
+	}
+	tree = kdtree_create_static(list, n);
+	if (!tree) {
+		FREEALL();
+		return -1;
+	}
+
+	for (k = 0; k < n; ++k) {
+		result[k] = keys[k];
+		if (keys[k] >= 0) {
+			continue;
+		}
+
+		array_clear(nn);
+		if (kdtree_neighbours(tree, &points[k], eps * eps, nn)) {
+			FREEALL();
+			return -1;
+		}
+		for (j = 0; j < array_size(nn); ++j) {
+			point_p q = NULL; // non-allocated pointer
+			int64_t key;
+
+			array_at(nn, j, (void **) &q);
+			key = keys[(point_t *) q - points];
+			if (key >= 0 && (result[k] < 0 || key < result[k])) {
+				result[k] = key;
+			}
+		}
+	}
+
+	FREEALL();
+	return 0;
+
+#undef FREEALL
+
+}
+
+
+/*
+ * The worker process, doing the job coming from fd.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int serve(int fd)
+{
+	int r = -1;
+	job_t job;
+	point_t *points = NULL;
+	int32_t *ids = NULL;
+	int64_t *keys = NULL, *result = NULL;
+
+	if (read_full(fd, &job, sizeof(job_t))) {
+		return -1;
+	}
+
+	points = (point_t *) malloc(sizeof(point_t) * (job.n ? job.n : 1));
+	ids = (int32_t *) malloc(sizeof(int32_t) * (job.n ? job.n : 1));
+	keys = (int64_t *) malloc(sizeof(int64_t) * (job.n ? job.n : 1));
+	result = (int64_t *) malloc(sizeof(int64_t) * (job.n ? job.n : 1));
+
+	if (points && ids && keys && result
+			&& !read_full(fd, points, sizeof(point_t) * job.n)
+			&& !work_cluster(points, job.n, job.eps, job.min_pts, job.flags, ids)
+			&& !write_full(fd, ids, sizeof(int32_t) * job.n)
+			&& !read_full(fd, keys, sizeof(int64_t) * job.n)
+			&& !work_borders(points, job.n, job.eps, keys, result)
+			&& !write_full(fd, result, sizeof(int64_t) * job.n)) {
+		r = 0;
+	}
+
+	free(points);
+	free(ids);
+	free(keys);
+	free(result);
+	return r;
+}
+
+
+/*
+ * Start the worker of the part.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int start_worker(part_p parts, unsigned int n_parts, unsigned int w)
+{
+	unsigned int i;
+	int sv[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)) {
+		return -1;
+	}
+
+	parts[w].pid = fork();
+	if (parts[w].pid < 0) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+
+	if (!parts[w].pid) {
+		/* the worker, talking only to the coordinator */
+		close(sv[0]);
+		for (i = 0; i < n_parts; ++i) {
+			if (parts[i].fd >= 0) {
+				close(parts[i].fd);
+			}
+		}
+		_exit(serve(sv[1]) ? 1 : 0);
+	}
+
+	close(sv[1]);
+	parts[w].fd = sv[0];
+	return 0;
+}
+
+
+/*
+ * Ask the part for the clusters of its points, into part->ids.
+ */
+static int request_ids(part_p part, double eps, size_t min_pts, int flags)
+{
+	size_t n = array_size(part->index);
+	job_t job = { .n = n, .eps = eps, .min_pts = min_pts, .flags = flags };
+
+	if (part->fd < 0) {
+		return work_cluster(part->points, n, eps, min_pts, flags, part->ids);
+	}
+
+	if (write_full(part->fd, &job, sizeof(job_t))
+			|| write_full(part->fd, part->points, sizeof(point_t) * n)) {
+		return -1;
+	}
+	return 0;
+}
+
+
+static int receive_ids(part_p part)
+{
+	if (part->fd < 0) {
+		return 0;
+	}
+	return read_full(part->fd, part->ids, sizeof(int32_t) * array_size(part->index));
+}
+
+
+/*
+ * Ask the part to assign its border points, from part->keys into part->keys.
+ */
+static int request_borders(part_p part, double eps, int64_t *result)
+{
+	size_t n = array_size(part->index);
+
+	if (part->fd < 0) {
+		if (work_borders(part->points, n, eps, part->keys, result)) {
+			return -1;
+		}
+		memcpy(part->keys, result, sizeof(int64_t) * n);
+		return 0;
+	}
+
+	return write_full(part->fd, part->keys, sizeof(int64_t) * n);
+}
+
+
+static int receive_borders(part_p part)
+{
+	if (part->fd < 0) {
+		return 0;
+	}
+	return read_full(part->fd, part->keys, sizeof(int64_t) * array_size(part->index));
+}
+
+
+/*
+ * Split the points into n_parts parts of whole tiles, the largest tiles
+ * first going to the least loaded part, and add the halo of each part to it.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int split_parts(tiles_p tiles, const double *coords, size_t stride, size_t n,
+		part_p parts, unsigned int n_parts)
+{
+	unsigned int w, halo[3];
+	size_t i, j, n_tiles = tiles_size(tiles);
+	unsigned int *order = (unsigned int *) malloc(sizeof(unsigned int) * n_tiles);
+	unsigned int *owner = (unsigned int *) malloc(sizeof(unsigned int) * n_tiles);
+
+	if (!order || !owner) {
+		free(order);
+		free(owner);
+		return -1;
+	}
+
+	/* insertion sort by points, there are only a few tiles per part */
+	for (i = 0; i < n_tiles; ++i) {
+		for (j = i; j > 0 && tiles_points(tiles, order[j - 1]) < tiles_points(tiles, (unsigned int) i); --j) {
+			order[j] = order[j - 1];
+		}
+		order[j] = (unsigned int) i;
+	}
+
+	for (i = 0; i < n_tiles; ++i) {
+		unsigned int least = 0;
+
+		for (w = 1; w < n_parts; ++w) {
+			if (parts[w].load < parts[least].load) {
+				least = w;
+			}
+		}
+		owner[order[i]] = least;
+		parts[least].load += tiles_points(tiles, order[i]);
+	}
+
+	/* first the points owned, then the halo */
+	for (i = 0; i < n; ++i) {
+		point_p p = (point_p) ((const char *) coords + stride * i);
+
+		if (array_push(parts[owner[tiles_owner(tiles, p)]].index, &i)) {
+			free(order);
+			free(owner);
+			return -1;
+		}
+	}
+	for (w = 0; w < n_parts; ++w) {
+		parts[w].owned = array_size(parts[w].index);
+	}
+
+	for (i = 0; i < n; ++i) {
+		point_p p = (point_p) ((const char *) coords + stride * i);
+		unsigned int own = owner[tiles_owner(tiles, p)], added[3];
+		size_t h, a, n_added = 0, n_halo = tiles_halo(tiles, p, halo);
+
+		for (h = 0; h < n_halo; ++h) {
+			w = owner[halo[h]];
+			for (a = 0; a < n_added && added[a] != w; ++a);
+			if (w == own || a < n_added) {
+				continue;
+			}
+
+			added[n_added++] = w;
+			if (array_push(parts[w].index, &i)) {
+				free(order);
+				free(owner);
+				return -1;
+			}
+		}
+	}
+
+	free(order);
+	free(owner);
+	return 0;
+}
+
+
+int distrib_cluster_labels(const double *coords, size_t stride, size_t n, double eps, size_t min_pts,
+		int flags, unsigned int workers, int32_t *labels)
+{
+	unsigned int w, n_parts = workers ? workers : 1;
+	size_t i, k;
+	int r = -1;
+	rect_t bounds;
+	tiles_p tiles = NULL;
+	part_p parts = NULL;
+	unionfind_p uf = NULL;
+	int64_t *keys = NULL, *result = NULL;
+	int32_t *compact = NULL;
+
+#define FREEALL()\
+	{\
+		if (parts) {\
+			for (w = 0; w < n_parts; ++w) {\
+				if (parts[w].fd >= 0) {\
+					close(parts[w].fd);\
+				}\
+				if (parts[w].pid > 0) {\
+					waitpid(parts[w].pid, NULL, 0);\
+				}\
+				array_destroy(parts[w].index);\
+				free(parts[w].points);\
+				free(parts[w].ids);\
+				free(parts[w].keys);\
+			}\
+			free(parts); parts = NULL;\
+		}\
+		tiles_destroy(tiles); tiles = NULL;\
+		unionfind_destroy(uf); uf = NULL;\
+		free(keys); keys = NULL;\
+		free(result); result = NULL;\
+		free(compact); compact = NULL;\
+	}
+
+	stride = stride ? stride : sizeof(double) * 2;
+	memset(labels, 0, sizeof(int32_t) * n);
+	if (!n) {
+		return 0;
+	}
+
+	for (i = 0; i < n; ++i) {
+		point_p p = (point_p) ((const char *) coords + stride * i);
+
+		if (!i) {
+			rect_init_point(&bounds, p);
+		} else {
+			rect_enlarge_to(&bounds, p);
+		}
+	}
+
+	tiles = tiles_create(&bounds, eps);
+	parts = (part_p) calloc(n_parts, sizeof(part_t));
+	uf = unionfind_create(1);
+	if (!tiles || !parts || !uf) {
+		FREEALL();
+		return -1;
+	}
+
+	for (w = 0; w < n_parts; ++w) {
+		parts[w].fd = -1;
+		parts[w].pid = -1;
+		parts[w].index = array_create_typed(sizeof(size_t), n / n_parts + 1);
+		if (!parts[w].index) {
+			FREEALL();
+			return -1;
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		tiles_count(tiles, (point_p) ((const char *) coords + stride * i));
+	}
+	if (tiles_split(tiles, n / n_parts / TILES_PER_PART + 1)
+			|| split_parts(tiles, coords, stride, n, parts, n_parts)) {
+		FREEALL();
+		return -1;
+	}
+
+	for (w = 0; w < n_parts; ++w) {
+		part_p part = &parts[w];
+		size_t m = array_size(part->index);
+		size_t *index = (size_t *) array_data(part->index);
+
+		part->points = (point_t *) malloc(sizeof(point_t) * (m ? m : 1));
+		part->ids = (int32_t *) malloc(sizeof(int32_t) * (m ? m : 1));
+		part->keys = (int64_t *) malloc(sizeof(int64_t) * (m ? m : 1));
+		if (!part->points || !part->ids || !part->keys) {
+			FREEALL();
+			return -1;
+		}
+		for (k = 0; k < m; ++k) {
+			memcpy(&part->points[k], (const char *) coords + stride * index[k], sizeof(point_t));
+		}
+	}
+
+	if (workers) {
+		for (w = 0; w < n_parts; ++w) {
+			if (start_worker(parts, n_parts, w)) {
+				FREEALL();
+				return -1;
+			}
+		}
+	}
+
+	/* cluster the parts, all the workers at the same time */
+	for (w = 0; w < n_parts; ++w) {
+		if (request_ids(&parts[w], eps, min_pts, flags)) {
+			FREEALL();
+			return -1;
+		}
+	}
+
+	/*
+	 * Give the clusters of all the parts distinct ids, 0 standing for the noise,
+	 * and the points owned by each part their ids, negated for the core points.
+	 */
+	for (w = 0; w < n_parts; ++w) {
+		part_p part = &parts[w];
+		size_t m = array_size(part->index), base = unionfind_size(uf);
+		size_t *index = (size_t *) array_data(part->index);
+		int32_t max_id = 0;
+
+		if (receive_ids(part)) {
+			FREEALL();
+			return -1;
+		}
+
+		for (k = 0; k < m; ++k) {
+			int32_t id = part->ids[k] < 0 ? -part->ids[k] : part->ids[k];
+
+			if (id) {
+				max_id = id > max_id ? id : max_id;
+				id = (int32_t) (base + id - 1);
+				part->ids[k] = part->ids[k] < 0 ? -id : id;
+			}
+			if (k < part->owned) {
+				labels[index[k]] = part->ids[k];
+			}
+		}
+
+		if (unionfind_grow(uf, base + max_id)) {
+			FREEALL();
+			return -1;
+		}
+	}
+
+	/* merge the clusters reaching the core points of other parts */
+	for (w = 0; w < n_parts; ++w) {
+		part_p part = &parts[w];
+		size_t m = array_size(part->index);
+		size_t *index = (size_t *) array_data(part->index);
+
+		for (k = part->owned; k < m; ++k) {
+			int32_t own = labels[index[k]], id = part->ids[k];
+
+			if (own < 0 && id) {
+				unionfind_union(uf, (unsigned int) -own, (unsigned int) (id < 0 ? -id : id));
+			}
+		}
+	}
+
+	/* the key of each cluster is its first core point */
+	keys = (int64_t *) malloc(sizeof(int64_t) * unionfind_size(uf));
+	compact = (int32_t *) calloc(unionfind_size(uf), sizeof(int32_t));
+	if (!keys || !compact) {
+		FREEALL();
+		return -1;
+	}
+	for (k = 0; k < unionfind_size(uf); ++k) {
+		keys[k] = -1;
+	}
+
+	r = 0;
+	for (i = 0; i < n; ++i) {
+		if (labels[i] < 0) {
+			unsigned int root = unionfind_find(uf, (unsigned int) -labels[i]);
+
+			if (keys[root] < 0) {
+				keys[root] = (int64_t) i;
+				compact[root] = ++r;
+			}
+		}
+	}
+
+	/* assign the border points, all the workers at the same time */
+	for (w = 0; w < n_parts; ++w) {
+		part_p part = &parts[w];
+		size_t m = array_size(part->index);
+		size_t *index = (size_t *) array_data(part->index);
+
+		for (k = 0; k < m; ++k) {
+			int32_t own = labels[index[k]];
+
+			part->keys[k] = own < 0 ? keys[unionfind_find(uf, (unsigned int) -own)] : -1;
+		}
+
+		if (!workers) {
+			result = (int64_t *) malloc(sizeof(int64_t) * (m ? m : 1));
+			if (!result) {
+				FREEALL();
+				return -1;
+			}
+		}
+		if (request_borders(part, eps, result)) {
+			FREEALL();
+			return -1;
+		}
+		free(result);
+		result = NULL;
+	}
+
+	/* the border points first, as they look up the labels of the core points */
+	for (w = 0; w < n_parts; ++w) {
+		part_p part = &parts[w];
+		size_t *index = (size_t *) array_data(part->index);
+
+		if (receive_borders(part)) {
+			FREEALL();
+			return -1;
+		}
+
+		for (k = 0; k < part->owned; ++k) {
+			int64_t key = part->keys[k];
+
+			if (labels[index[k]] >= 0) {
+				labels[index[k]] = key < 0 ? 0
+					: compact[unionfind_find(uf, (unsigned int) -labels[key])];
+			}
+		}
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (labels[i] < 0) {
+			labels[i] = compact[unionfind_find(uf, (unsigned int) -labels[i])];
+		}
+	}
+
+	FREEALL();
+	return r;
+
+#undef FREEALL
+
+}
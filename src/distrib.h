@@ -0,0 +1,35 @@
+/* Clustering in several processes on one host. */
+
+#ifndef _DISTRIB_H_
+#define _DISTRIB_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+/*
+ * Cluster the points in a coordinate buffer, as dbscan_core_labels does,
+ * in workers worker processes.
+ *
+ * The space is split into one part per worker, each of which gets the
+ * points of its part and of the halo around it over a Unix socket, and
+ * clusters them with dbscan_core_labels. This process, as the coordinator,
+ * merges the clusters sharing core points in a union-find, and the workers
+ * then assign their border points.
+ *
+ * The result is canonical, and so doesn't depend on the number of workers:
+ * - the clusters are numbered in the order of their first core points;
+ * - a border point joins the cluster with the first core point among
+ *   the clusters of the core points within eps of it;
+ * - the noise is 0.
+ *
+ * workers: number of worker processes, 0 for clustering in this process only
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int distrib_cluster_labels(const double *coords, size_t stride, size_t n, double eps, size_t min_pts,
+		int flags, unsigned int workers, int32_t *labels);
+
+
+#endif /* _DISTRIB_H_ */
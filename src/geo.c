@@ -4,8 +4,6 @@
 
 #include <math.h>
 
-#include "array.h"
-
 
 #define P_INF INFINITY
 
@@ -21,7 +19,9 @@ void point_init(point_p point, double x, double y)
 
 double point_dist(point_p a, point_p b)
 {
-	return pow(a->x - b->x, 2) + pow(a->y - b->y, 2);
+	double dx = a->x - b->x, dy = a->y - b->y;
+
+	return dx * dx + dy * dy;
 }
 
 
@@ -41,139 +41,222 @@ void point_clone_to(point_p from, point_p to)
 
 
 /*
- * A line, including two points: head and tail.
+ * Calculates the cross multiply of vectors (p0, p1) and (p0, p2).
  */
-typedef struct s_line
+static inline double cross(point_p p0, point_p p1, point_p p2)
 {
-	point_p head;
-	point_p tail;
+	return (p1->x - p0->x) * (p2->y - p0->y) - (p1->y - p0->y) * (p2->x - p0->x);
 }
-line_t, *line_p;
 
 
-static inline double line_length(line_p line)
+/*
+ * Whether a comes before b, by x then y.
+ */
+static inline int point_less(point_p a, point_p b)
 {
-	return point_dist(line->head, line->tail);
+	return a->x < b->x || (a->x == b->x && a->y < b->y);
 }
 
 
+/* runs no longer than this are sorted by insertion */
+#define INSERTION_SORT_MAX 16
+
+
 /*
- * Calculates the cross multiply of vectors (p0, p1) and (p0, p2).
+ * Sort the points by x then y, with a quicksort comparing them inline.
+ *
+ * Only the smaller side is sorted recursively, so the depth is at most log2(size).
  */
-static inline double cross(point_p p0, point_p p1, point_p p2)
+static void sort_points(point_p *points, size_t size)
 {
-	return (p1->x - p0->x) * (p2->y - p0->y) - (p1->y - p0->y) * (p2->x - p0->x);
+	while (size > INSERTION_SORT_MAX) {
+		size_t i, j, mid = size / 2;
+		point_p pivot;
+
+		/* median of three, to points[mid] */
+		if (point_less(points[mid], points[0])) {
+			point_p temp = points[mid]; points[mid] = points[0]; points[0] = temp;
+		}
+		if (point_less(points[size - 1], points[mid])) {
+			point_p temp = points[mid]; points[mid] = points[size - 1]; points[size - 1] = temp;
+			if (point_less(points[mid], points[0])) {
+				temp = points[mid]; points[mid] = points[0]; points[0] = temp;
+			}
+		}
+		pivot = points[mid];
+
+		i = 0;
+		j = size - 1;
+		for (;;) {
+			while (point_less(points[i], pivot)) {
+				++i;
+			}
+			while (point_less(pivot, points[j])) {
+				--j;
+			}
+			if (i >= j) {
+				break;
+			}
+			{
+				point_p temp = points[i]; points[i] = points[j]; points[j] = temp;
+			}
+			++i;
+			--j;
+		}
+
+		/* points[0, j] are no greater than the pivot, points[j + 1, size) no less */
+		if (j + 1 < size - j - 1) {
+			sort_points(points, j + 1);
+			points += j + 1;
+			size -= j + 1;
+		} else {
+			sort_points(points + j + 1, size - j - 1);
+			size = j + 1;
+		}
+	}
+
+	{
+		size_t i, j;
+
+		for (i = 1; i < size; ++i) {
+			point_p p = points[i];
+
+			for (j = i; j > 0 && point_less(p, points[j - 1]); --j) {
+				points[j] = points[j - 1];
+			}
+			points[j] = p;
+		}
+	}
 }
 
 
 /*
- * Tell the clock direction of l1 from l2, which have the same head.
+ * Andrew's monotone chain: the lower hull from left to right, then the upper
+ * hull from right to left, popping the points which don't make a left turn.
  *
- * Returns: 0 if l1 and l2 are the save direction;
- *          1 if l1 is clockwise to l2;
- *         -1 if l1 is un-clockwise to l2.
+ * refs: Another Efficient Algorithm for Convex Hulls in Two Dimensions
+ *       A. M. Andrew
  */
-static inline int clock_direct(line_p l1, line_p l2)
+size_t convex_hull_sorted(point_p *points, size_t size, point_p *hull)
 {
-	register double m = cross(l1->head, l1->tail, l2->tail);
+	size_t i, k = 0, t;
+
+	if (!size) {
+		return 0;
+	}
+
+	for (i = 0; i < size; ++i) {
+		if (i && point_equals(points[i - 1], points[i])) {
+			continue;
+		}
+		while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) {
+			--k;
+		}
+		hull[k++] = points[i];
+	}
+
+	/* all the points are the same */
+	if (k == 1) {
+		return 1;
+	}
+
+	/* the last point of the lower hull starts the upper one, and the first ends it */
+	t = k + 1;
+	for (i = size - 1; i-- > 0;) {
+		if (point_equals(points[i + 1], points[i])) {
+			continue;
+		}
+		while (k >= t && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) {
+			--k;
+		}
+		hull[k++] = points[i];
+	}
 
-	return (m > 0.0) - (m < 0.0);
+	return k - 1;
 }
 
 
-static int cmp_line(const void *line1, const void *line2)
+size_t convex_hull(point_p *points, size_t size, point_p *hull)
 {
-	return -clock_direct((line_p) line1, (line_p) line2);
+	sort_points(points, size);
+	return convex_hull_sorted(points, size, hull);
 }
 
 
 /*
- * Whether p0 -- p1 -- p2 makes a left turn.
+ * Reverse hull[from, to).
  */
-static inline int is_left_turn(point_p p0, point_p p1, point_p p2)
+static void reverse(point_p *hull, size_t from, size_t to)
 {
-	return cross(p0, p1, p2) > 0;
+	while (from + 1 < to) {
+		point_p temp = hull[from];
+		hull[from++] = hull[--to];
+		hull[to] = temp;
+	}
 }
 
 
-/* NOTE: the caller MUST free the result. */
-static point_p *rerange(point_p *points, size_t size, size_t *ret_size)
+size_t convex_hull_insert(point_p *hull, size_t n, point_p point)
 {
-	line_t *lines = NULL;
-	array_p rlines = NULL;
-	point_p *result = NULL;
-	point_p head = NULL;
-	double min_y = INFINITY;
-	size_t min_index = -1;
-	unsigned int i = 0;
+	size_t i, s, e, m;
 
-#define FREEALL()\
-	{\
-		free(lines); lines = NULL;\
-		array_destroy(rlines); rlines = NULL;\
+	for (i = 0; i < n; ++i) {
+		if (point_equals(hull[i], point)) {
+			return n;
+		}
 	}
 
-	lines = (line_t *) malloc(sizeof(line_t) * (size - 1));
-	rlines = array_create(128);
-	if (!lines || !rlines) {
-		FREEALL();
-		return NULL;
-	}
+	/* a point or a segment, just find the hull again */
+	if (n < 3) {
+		point_p points[3], result[4];
 
-	for (i = 0; i < size; ++i) {
-		if (points[i]->y < min_y) {
-			min_y = points[i]->y;
-			min_index = i;
-		} else if (points[i]->y == min_y) {
-			if (points[i]->x < points[min_index]->x) {
-				min_index = i;
-			}
+		for (i = 0; i < n; ++i) {
+			points[i] = hull[i];
 		}
+		points[n] = point;
+
+		m = convex_hull(points, n + 1, result);
+		for (i = 0; i < m; ++i) {
+			hull[i] = result[i];
+		}
+		return m;
 	}
 
-	head = points[min_index];
-	for (i = 0; i < min_index; ++i) {
-		lines[i] = (line_t) { .head = head, .tail = points[i] };
+	/* the edges from hull[i] to hull[i + 1] the point sees, from s to e */
+	for (s = 0; s < n && cross(hull[s], hull[(s + 1) % n], point) >= 0; ++s) {
 	}
-	for (i = min_index + 1; i < size; ++i) {
-		lines[i - 1] = (line_t) { .head = head, .tail = points[i] };
+	if (s == n) {
+		/* inside, or on an edge */
+		return n;
 	}
-	qsort(lines, size - 1, sizeof(line_t), cmp_line);
-
-	array_append(rlines, &lines[0]);
-
-	for (i = 1; i < size - 1; ++i) {
-		line_p line = &lines[i], last = NULL;
-
-		array_at(rlines, array_size(rlines) - 1, (void **) &last);
-
-		if (clock_direct(line, last)) {
-			array_append(rlines, line);
-		} else {
-			if (line_length(last) < line_length(line)) {
-				array_pop(rlines, NULL);
-				array_append(rlines, line);
-			}
-		}
+	while (cross(hull[(s + n - 1) % n], hull[s], point) < 0) {
+		s = (s + n - 1) % n;
+	}
+	for (e = s; cross(hull[(e + 1) % n], hull[(e + 2) % n], point) < 0; e = (e + 1) % n) {
 	}
 
-	result = (point_p *) malloc(sizeof(point_p) * (array_size(rlines) + 1));
-	if (result) {
-		line_p line = NULL;
-
-		result[0] = head;
-		for (i = 0; i < array_size(rlines); ++i) {
-			array_at(rlines, i, (void **) &line);
-			result[i + 1] = line->tail;
+	/*
+	 * hull[e + 1], ..., hull[s] are kept, so rotate hull[e + 1] to the front:
+	 * the kept vertices are hull[0, m), and the point follows them.
+	 */
+	m = (s + n - (e + 1) % n) % n + 1;
+	reverse(hull, 0, (e + 1) % n);
+	reverse(hull, (e + 1) % n, n);
+	reverse(hull, 0, n);
+
+	/* a kept vertex in line with the point and its neighbour is no vertex any more */
+	if (m > 1 && cross(hull[m - 2], hull[m - 1], point) == 0) {
+		--m;
+	}
+	if (m > 1 && cross(point, hull[0], hull[1]) == 0) {
+		for (i = 1; i < m; ++i) {
+			hull[i - 1] = hull[i];
 		}
-		*ret_size = array_size(rlines) + 1;
+		--m;
 	}
 
-	FREEALL();
-	return result;
-
-#undef FREEALL
-
+	hull[m] = point;
+	return m + 1;
 }
 
 
@@ -185,19 +268,23 @@ static point_p *rerange(point_p *points, size_t size, size_t *ret_size)
  */
 point_p *convex_hulls(point_p *points, size_t size, size_t *ret_size)
 {
-	array_p stack = NULL;
-	point_p *result = NULL;
-	unsigned int i = 0;
-	size_t n = 0;
+	return convex_hulls_with(NULL, points, size, ret_size);
+}
+
+
+point_p *convex_hulls_with(allocator_p a, point_p *points, size_t size, size_t *ret_size)
+{
+	point_p *list = NULL, *hull = NULL, *result = NULL;
+	size_t i, n = 0;
 
 #define FREEALL()\
 	{\
-		free(points); points = NULL;\
-		array_destroy(stack); stack = NULL;\
+		mem_free(a, list, sizeof(point_p) * size); list = NULL;\
+		mem_free(a, hull, sizeof(point_p) * (size + 1)); hull = NULL;\
 	}
 
 	if (size <= 3) {
-		result = (point_p *) malloc(sizeof(point_p *) * size);
+		result = (point_p *) mem_alloc(a, sizeof(point_p) * size);
 		if (result) {
 			n = size;
 			for (i = 0; i < n; ++i) {
@@ -208,51 +295,26 @@ point_p *convex_hulls(point_p *points, size_t size, size_t *ret_size)
 		return result;
 	}
 
-	points = rerange(points, size, &n);
-	if (!points) {
-		FREEALL();
-		return NULL;
-	}
-
-	stack = array_create(128);
-	if (!stack) {
+	list = (point_p *) mem_alloc(a, sizeof(point_p) * size);
+	hull = (point_p *) mem_alloc(a, sizeof(point_p) * (size + 1));
+	if (!list || !hull) {
 		FREEALL();
 		return NULL;
 	}
 
-	if (n >= 3) {
-		array_append(stack, points[0]);
-		array_append(stack, points[1]);
-		array_append(stack, points[2]);
-
-		for (i = 3; i < n; ++i) {
-			point_p top2 = NULL, top1 = NULL; // non-allocated pointers
-			array_at(stack, array_size(stack) - 2, (void **) &top2);
-			array_at(stack, array_size(stack) - 1, (void **) &top1);
-
-			while (!is_left_turn(top2, top1, points[i])) {
-				array_pop(stack, NULL);
-				array_at(stack, array_size(stack) - 2, (void **) &top2);
-				array_at(stack, array_size(stack) - 1, (void **) &top1);
-			}
-			array_append(stack, points[i]);
-		}
-		n = array_size(stack);
-
-	} else {
-		for (i = 0; i < n; ++i) {
-			array_append(stack, points[i]);
-		}
+	for (i = 0; i < size; ++i) {
+		list[i] = points[i];
 	}
+	n = convex_hull(list, size, hull);
 
-	result = (point_p *) malloc(sizeof(point_p) * n);
+	result = (point_p *) mem_alloc(a, sizeof(point_p) * n);
 	if (!result) {
 		FREEALL();
 		return NULL;
 	}
 
 	for (i = 0; i < n; ++i) {
-		array_at(stack, i, (void **) &result[i]);
+		result[i] = hull[i];
 	}
 	*ret_size = n;
 
@@ -331,9 +393,9 @@ double rect_min_dist_to(rect_p rect, point_p point)
 #define ADDSUM(itv, p)\
 	if (!interval_contains((itv), (p))) {\
 		if ((p) < (itv)->lower) {\
-			sum += pow((p) - (itv)->lower, 2);\
+			sum += ((itv)->lower - (p)) * ((itv)->lower - (p));\
 		} else {\
-			sum += pow((itv)->upper - (p), 2);\
+			sum += ((p) - (itv)->upper) * ((p) - (itv)->upper);\
 		}\
 	}
 
@@ -5,6 +5,8 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 
 /*
  * 2D point.
@@ -46,15 +48,57 @@ int point_equals(point_p a, point_p b);
 void point_clone_to(point_p from, point_p to);
 
 
+/*
+ * Find the convex hull of the points, allocating nothing.
+ *
+ * The points are sorted in place, by x then y, and the vertices of the hull
+ * are put into hull in counter-clockwise order, starting from the first of them.
+ * The points on an edge of the hull, and the duplicates, are not vertices.
+ *
+ * hull: receives the vertices, MUST have space for size + 1 items
+ *
+ * Returns: the number of vertices.
+ */
+size_t convex_hull(point_p *points, size_t size, point_p *hull);
+
+
+/*
+ * Same as convex_hull, with the points already sorted by x then y.
+ */
+size_t convex_hull_sorted(point_p *points, size_t size, point_p *hull);
+
+
+/*
+ * Insert the point into the convex hull of n vertices, as convex_hull finds it,
+ * in O(n): the vertices the point hides are replaced by it, and nothing
+ * changes if it's inside.
+ *
+ * hull: MUST have space for n + 1 items
+ *
+ * Returns: the number of vertices after the insertion.
+ */
+size_t convex_hull_insert(point_p *hull, size_t n, point_p point);
+
+
 /*
  * Find the convex hulls of the points.
  *
+ * With 3 points or less, all of them are returned, else the vertices as convex_hull finds them.
+ *
  * NOTE: the point_t *returned by this function MUST be freed by
  * the caller!
  */
 point_p *convex_hulls(point_p *points, size_t size, size_t *ret_size);
 
 
+/*
+ * Same as convex_hulls, with all the memory coming from the allocator.
+ *
+ * NOTE: the result, of *ret_size items, MUST be freed by the caller to the allocator!
+ */
+point_p *convex_hulls_with(allocator_p a, point_p *points, size_t size, size_t *ret_size);
+
+
 
 /*
  * Interval indicating the range for some dim.
@@ -7,6 +7,8 @@
 
 #define DEFAULT_CAPACITY 1024
 
+#define SLOTS_PER_BLOCK 256
+
 
 /*
  * Hashset storing unit.
@@ -46,6 +48,16 @@ typedef struct s_hashset
 	slotlist_t *slotlists;
 	size_t slotlists_n;
 
+	allocator_p alloc;
+
+	/*
+	 * All the slots come from this pool, and go back to it when removed,
+	 * so that a set which is emptied and filled again stops allocating.
+	 * They all have room for slot_bytes bytes of data.
+	 */
+	pool_p slots;
+	size_t slot_bytes;
+
 	/* how many elements in this set */
 	size_t size;
 
@@ -78,8 +90,45 @@ static unsigned int default_hash(const void *item, size_t bytes)
 #define CMP(set, item1, item2, bytes) ((set)->cmp ? (set)->cmp : memcmp)((item1), (item2), (bytes))
 
 
+static slot_p alloc_slot(hashset_p set, size_t bytes)
+{
+	if (!set->slots || bytes != set->slot_bytes) {
+		pool_p slots = NULL;
+
+		if (set->size) {
+			/* all the items MUST be of the same size */
+			return NULL;
+		}
+
+		slots = pool_create(set->alloc, sizeof(slot_p) + bytes, SLOTS_PER_BLOCK);
+		if (!slots) {
+			return NULL;
+		}
+		pool_destroy(set->slots);
+		set->slots = slots;
+		set->slot_bytes = bytes;
+	}
+
+	return (slot_p) pool_alloc(set->slots);
+}
+
+
+static inline void free_slot(hashset_p set, slot_p slot)
+{
+	pool_free(set->slots, slot);
+}
+
+
 hashset_p hashset_create(size_t init_size, unsigned int (*hash)(const void *item, size_t bytes),
 		int (*cmp)(const void *item1, const void *item2, size_t bytes))
+{
+	return hashset_create_with(NULL, init_size, hash, cmp);
+}
+
+
+hashset_p hashset_create_with(allocator_p a, size_t init_size,
+		unsigned int (*hash)(const void *item, size_t bytes),
+		int (*cmp)(const void *item1, const void *item2, size_t bytes))
 {
 	hashset_p set = NULL;
 	slotlist_t *slotlists = NULL;
@@ -88,17 +137,20 @@ hashset_p hashset_create(size_t init_size, unsigned int (*hash)(const void *item
 		init_size = DEFAULT_CAPACITY;
 	}
 
-	set = (hashset_p) malloc(sizeof(hashset_t));
-	slotlists = (slotlist_t *) calloc(init_size, sizeof(slotlist_t));
+	set = (hashset_p) mem_alloc(a, sizeof(hashset_t));
+	slotlists = (slotlist_t *) mem_calloc(a, init_size, sizeof(slotlist_t));
 	if (!set || !slotlists) {
-		free(set);
-		free(slotlists);
+		mem_free(a, set, sizeof(hashset_t));
+		mem_free(a, slotlists, sizeof(slotlist_t) * init_size);
 		return NULL;
 	}
 
+	set->alloc = a;
 	set->slotlists = slotlists;
 	set->slotlists_n = init_size;
 	set->non_null = NULL;
+	set->slots = NULL;
+	set->slot_bytes = 0;
 	set->size = 0;
 	set->hash = hash;
 	set->cmp = cmp;
@@ -110,14 +162,16 @@ hashset_p hashset_create(size_t init_size, unsigned int (*hash)(const void *item
 void hashset_destroy(hashset_p set)
 {
 	if (set) {
-		void hashset_remove_all(hashset_p set);
+		allocator_p a = set->alloc;
 
-		hashset_remove_all(set);
+		/* all the slots go with the pool */
+		pool_destroy(set->slots);
+		set->slots = NULL;
 
-		free(set->slotlists);
+		mem_free(a, set->slotlists, sizeof(slotlist_t) * set->slotlists_n);
 		set->slotlists = NULL;
 
-		free(set);
+		mem_free(a, set, sizeof(hashset_t));
 	}
 }
 
@@ -145,7 +199,7 @@ int hashset_add(hashset_p set, const void *item, size_t bytes)
 		slot = *pslot;
 	}
 
-	*pslot = new_slot = (slot_p) malloc(bytes + sizeof(slot_p));
+	*pslot = new_slot = alloc_slot(set, bytes);
 	if (!new_slot) {
 		return -2;
 	}
@@ -153,6 +207,11 @@ int hashset_add(hashset_p set, const void *item, size_t bytes)
 
 	memcpy(&new_slot->data, item, bytes);
 
+	if (is_new) {
+		slotlist->pre = NULL;
+		slotlist->next = NULL;
+	}
+
 	if (!set->non_null) {
 		set->non_null = slotlist;
 	} else if (is_new) {
@@ -181,7 +240,7 @@ int hashset_remove(hashset_p set, const void *item, size_t bytes)
 
 	if (!CMP(set, &pre_slot->data, item, bytes)) {
 		*pslot = pre_slot->next;
-		free(pre_slot);
+		free_slot(set, pre_slot);
 
 		if (!slotlist->list) {
 			if (slotlist->pre) {
@@ -201,7 +260,7 @@ int hashset_remove(hashset_p set, const void *item, size_t bytes)
 	while ((slot = pre_slot->next)) {
 		if (!CMP(set, &slot->data, item, bytes)) {
 			pre_slot->next = slot->next;
-			free(slot);
+			free_slot(set, slot);
 
 			if (!slotlist->list) {
 				if (slotlist->pre) {
@@ -234,7 +293,7 @@ void hashset_remove_all(hashset_p set)
 		slot_p slot = slotlist->list;
 		while (slot) {
 			slot_p next = slot->next;
-			free(slot);
+			free_slot(set, slot);
 			slot = next;
 		}
 
@@ -279,7 +338,7 @@ int hashset_pop(hashset_p set, void *item, size_t bytes)
 		memcpy(item, &slot->data, bytes);
 	}
 	slotlist->list = slot->next;
-	free(slot);
+	free_slot(set, slot);
 
 	if (!slotlist->list) {
 		if (slotlist->pre) {
@@ -4,6 +4,8 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 
 /*
  * A hashset stores data with certain size.
@@ -20,6 +22,14 @@ hashset_p hashset_create(size_t init_size, unsigned int (*hash)(const void *item
 		int (*cmp)(const void *item1, const void *item2, size_t bytes));
 
 
+/*
+ * Same as hashset_create, with all the memory of the hashset coming from the allocator.
+ */
+hashset_p hashset_create_with(allocator_p a, size_t init_size,
+		unsigned int (*hash)(const void *item, size_t bytes),
+		int (*cmp)(const void *item1, const void *item2, size_t bytes));
+
+
 /*
  * Destroy hashset instance.
  */
@@ -5,6 +5,8 @@
 
 typedef struct s_id_generator
 {
+	allocator_p alloc;
+
 	/* next id */
 	unsigned long id;
 }
@@ -13,8 +15,15 @@ id_generator_t;
 
 id_generator_p id_generator_create()
 {
-	id_generator_p gen = (id_generator_p) malloc(sizeof(id_generator_t));
+	return id_generator_create_with(NULL);
+}
+
+
+id_generator_p id_generator_create_with(allocator_p a)
+{
+	id_generator_p gen = (id_generator_p) mem_alloc(a, sizeof(id_generator_t));
 	if (gen) {
+		gen->alloc = a;
 		gen->id = (unsigned long) 1;
 	}
 	return gen;
@@ -24,11 +33,17 @@ id_generator_p id_generator_create()
 void id_generator_destroy(id_generator_p gen)
 {
 	if (gen) {
-		free(gen);
+		mem_free(gen->alloc, gen, sizeof(id_generator_t));
 	}
 }
 
 
+void id_generator_reset(id_generator_p gen)
+{
+	gen->id = (unsigned long) 1;
+}
+
+
 unsigned long id_generator_next_id(id_generator_p gen)
 {
 	return gen->id++;
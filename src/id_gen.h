@@ -1,6 +1,8 @@
 #ifndef _ID_GEN_H_
 #define _ID_GEN_H_
 
+#include "alloc.h"
+
 
 /*
  * Auto-increasing id generator.
@@ -16,12 +18,24 @@ typedef struct s_id_generator *id_generator_p;
 id_generator_p id_generator_create();
 
 
+/*
+ * Same as id_generator_create, the generator coming from the allocator.
+ */
+id_generator_p id_generator_create_with(allocator_p a);
+
+
 /*
  * Release an id_generator.
  */
 void id_generator_destroy(id_generator_p gen);
 
 
+/*
+ * Restart the ids from the first one.
+ */
+void id_generator_reset(id_generator_p gen);
+
+
 /*
  * Get the next id.
  */
@@ -2,8 +2,14 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdint.h>
 #include <assert.h>
-#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "array.h"
 #include "hashset.h"
@@ -33,6 +39,50 @@ kdnode_t, *kdnode_p;
 #define R(pnode) ((pnode)->child[1])
 
 
+/* the axis the root node splits on */
+#define ROOT_XD 1
+
+
+/*
+ * Node in a snapshot, its children being indexes of nodes, or NO_NODE.
+ *
+ * The point comes first, so that a point_p into a snapshot is also a kdflat_p.
+ */
+typedef struct s_kdflat
+{
+	point_t point;
+
+	uint32_t child[2];
+	uint32_t id;
+	uint32_t reserved;
+}
+kdflat_t, *kdflat_p;
+
+
+#define NO_NODE UINT32_MAX
+
+
+/*
+ * Header of a snapshot, followed by its size nodes, the root being the first one.
+ */
+typedef struct s_kdsnapshot
+{
+	char magic[8];
+	uint64_t size;
+	rect_t rect;
+	uint32_t node_bytes;
+	uint32_t root_xd;
+}
+kdsnapshot_t;
+
+
+#define MAGIC "KDTREE01"
+
+
+/* seed of the shuffle before building, so that the same points always make the same tree */
+#define SHUFFLE_SEED 0x9e3779b97f4a7c15ULL
+
+
 /*
  * Data structure for kdtree.
  *
@@ -44,9 +94,35 @@ kdnode_t, *kdnode_p;
  */
 typedef struct s_kdtree
 {
+	allocator_p alloc;
+
 	kdnode_p root;
-	rect_p rect;
+	rect_t rect;
 	size_t size;
+
+	/*
+	 * Buffers kept from one kdtree_build to the next.
+	 */
+
+	/* all the nodes, nodes_n allocated */
+	kdnode_t *nodes;
+	size_t nodes_n;
+
+	/* working copy of the points, points_n allocated */
+	point_p *points;
+	size_t points_n;
+
+	/* for uniq test, created with set_n */
+	hashset_p set;
+	size_t set_n;
+
+	/*
+	 * The nodes of a tree opened from a snapshot, root being NULL,
+	 * within the mapping of map_bytes at map.
+	 */
+	const kdflat_t *flat;
+	void *map;
+	size_t map_bytes;
 }
 kdtree_t;
 
@@ -70,31 +146,56 @@ void kdnode_init(kdnode_p node, point_p point)
 
 kdtree_p kdtree_create()
 {
-	kdtree_p tree = (kdtree_p) malloc(sizeof(kdtree_t));
+	return kdtree_create_with(NULL);
+}
+
+
+kdtree_p kdtree_create_with(allocator_p a)
+{
+	kdtree_p tree = (kdtree_p) mem_alloc(a, sizeof(kdtree_t));
 	if (tree) {
+		tree->alloc = a;
 		tree->root = NULL;
-		tree->rect = NULL;
+		rect_init_space(&tree->rect);
 		tree->size = 0;
+		tree->nodes = NULL;
+		tree->nodes_n = 0;
+		tree->points = NULL;
+		tree->points_n = 0;
+		tree->set = NULL;
+		tree->set_n = 0;
+		tree->flat = NULL;
+		tree->map = NULL;
+		tree->map_bytes = 0;
 	}
 	return tree;
 }
 
 
-static void uniq_and_shuffle_points(point_p *from, point_p *to, size_t *pn)
+/*
+ * Drop the snapshot the tree is opened from, if any.
+ */
+static void unmap(kdtree_p tree)
+{
+	if (tree->map) {
+		munmap(tree->map, tree->map_bytes);
+		tree->map = NULL;
+		tree->map_bytes = 0;
+	}
+	tree->flat = NULL;
+}
+
+
+static void uniq_and_shuffle_points(hashset_p set, point_p *from, point_p *to, size_t *pn)
 {
 	unsigned int i, j;
 	size_t n = *pn;
-	time_t t;
-	hashset_p set = NULL;
+	unsigned long long seed = SHUFFLE_SEED;
 
-	if (!(set = hashset_create(n, NULL, NULL))) {
-		*pn = 0;
-		return;
-	}
+	hashset_remove_all(set);
 	for (i = j = 0; i < n; ++i) {
 		switch (hashset_add(set, from[i], sizeof(point_t))) {
 			case -2: // memory alloc error
-				hashset_destroy(set);
 				*pn = 0;
 				return;
 			case 0: // succeed
@@ -105,15 +206,16 @@ static void uniq_and_shuffle_points(point_p *from, point_p *to, size_t *pn)
 	}
 	*pn = n = j;
 
-	if ((t = time(NULL)) != -1) {
-		srandom(t);
-	}
+	/* xorshift64*, not to depend on nor disturb the state of random() */
 	for (i = n; i > 0; ) {
-		long rand = random() % i--;
+		unsigned long long rand;
+
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		rand = (seed * 0x2545f4914f6cdd1dULL) % i--;
 		SWAP(to[rand], to[i], point_p);
 	}
-
-	hashset_destroy(set);
 }
 
 
@@ -160,31 +262,27 @@ static int median_point(point_p *points, int xd, int p, int r)
 }
 
 
-static kdnode_p build_kdtree(point_p *points, int xd, int p, int r, int *error)
+static kdnode_p build_kdtree(kdtree_p tree, point_p *points, int xd, int p, int r)
 {
 	int m;
 	kdnode_p node = NULL, left = NULL, right = NULL;
 
-	if (p > r || *error) {
+	if (p > r) {
 		return NULL;
 	}
 
 	m = median_point(points, xd, p, r);
-	node = (kdnode_p) malloc(sizeof(kdnode_t));
-	if (!node) {
-		*error = 1;
-		return NULL;
-	}
+	node = &tree->nodes[tree->size++];
 	kdnode_init(node, points[m]);
 	xd = !xd;
 
-	left = build_kdtree(points, xd, p, m - 1, error);
+	left = build_kdtree(tree, points, xd, p, m - 1);
 	if (left) {
 		L(node) = left;
 		left->parent = node;
 	}
 
-	right = build_kdtree(points, xd, m + 1, r, error);
+	right = build_kdtree(tree, points, xd, m + 1, r);
 	if (right) {
 		R(node) = right;
 		right->parent = node;
@@ -194,72 +292,92 @@ static kdnode_p build_kdtree(point_p *points, int xd, int p, int r, int *error)
 }
 
 
-kdtree_p kdtree_create_static(point_p *_points, size_t n)
+int kdtree_build(kdtree_p tree, point_p *_points, size_t n)
 {
 	unsigned int i;
-	int error = 0;
-	kdtree_p tree = (kdtree_p) malloc(sizeof(kdtree_t));
-	rect_p rect = (rect_p) malloc(sizeof(rect_t));
-	point_p *points = (point_p *) malloc(sizeof(point_p) * n);
-
-	if (!tree || !rect || !points) {
-		free(tree);
-		free(rect);
-		free(points);
-		return NULL;
+
+	unmap(tree);
+	tree->root = NULL;
+	tree->size = 0;
+
+	if (!n) {
+		return -1;
+	}
+
+	if (n > tree->points_n) {
+		point_p *points = (point_p *) mem_alloc(tree->alloc, sizeof(point_p) * n);
+		if (!points) {
+			return -1;
+		}
+		mem_free(tree->alloc, tree->points, sizeof(point_p) * tree->points_n);
+		tree->points = points;
+		tree->points_n = n;
+	}
+
+	if (n > tree->set_n) {
+		hashset_p set = hashset_create_with(tree->alloc, n, NULL, NULL);
+		if (!set) {
+			return -1;
+		}
+		hashset_destroy(tree->set);
+		tree->set = set;
+		tree->set_n = n;
 	}
 
-	uniq_and_shuffle_points(_points, points, &n);
+	uniq_and_shuffle_points(tree->set, _points, tree->points, &n);
 	if (!n) {
-		free(tree);
-		free(rect);
-		free(points);
-		return NULL;
+		return -1;
 	}
 
-	rect_init_point(rect, points[0]);
-	for (i = 0; i < n; ++i) {
-		rect_enlarge_to(rect, points[i]);
+	if (n > tree->nodes_n) {
+		kdnode_t *nodes = (kdnode_t *) mem_alloc(tree->alloc, sizeof(kdnode_t) * n);
+		if (!nodes) {
+			return -1;
+		}
+		mem_free(tree->alloc, tree->nodes, sizeof(kdnode_t) * tree->nodes_n);
+		tree->nodes = nodes;
+		tree->nodes_n = n;
 	}
-	tree->rect = rect;
-	tree->size = n;
 
-	tree->root = build_kdtree(points, 1, 0, n - 1, &error);
-	if (error) {
-		kdtree_destroy(tree);
-		free(points);
-		return NULL;
+	rect_init_point(&tree->rect, tree->points[0]);
+	for (i = 0; i < n; ++i) {
+		rect_enlarge_to(&tree->rect, tree->points[i]);
 	}
 
-	free(points);
-	return tree;
+	tree->root = build_kdtree(tree, tree->points, ROOT_XD, 0, n - 1);
+	return 0;
 }
 
 
-static void rec_destroy_node(kdnode_p node)
+kdtree_p kdtree_create_static(point_p *points, size_t n)
 {
-	if (node) {
-		rec_destroy_node(L(node));
-		L(node) = NULL;
-
-		rec_destroy_node(R(node));
-		R(node) = NULL;
+	kdtree_p tree = kdtree_create();
 
-		free(node);
+	if (tree && kdtree_build(tree, points, n)) {
+		kdtree_destroy(tree);
+		return NULL;
 	}
+	return tree;
 }
 
 
 void kdtree_destroy(kdtree_p tree)
 {
 	if (tree) {
-		rec_destroy_node(tree->root);
 		tree->root = NULL;
 
-		free(tree->rect);
-		tree->rect = NULL;
+		mem_free(tree->alloc, tree->nodes, sizeof(kdnode_t) * tree->nodes_n);
+		tree->nodes = NULL;
+
+		mem_free(tree->alloc, tree->points, sizeof(point_p) * tree->points_n);
+		tree->points = NULL;
+
+		hashset_destroy(tree->set);
+		tree->set = NULL;
+
+		unmap(tree);
 
-		free(tree);
+		mem_free(tree->alloc, tree, sizeof(kdtree_t));
 	}
 }
 
@@ -282,52 +400,239 @@ int kdtree_delete(kdtree_p tree, point_p point)
 }
 
 
-point_p kdtree_nearest_neighbour(kdtree_p tree, point_p point)
+/*
+ * A search for the points within dist from point.
+ *
+ * If with_dist, best is a typed array of point_dist_t, else it's an array of point_p.
+ * Only the points for which filter returns non-zero are collected, unless filter is NULL.
+ */
+typedef struct s_query
 {
-	/* TODO: unimplemented */
-	assert(tree);
-	assert(point);
-	return NULL;
+	point_p point;
+	double dist;
+
+	array_p best;
+	int with_dist;
+
+	kdtree_filter_t filter;
+	void *arg;
 }
+query_t, *query_p;
 
 
-typedef struct s_point_dist
+/*
+ * Collect a point of the tree at d from the point searched for, if it passes the filter.
+ */
+static inline int collect(query_p q, point_p point, double d)
 {
-	point_p point;
-	double dist;
+	if (d > q->dist || (q->filter && !q->filter(point, q->arg))) {
+		return 0;
+	}
+
+	if (q->with_dist) {
+		point_dist_t pd = { .point = point, .dist = d };
+		return array_push(q->best, &pd);
+	}
+	return array_append(q->best, point);
+}
+
+
+/*
+ * Collect the points under node for the query.
+ *
+ * rect bounds all the points under node, which is split by its point on the xd axis.
+ */
+static int knn(kdnode_p node, query_p q, rect_p rect, int xd)
+{
+	rect_t left_rect, right_rect;
+
+	if (!node || rect_min_dist_to(rect, q->point) > q->dist) {
+		return 0;
+	}
+
+	if (collect(q, node->point, point_dist(node->point, q->point))) {
+		return -1;
+	}
+
+	if (L(node) && !rect_set_lower(rect, &left_rect, node->point, xd)) {
+		if (knn(L(node), q, &left_rect, !xd)) {
+			return -1;
+		}
+	}
+	if (R(node) && !rect_set_upper(rect, &right_rect, node->point, xd)) {
+		if (knn(R(node), q, &right_rect, !xd)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * Same as knn, for the node i of a snapshot.
+ */
+static int knn_flat(const kdflat_t *flat, uint32_t i, query_p q, rect_p rect, int xd)
+{
+	rect_t left_rect, right_rect;
+	point_p node_point = (point_p) &flat[i].point;
+
+	if (rect_min_dist_to(rect, q->point) > q->dist) {
+		return 0;
+	}
+
+	if (collect(q, node_point, point_dist(node_point, q->point))) {
+		return -1;
+	}
+
+	if (flat[i].child[0] != NO_NODE && !rect_set_lower(rect, &left_rect, node_point, xd)) {
+		if (knn_flat(flat, flat[i].child[0], q, &left_rect, !xd)) {
+			return -1;
+		}
+	}
+	if (flat[i].child[1] != NO_NODE && !rect_set_upper(rect, &right_rect, node_point, xd)) {
+		if (knn_flat(flat, flat[i].child[1], q, &right_rect, !xd)) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+static int search(kdtree_p tree, query_p q)
+{
+	rect_t rect = tree->rect;
+
+	if (tree->flat) {
+		return knn_flat(tree->flat, 0, q, &rect, ROOT_XD);
+	}
+	return knn(tree->root, q, &rect, ROOT_XD);
+}
+
+
+int kdtree_neighbours(kdtree_p tree, point_p point, double thre, array_p result)
+{
+	query_t q = { .point = point, .dist = thre, .best = result };
+
+	return search(tree, &q);
+}
+
+
+int kdtree_neighbours_filter(kdtree_p tree, point_p point, double thre,
+		kdtree_filter_t filter, void *arg, array_p result)
+{
+	query_t q = { .point = point, .dist = thre, .best = result, .filter = filter, .arg = arg };
+
+	return search(tree, &q);
+}
+
+
+int kdtree_neighbours_dist(kdtree_p tree, point_p point, double thre, array_p result)
+{
+	query_t q = { .point = point, .dist = thre, .best = result, .with_dist = 1 };
+
+	return search(tree, &q);
 }
-point_dist_t, *point_dist_p;
 
 
-static void knn(kdnode_p node, point_p point, rect_p rect, double dist, int xd, array_p best)
+/*
+ * Find the point under node nearest to point, if nearer than *dist, into *best and *dist.
+ *
+ * The child on the side of point is searched first, which usually
+ * shrinks *dist enough to skip the other one.
+ */
+static void nn(kdnode_p node, point_p point, rect_p rect, int xd, point_p *best, double *dist)
 {
 	double d;
-	rect_t left_rect = {}, right_rect = {};
+	int side;
+	rect_t rects[2];
+	int has[2];
 
-	if (!node || rect_min_dist_to(rect, point) > dist) {
+	if (!node || rect_min_dist_to(rect, point) > *dist) {
 		return;
 	}
 
 	d = point_dist(node->point, point);
-	if (d <= dist) {
-		point_dist_p pd = (point_dist_p) malloc(sizeof(point_dist_t));
-		pd->point = node->point;
-		pd->dist = d;
-		array_append(best, pd);
+	if (d < *dist || (d == *dist && !*best)) {
+		*best = node->point;
+		*dist = d;
+	}
+
+	has[0] = L(node) && !rect_set_lower(rect, &rects[0], node->point, xd);
+	has[1] = R(node) && !rect_set_upper(rect, &rects[1], node->point, xd);
+	side = point->dim[xd] > node->point->dim[xd];
+
+	if (has[side]) {
+		nn(node->child[side], point, &rects[side], !xd, best, dist);
+	}
+	if (has[!side]) {
+		nn(node->child[!side], point, &rects[!side], !xd, best, dist);
+	}
+}
+
+
+/*
+ * Same as nn, for the node i of a snapshot.
+ */
+static void nn_flat(const kdflat_t *flat, uint32_t i, point_p point, rect_p rect, int xd, point_p *best, double *dist)
+{
+	double d;
+	int side;
+	rect_t rects[2];
+	int has[2];
+	point_p node_point = (point_p) &flat[i].point;
+
+	if (rect_min_dist_to(rect, point) > *dist) {
+		return;
+	}
+
+	d = point_dist(node_point, point);
+	if (d < *dist || (d == *dist && !*best)) {
+		*best = node_point;
+		*dist = d;
+	}
+
+	has[0] = flat[i].child[0] != NO_NODE && !rect_set_lower(rect, &rects[0], node_point, xd);
+	has[1] = flat[i].child[1] != NO_NODE && !rect_set_upper(rect, &rects[1], node_point, xd);
+	side = point->dim[xd] > node_point->dim[xd];
+
+	if (has[side]) {
+		nn_flat(flat, flat[i].child[side], point, &rects[side], !xd, best, dist);
+	}
+	if (has[!side]) {
+		nn_flat(flat, flat[i].child[!side], point, &rects[!side], !xd, best, dist);
+	}
+}
+
+
+point_p kdtree_nearest_within(kdtree_p tree, point_p point, double thre, double *dist)
+{
+	point_p best = NULL;
+	double best_dist = thre;
+	rect_t rect = tree->rect;
+
+	if (tree->flat) {
+		nn_flat(tree->flat, 0, point, &rect, ROOT_XD, &best, &best_dist);
+	} else {
+		nn(tree->root, point, &rect, ROOT_XD, &best, &best_dist);
+	}
+
+	if (best && dist) {
+		*dist = best_dist;
 	}
+	return best;
+}
 
-	rect_set_lower(rect, &left_rect, point, xd);
-	rect_set_upper(rect, &right_rect, point, xd);
 
-	knn(L(node), point, &left_rect, dist, !xd, best);
-	knn(R(node), point, &right_rect, dist, !xd, best);
+point_p kdtree_nearest_neighbour(kdtree_p tree, point_p point)
+{
+	return kdtree_nearest_within(tree, point, INFINITY, NULL);
 }
 
 
 static int cmp(const void *a, const void *b)
 {
-	double dista = (*(point_dist_p *) a)->dist;
-	double distb = (*(point_dist_p *) b)->dist;
+	double dista = ((point_dist_p) a)->dist;
+	double distb = ((point_dist_p) b)->dist;
 
 	if (dista < distb) {
 		return -1;
@@ -343,59 +648,198 @@ point_p *kdtree_k_nearest_neighbour(kdtree_p tree, point_p point, double thre, s
 {
 	int i, n;
 	array_p best = NULL;
-	point_dist_p *best_list = NULL;
+	point_dist_t *best_list = NULL; // non-allocated pointer
 	point_p *result = NULL;
 
-#define FREEALL()\
-	{\
-		free(best_list); best_list = NULL;\
-		array_destroy(best); best = NULL;\
-	}
-
 	*ret_size = 0;
 	
-	best = array_create(512);
+	best = array_create_typed(sizeof(point_dist_t), 512);
 	if (!best) {
 		return NULL;
 	}
 
-	knn(tree->root, point, tree->rect, thre, 0, best);
-	n = array_size(best);
-
-	best_list = (point_dist_p *) malloc(sizeof(point_dist_p) * n);
-	if (!best_list) {
-		FREEALL();
+	if (kdtree_neighbours_dist(tree, point, thre, best)) {
+		array_destroy(best);
 		return NULL;
 	}
+	n = array_size(best);
 
-	array_to_list(best, (void **) best_list);
-	array_destroy(best);
-	best = NULL;
-
-	qsort(best_list, n, sizeof(point_dist_p), cmp);
+	best_list = (point_dist_t *) array_data(best);
+	qsort(best_list, n, sizeof(point_dist_t), cmp);
 
 	result = (point_p *) malloc(sizeof(point_p) * n);
 	if (!result) {
-		FREEALL();
+		array_destroy(best);
 		return NULL;
 	}
 
 	for (i = 0; i < n; ++i) {
-		result[i] = ((point_dist_p) best_list[i])->point;
-		free(best_list[i]);
-		best_list[i] = NULL;
+		result[i] = best_list[i].point;
 	}
 
 	*ret_size = n;
 
-	FREEALL();
+	array_destroy(best);
 	return result;
+}
+
+
+/*
+ * Lay the nodes under node out from flat[*next], in preorder.
+ *
+ * Returns: the index of node.
+ */
+static uint32_t flatten(kdnode_p node, kdflat_t *flat, uint32_t *next, const char *base, size_t stride)
+{
+	uint32_t i = (*next)++;
+	uint32_t j;
 
-#undef FREEALL
+	flat[i].point = *node->point;
+	flat[i].id = (uint32_t) (((const char *) node->point - base) / stride);
+	flat[i].reserved = 0;
 
+	for (j = 0; j < 2; ++j) {
+		flat[i].child[j] = node->child[j] ? flatten(node->child[j], flat, next, base, stride) : NO_NODE;
+	}
+	return i;
 }
 
 
-#undef SWAP
+int kdtree_save(kdtree_p tree, const char *path, const point_t *base, size_t stride)
+{
+	size_t len = strlen(path) + 32;
+	uint32_t next = 0;
+	kdflat_t *flat = NULL;
+	char *temp = NULL;
+	FILE *file = NULL;
+	kdsnapshot_t header;
+
+	if (!tree->flat && !tree->root) {
+		return -1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(header.magic));
+	header.size = tree->size;
+	header.rect = tree->rect;
+	header.node_bytes = sizeof(kdflat_t);
+	header.root_xd = ROOT_XD;
+
+	if (!tree->flat) {
+		flat = (kdflat_t *) malloc(sizeof(kdflat_t) * tree->size);
+		if (!flat) {
+			return -1;
+		}
+		flatten(tree->root, flat, &next, (const char *) base, stride ? stride : sizeof(point_t));
+	}
+
+	temp = (char *) malloc(len);
+	if (!temp) {
+		free(flat);
+		return -1;
+	}
+	snprintf(temp, len, "%s.%ld.tmp", path, (long) getpid());
+
+	file = fopen(temp, "wb");
+	if (!file) {
+		free(temp);
+		free(flat);
+		return -1;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, file) != 1
+			|| fwrite(flat ? flat : tree->flat, sizeof(kdflat_t), tree->size, file) != tree->size) {
+		fclose(file);
+		unlink(temp);
+		free(temp);
+		free(flat);
+		return -1;
+	}
+
+	if (fclose(file) || rename(temp, path)) {
+		unlink(temp);
+		free(temp);
+		free(flat);
+		return -1;
+	}
+
+	free(temp);
+	free(flat);
+	return 0;
+}
 
 
+kdtree_p kdtree_open(const char *path)
+{
+	int fd;
+	struct stat st;
+	void *map = NULL;
+	const kdsnapshot_t *header = NULL;
+	const kdflat_t *flat = NULL;
+	uint32_t i, j;
+	kdtree_p tree = NULL;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	if (fstat(fd, &st) || (size_t) st.st_size < sizeof(kdsnapshot_t)) {
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+
+	header = (const kdsnapshot_t *) map;
+	if (memcmp(header->magic, MAGIC, sizeof(header->magic))
+			|| header->node_bytes != sizeof(kdflat_t) || header->root_xd != ROOT_XD
+			|| !header->size || header->size >= NO_NODE
+			|| (size_t) st.st_size != sizeof(kdsnapshot_t) + sizeof(kdflat_t) * header->size) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	/*
+	 * the nodes being in preorder, each child comes after its parent: checking
+	 * it once keeps the searches within the mapping, and from looping
+	 */
+	flat = (const kdflat_t *) (header + 1);
+	for (i = 0; i < header->size; ++i) {
+		for (j = 0; j < 2; ++j) {
+			if (flat[i].child[j] != NO_NODE && (flat[i].child[j] <= i || flat[i].child[j] >= header->size)) {
+				munmap(map, st.st_size);
+				return NULL;
+			}
+		}
+	}
+
+	tree = kdtree_create();
+	if (!tree) {
+		munmap(map, st.st_size);
+		return NULL;
+	}
+
+	tree->rect = header->rect;
+	tree->size = header->size;
+	tree->flat = flat;
+	tree->map = map;
+	tree->map_bytes = st.st_size;
+	return tree;
+}
+
+
+long kdtree_point_id(kdtree_p tree, point_p point)
+{
+	if (!tree->flat) {
+		return -1;
+	}
+	return ((const kdflat_t *) point)->id;
+}
+
+
+#undef SWAP
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 
 #include "geo.h"
+#include "array.h"
+#include "alloc.h"
 
 
 /*
@@ -23,6 +25,12 @@ typedef struct s_kdtree *kdtree_p;
 kdtree_p kdtree_create();
 
 
+/*
+ * Same as kdtree_create, with all the memory of the tree coming from the allocator.
+ */
+kdtree_p kdtree_create_with(allocator_p a);
+
+
 /*
  * Create a kdtree statically from a point array.
  *
@@ -31,6 +39,18 @@ kdtree_p kdtree_create();
 kdtree_p kdtree_create_static(point_p *points, size_t n);
 
 
+/*
+ * Build the tree statically from a point array, replacing all the points in it.
+ *
+ * The memory the tree already holds is reused, so rebuilding it with
+ * no more points than before allocates nothing.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed, or no point is given.
+ */
+int kdtree_build(kdtree_p tree, point_p *points, size_t n);
+
+
 /*
  * Destroy the tree, release all memories it uses.
  */
@@ -59,11 +79,22 @@ int kdtree_delete(kdtree_p tree, point_p point);
  * Find the nearest neighbour of the point in the tree.
  *
  * Return NULL if nothing is found.
- * NOTE: the point_p return by this function MUST be freed by the caller!
+ * NOTE: the point_p returned is the one in the tree, it MUST NOT be freed.
  */
 point_p kdtree_nearest_neighbour(kdtree_p tree, point_p point);
 
 
+/*
+ * Same as kdtree_nearest_neighbour, but only within thre from the point,
+ * which prunes the search much more.
+ *
+ * dist: receives the distance of the neighbour found, or NULL
+ *
+ * Return NULL if nothing is found within thre.
+ */
+point_p kdtree_nearest_within(kdtree_p tree, point_p point, double thre, double *dist);
+
+
 /*
  * Find all the neighbours of the point the distance from which to the point is less or equal to thre.
  *
@@ -72,5 +103,99 @@ point_p kdtree_nearest_neighbour(kdtree_p tree, point_p point);
 point_p *kdtree_k_nearest_neighbour(kdtree_p tree, point_p point, double thre, size_t *ret_size);
 
 
+/*
+ * Same as kdtree_k_nearest_neighbour, but append the neighbours to result, in no particular order.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int kdtree_neighbours(kdtree_p tree, point_p point, double thre, array_p result);
+
+
+/*
+ * Filter of the points found in the tree, returning non-zero for the ones to keep.
+ *
+ * arg: the argument given with the filter
+ */
+typedef int (*kdtree_filter_t)(point_p point, void *arg);
+
+
+/*
+ * Same as kdtree_neighbours, but only append the neighbours for which filter returns non-zero,
+ * so that a subset of the points can be searched without building another tree for it.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int kdtree_neighbours_filter(kdtree_p tree, point_p point, double thre,
+		kdtree_filter_t filter, void *arg, array_p result);
+
+
+/*
+ * A point found in the tree, with its distance to the point searched for.
+ */
+typedef struct s_point_dist
+{
+	point_p point;
+	double dist;
+}
+point_dist_t, *point_dist_p;
+
+
+/*
+ * Same as kdtree_neighbours, but append point_dist_t to result, which MUST be
+ * a typed array of point_dist_t.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int kdtree_neighbours_dist(kdtree_p tree, point_p point, double thre, array_p result);
+
+
+/*
+ * Save the tree to a snapshot file, created or truncated.
+ *
+ * The snapshot is a flat array of nodes, each holding its point and the
+ * indexes of its children, so it's position-independent: kdtree_open maps
+ * it and queries it as is, without rebuilding or even reading the tree.
+ *
+ * The points of the tree MUST lie in a single array starting at base,
+ * with stride bytes from one to the next, 0 for tightly packed points;
+ * the index of each point in it is saved with the point.
+ *
+ * NOTE: the snapshot is in the byte order of the machine saving it.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed, or the tree is empty.
+ */
+int kdtree_save(kdtree_p tree, const char *path, const point_t *base, size_t stride);
+
+
+/*
+ * Open a tree saved by kdtree_save, mapping the snapshot into memory.
+ *
+ * The points found in the tree point into the mapping, and are valid until
+ * the tree is destroyed or rebuilt. The tree can't be inserted into nor
+ * deleted from, but can be rebuilt, dropping the snapshot.
+ *
+ * NOTE: the tree created by this function MUST be destroyed by the caller,
+ * using the kdtree_destroy function.
+ *
+ * Returns: the tree if succeed;
+ *          NULL if the file can't be mapped, isn't a snapshot, or has a child
+ *          out of the nodes, or not after its parent.
+ */
+kdtree_p kdtree_open(const char *path);
+
+
+/*
+ * Get the index given to kdtree_save of a point found in a tree opened by kdtree_open.
+ *
+ * Returns: the index of the point;
+ *          -1 if the tree wasn't opened from a snapshot.
+ */
+long kdtree_point_id(kdtree_p tree, point_p point);
+
+
 #endif /* _KDTREE_H */
 
@@ -0,0 +1,208 @@
+#include "model.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "geo.h"
+#include "kdtree.h"
+
+
+#define COORDS(coords, stride, i) ((const double *) ((const char *) (coords) + (stride) * (i)))
+
+/* fewest points a thread is started for */
+#define MIN_QUERIES 1024
+
+
+typedef struct s_model
+{
+	/* the squared eps */
+	double thre;
+
+	/* the core points, and the cluster id of each */
+	point_t *points;
+	int32_t *labels;
+	size_t size;
+
+	kdtree_p tree;
+}
+model_t;
+
+
+/*
+ * A run of points assigned by a thread.
+ */
+typedef struct s_queries
+{
+	model_p model;
+	const double *coords;
+	size_t stride;
+	int32_t *labels;
+	size_t begin;
+	size_t end;
+
+	/* whether a thread is started for the run */
+	int threaded;
+}
+queries_t, *queries_p;
+
+
+model_p model_create(const double *coords, size_t stride, size_t n,
+		const int32_t *labels, const unsigned char *core, double eps)
+{
+	size_t i, m = 0;
+	point_p *list = NULL;
+	model_p model = (model_p) calloc(1, sizeof(model_t));
+
+	if (!model) {
+		return NULL;
+	}
+	stride = stride ? stride : sizeof(double) * 2;
+	model->thre = eps * eps;
+
+	for (i = 0; i < n; ++i) {
+		if (core ? core[i] : labels[i] != 0) {
+			++m;
+		}
+	}
+
+	model->points = (point_t *) malloc(sizeof(point_t) * (m ? m : 1));
+	model->labels = (int32_t *) malloc(sizeof(int32_t) * (m ? m : 1));
+	list = (point_p *) malloc(sizeof(point_p) * (m ? m : 1));
+	if (!model->points || !model->labels || !list) {
+		free(list);
+		model_destroy(model);
+		return NULL;
+	}
+
+	for (i = 0; i < n; ++i) {
+		if (core ? core[i] : labels[i] != 0) {
+			const double *c = COORDS(coords, stride, i);
+
+			model->points[model->size].x = c[0];
+			model->points[model->size].y = c[1];
+			model->labels[model->size] = labels[i];
+			list[model->size] = &model->points[model->size];
+			++model->size;
+		}
+	}
+
+	/* a model without a core point assigns everything to noise */
+	if (m) {
+		model->tree = kdtree_create_static(list, m);
+		if (!model->tree) {
+			free(list);
+			model_destroy(model);
+			return NULL;
+		}
+	}
+
+	free(list);
+	return model;
+}
+
+
+void model_destroy(model_p model)
+{
+	if (model) {
+		kdtree_destroy(model->tree);
+		model->tree = NULL;
+
+		free(model->points);
+		model->points = NULL;
+
+		free(model->labels);
+		model->labels = NULL;
+
+		free(model);
+	}
+}
+
+
+size_t model_size(model_p model)
+{
+	return model->size;
+}
+
+
+int32_t model_assign(model_p model, double x, double y)
+{
+	point_t point;
+	point_p nearest = NULL;
+
+	if (!model->tree) {
+		return 0;
+	}
+
+	point.x = x;
+	point.y = y;
+	nearest = kdtree_nearest_within(model->tree, &point, model->thre, NULL);
+	return nearest ? model->labels[nearest - model->points] : 0;
+}
+
+
+static void *assign_run(void *arg)
+{
+	size_t i;
+	queries_p q = (queries_p) arg;
+
+	for (i = q->begin; i < q->end; ++i) {
+		const double *c = COORDS(q->coords, q->stride, i);
+		q->labels[i] = model_assign(q->model, c[0], c[1]);
+	}
+	return NULL;
+}
+
+
+int model_assign_batch(model_p model, const double *coords, size_t stride, size_t n,
+		int32_t *labels, unsigned int threads)
+{
+	unsigned int t;
+	queries_t *runs = NULL;
+	pthread_t *tids = NULL;
+
+	stride = stride ? stride : sizeof(double) * 2;
+
+	if (!threads) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (unsigned int) cpus : 1;
+	}
+	/* not worth a thread for less than MIN_QUERIES points */
+	if (threads > n / MIN_QUERIES) {
+		threads = n / MIN_QUERIES ? (unsigned int) (n / MIN_QUERIES) : 1;
+	}
+
+	runs = (queries_t *) calloc(threads, sizeof(queries_t));
+	tids = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+	if (!runs || !tids) {
+		free(runs);
+		free(tids);
+		return -1;
+	}
+
+	for (t = 0; t < threads; ++t) {
+		runs[t] = (queries_t) {
+			.model = model, .coords = coords, .stride = stride, .labels = labels,
+			.begin = n * t / threads,
+			.end = n * (t + 1) / threads
+		};
+	}
+
+	for (t = 1; t < threads; ++t) {
+		runs[t].threaded = !pthread_create(&tids[t], NULL, assign_run, &runs[t]);
+	}
+	for (t = 0; t < threads; ++t) {
+		if (runs[t].threaded) {
+			pthread_join(tids[t], NULL);
+		} else {
+			/* this thread, or the thread of the run failed to start */
+			assign_run(&runs[t]);
+		}
+	}
+
+	free(runs);
+	free(tids);
+	return 0;
+}
+
@@ -0,0 +1,76 @@
+/* Model of a finished clustering, assigning new points to its clusters. */
+
+#ifndef _MODEL_H_
+#define _MODEL_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+
+/*
+ * Cluster model.
+ *
+ * It indexes the core points of a clustering in a kd-tree, so that a new
+ * point is assigned to the cluster of its nearest core point within eps,
+ * as DBSCAN would make it a border point of that cluster, without
+ * clustering again.
+ */
+typedef struct s_model *model_p;
+
+
+/*
+ * Create the model of the clustering of the points in a coordinate buffer,
+ * as dbscan_cluster_labels takes it.
+ *
+ * labels: the cluster id of each point, 0 for noise
+ * core: 1 for each core point, 0 for the others, as dbscan_core_labels gives it,
+ *       or NULL to take all the points not labelled 0 as core points
+ * eps: the radius the clustering is done with
+ *
+ * NOTE: the model created by this function MUST be destroyed by the caller,
+ * using model_destroy.
+ *
+ * Returns: the model if succeed;
+ *          NULL if failed.
+ */
+model_p model_create(const double *coords, size_t stride, size_t n,
+		const int32_t *labels, const unsigned char *core, double eps);
+
+
+/*
+ * Destroy the model, release all memories it uses.
+ */
+void model_destroy(model_p model);
+
+
+/*
+ * Get the number of core points in the model.
+ */
+size_t model_size(model_p model);
+
+
+/*
+ * Assign a point to a cluster of the model.
+ *
+ * The model is only read, so any number of threads can assign points at a time.
+ *
+ * Returns: the cluster id of the nearest core point within eps;
+ *          0 if there is none.
+ */
+int32_t model_assign(model_p model, double x, double y);
+
+
+/*
+ * Assign the points in a coordinate buffer to the clusters of the model,
+ * in threads threads, 0 for one per online processor.
+ *
+ * labels: receives the cluster id of each point, MUST have space for n items
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int model_assign_batch(model_p model, const double *coords, size_t stride, size_t n,
+		int32_t *labels, unsigned int threads);
+
+
+#endif /* _MODEL_H_ */
@@ -0,0 +1,555 @@
+#include "nbgraph.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "array.h"
+#include "kdtree.h"
+
+
+#define POINT(points, stride, i) ((point_p) ((char *) (points) + (stride) * (i)))
+
+/* fewest rows a thread is started for */
+#define MIN_ROWS 1024
+
+
+static int cmp(const void *a, const void *b)
+{
+	double dista = ((point_dist_p) a)->dist;
+	double distb = ((point_dist_p) b)->dist;
+
+	if (dista < distb) {
+		return -1;
+	} else if (dista > distb) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+
+/*
+ * The rows of the points in [begin, end), built by one thread.
+ */
+typedef struct s_rows
+{
+	point_p points;
+	size_t stride;
+	double thre;
+	int keep_dist;
+
+	kdtree_p tree;
+	point_p *list;
+	unsigned int begin;
+	unsigned int end;
+
+	/* receives the number of neighbours of each point, at counts[i - begin] */
+	size_t *counts;
+	array_p adj;
+	array_p dist;
+	array_p found;
+
+	/* whether a thread is started for the rows */
+	int threaded;
+
+	int result;
+}
+rows_t, *rows_p;
+
+
+/*
+ * The memory a graph keeps from one build to the next, see nbgraph_build.
+ */
+typedef struct s_nbgraph_work
+{
+	allocator_p alloc;
+
+	/* alloc behind the lock, for the threads */
+	allocator_t locked;
+	pthread_mutex_t lock;
+
+	/* growing buffers, see reserve */
+	size_t offsets_n;
+	size_t adj_n;
+	double *dist; // the one of the graph, if it keeps the distances
+	size_t dist_n;
+	point_p *list;
+	size_t list_n;
+	pthread_t *tids;
+	size_t tids_n;
+	char *core; // for nbgraph_cluster
+	size_t core_n;
+	char *noise;
+	size_t noise_n;
+	unsigned int *stack;
+	size_t stack_n;
+
+	kdtree_p tree;
+
+	/* the rows of each thread, their arrays being kept too */
+	rows_t *rows;
+	size_t rows_n;
+}
+nbgraph_work_t, *nbgraph_work_p;
+
+
+/*
+ * Make sure the buffer has space for n items of bytes each, at least 1.
+ *
+ * The content is not kept when it has to be enlarged.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int reserve(allocator_p a, void **buf, size_t *buf_n, size_t n, size_t bytes)
+{
+	void *new_buf = NULL;
+
+	n = n ? n : 1;
+	if (n <= *buf_n) {
+		return 0;
+	}
+
+	if (n < *buf_n * 2) {
+		n = *buf_n * 2;
+	}
+
+	new_buf = mem_alloc(a, n * bytes);
+	if (!new_buf) {
+		return -1;
+	}
+
+	mem_free(a, *buf, *buf_n * bytes);
+	*buf = new_buf;
+	*buf_n = n;
+	return 0;
+}
+
+
+static void *locked_alloc(void *state, size_t bytes)
+{
+	nbgraph_work_p work = (nbgraph_work_p) state;
+	void *ptr = NULL;
+
+	pthread_mutex_lock(&work->lock);
+	ptr = mem_alloc(work->alloc, bytes);
+	pthread_mutex_unlock(&work->lock);
+	return ptr;
+}
+
+
+static void *locked_realloc(void *state, void *ptr, size_t old_bytes, size_t bytes)
+{
+	nbgraph_work_p work = (nbgraph_work_p) state;
+
+	pthread_mutex_lock(&work->lock);
+	ptr = mem_realloc(work->alloc, ptr, old_bytes, bytes);
+	pthread_mutex_unlock(&work->lock);
+	return ptr;
+}
+
+
+static void locked_free(void *state, void *ptr, size_t bytes)
+{
+	nbgraph_work_p work = (nbgraph_work_p) state;
+
+	pthread_mutex_lock(&work->lock);
+	mem_free(work->alloc, ptr, bytes);
+	pthread_mutex_unlock(&work->lock);
+}
+
+
+/*
+ * Find the neighbours of the points in rows, in the CSR order.
+ */
+static void *build_rows(void *arg)
+{
+	unsigned int i, j;
+	rows_p rows = (rows_p) arg;
+	array_p found = rows->found;
+
+	rows->result = -1;
+
+	for (i = rows->begin; i < rows->end; ++i) {
+		point_dist_t *pds = NULL; // non-allocated pointer
+		size_t m = 0;
+
+		array_clear(found);
+		if (kdtree_neighbours_dist(rows->tree, rows->list[i], rows->thre, found)) {
+			return NULL;
+		}
+		pds = (point_dist_t *) array_data(found);
+		m = array_size(found);
+
+		if (rows->keep_dist) {
+			qsort(pds, m, sizeof(point_dist_t), cmp);
+		}
+
+		for (j = 0; j < m; ++j) {
+			unsigned int index = (unsigned int) (((char *) pds[j].point - (char *) rows->points) / rows->stride);
+
+			if (array_push(rows->adj, &index)
+					|| (rows->keep_dist && array_push(rows->dist, &pds[j].dist))) {
+				return NULL;
+			}
+		}
+		rows->counts[i - rows->begin] = m;
+	}
+
+	rows->result = 0;
+	return NULL;
+}
+
+
+nbgraph_p nbgraph_create(point_p points, size_t stride, size_t n, double thre, int flags)
+{
+	return nbgraph_create_parallel(points, stride, n, thre, flags, 1);
+}
+
+
+nbgraph_p nbgraph_create_parallel(point_p points, size_t stride, size_t n, double thre, int flags,
+		unsigned int threads)
+{
+	nbgraph_p graph = nbgraph_create_with(NULL);
+
+	if (graph && nbgraph_build(graph, points, stride, n, thre, flags, threads)) {
+		nbgraph_destroy(graph);
+		return NULL;
+	}
+	return graph;
+}
+
+
+nbgraph_p nbgraph_create_with(allocator_p a)
+{
+	nbgraph_work_p work = NULL;
+	nbgraph_p graph = (nbgraph_p) mem_calloc(a, 1, sizeof(nbgraph_t));
+
+	if (!graph) {
+		return NULL;
+	}
+
+	work = (nbgraph_work_p) mem_calloc(a, 1, sizeof(nbgraph_work_t));
+	if (!work) {
+		mem_free(a, graph, sizeof(nbgraph_t));
+		return NULL;
+	}
+	if (pthread_mutex_init(&work->lock, NULL)) {
+		mem_free(a, work, sizeof(nbgraph_work_t));
+		mem_free(a, graph, sizeof(nbgraph_t));
+		return NULL;
+	}
+	work->alloc = a;
+	work->locked.alloc = locked_alloc;
+	work->locked.realloc = locked_realloc;
+	work->locked.free = locked_free;
+	work->locked.state = work;
+	graph->work = work;
+
+	work->tree = kdtree_create_with(a);
+	if (!work->tree) {
+		nbgraph_destroy(graph);
+		return NULL;
+	}
+	return graph;
+}
+
+
+/*
+ * Make sure there are the rows of threads threads, with their arrays.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+static int reserve_rows(nbgraph_work_p work, unsigned int threads, int keep_dist, size_t init_size)
+{
+	unsigned int t;
+
+	if (threads > work->rows_n) {
+		rows_t *rows = (rows_t *) mem_realloc(work->alloc, work->rows,
+				sizeof(rows_t) * work->rows_n, sizeof(rows_t) * threads);
+		if (!rows) {
+			return -1;
+		}
+		memset(rows + work->rows_n, 0, sizeof(rows_t) * (threads - work->rows_n));
+		work->rows = rows;
+		work->rows_n = threads;
+	}
+
+	for (t = 0; t < threads; ++t) {
+		rows_p rows = &work->rows[t];
+
+		if (!rows->adj) {
+			rows->adj = array_create_typed_with(&work->locked, sizeof(unsigned int), init_size);
+		}
+		if (keep_dist && !rows->dist) {
+			rows->dist = array_create_typed_with(&work->locked, sizeof(double), init_size);
+		}
+		if (!rows->found) {
+			rows->found = array_create_typed_with(&work->locked, sizeof(point_dist_t), 64);
+		}
+		if (!rows->adj || (keep_dist && !rows->dist) || !rows->found) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+int nbgraph_build(nbgraph_p graph, point_p points, size_t stride, size_t n, double thre, int flags,
+		unsigned int threads)
+{
+	unsigned int i, t;
+	int keep_dist = flags & NBGRAPH_KEEP_DIST;
+	size_t edges = 0;
+	nbgraph_work_p work = graph->work;
+	allocator_p a = work->alloc;
+
+	/* left with no points until built */
+	graph->n = 0;
+	graph->thre = thre;
+	graph->dist = NULL;
+
+	if (!threads) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = cpus > 0 ? (unsigned int) cpus : 1;
+	}
+	/* not worth a thread for less than MIN_ROWS points */
+	if (threads > n / MIN_ROWS) {
+		threads = n / MIN_ROWS ? (unsigned int) (n / MIN_ROWS) : 1;
+	}
+
+	if (reserve(a, (void **) &graph->offsets, &work->offsets_n, n + 1, sizeof(size_t))
+			|| reserve(a, (void **) &work->list, &work->list_n, n, sizeof(point_p))
+			|| reserve(a, (void **) &work->tids, &work->tids_n, threads, sizeof(pthread_t))
+			|| reserve_rows(work, threads, keep_dist, n / threads * 8)) {
+		return -1;
+	}
+
+	for (i = 0; i < n; ++i) {
+		work->list[i] = POINT(points, stride, i);
+	}
+
+	if (n && kdtree_build(work->tree, work->list, n)) {
+		return -1;
+	}
+
+	/* each thread takes a run of rows, counting its neighbours into offsets[begin + 1, end + 1) */
+	for (t = 0; t < threads; ++t) {
+		rows_p rows = &work->rows[t];
+
+		rows->points = points;
+		rows->stride = stride;
+		rows->thre = thre;
+		rows->keep_dist = keep_dist;
+		rows->tree = work->tree;
+		rows->list = work->list;
+		rows->begin = (unsigned int) (n * t / threads);
+		rows->end = (unsigned int) (n * (t + 1) / threads);
+		rows->counts = graph->offsets + rows->begin + 1;
+		rows->threaded = 0;
+		rows->result = -1;
+		array_clear(rows->adj);
+		if (keep_dist) {
+			array_clear(rows->dist);
+		}
+	}
+
+	for (t = 1; t < threads; ++t) {
+		work->rows[t].threaded = !pthread_create(&work->tids[t], NULL, build_rows, &work->rows[t]);
+	}
+	for (t = 0; t < threads; ++t) {
+		if (work->rows[t].threaded) {
+			pthread_join(work->tids[t], NULL);
+		} else {
+			/* this thread, or the thread of the rows failed to start */
+			build_rows(&work->rows[t]);
+		}
+	}
+
+	for (t = 0; t < threads; ++t) {
+		if (work->rows[t].result) {
+			return -1;
+		}
+		edges += array_size(work->rows[t].adj);
+	}
+
+	graph->offsets[0] = 0;
+	for (i = 0; i < n; ++i) {
+		graph->offsets[i + 1] += graph->offsets[i];
+	}
+
+	if (reserve(a, (void **) &graph->adj, &work->adj_n, edges, sizeof(unsigned int))
+			|| (keep_dist && reserve(a, (void **) &work->dist, &work->dist_n, edges, sizeof(double)))) {
+		return -1;
+	}
+
+	for (t = 0; t < threads; ++t) {
+		rows_p rows = &work->rows[t];
+		size_t first = graph->offsets[rows->begin], m = array_size(rows->adj);
+
+		memcpy(graph->adj + first, array_data(rows->adj), sizeof(unsigned int) * m);
+		if (keep_dist) {
+			memcpy(work->dist + first, array_data(rows->dist), sizeof(double) * m);
+		}
+	}
+
+	graph->n = n;
+	graph->dist = keep_dist ? work->dist : NULL;
+	return 0;
+}
+
+
+void nbgraph_destroy(nbgraph_p graph)
+{
+	size_t t;
+
+	if (graph) {
+		nbgraph_work_p work = graph->work;
+		allocator_p a = work->alloc;
+
+		mem_free(a, graph->offsets, sizeof(size_t) * work->offsets_n);
+		graph->offsets = NULL;
+
+		mem_free(a, graph->adj, sizeof(unsigned int) * work->adj_n);
+		graph->adj = NULL;
+
+		mem_free(a, work->dist, sizeof(double) * work->dist_n);
+		graph->dist = NULL;
+
+		for (t = 0; t < work->rows_n; ++t) {
+			array_destroy(work->rows[t].adj);
+			array_destroy(work->rows[t].dist);
+			array_destroy(work->rows[t].found);
+		}
+		mem_free(a, work->rows, sizeof(rows_t) * work->rows_n);
+		mem_free(a, work->list, sizeof(point_p) * work->list_n);
+		mem_free(a, work->tids, sizeof(pthread_t) * work->tids_n);
+		mem_free(a, work->core, work->core_n);
+		mem_free(a, work->noise, work->noise_n);
+		mem_free(a, work->stack, sizeof(unsigned int) * work->stack_n);
+		kdtree_destroy(work->tree);
+
+		pthread_mutex_destroy(&work->lock);
+		mem_free(a, work, sizeof(nbgraph_work_t));
+
+		mem_free(a, graph, sizeof(nbgraph_t));
+	}
+}
+
+
+/*
+ * Get the end of the neighbours of point i within thre, in adj.
+ */
+static inline size_t row_end(nbgraph_p graph, unsigned int i, double thre)
+{
+	size_t lo = graph->offsets[i], hi = graph->offsets[i + 1];
+
+	if (!graph->dist || thre >= graph->thre) {
+		return hi;
+	}
+
+	/* the first one beyond thre */
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (graph->dist[mid] <= thre) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+
+size_t nbgraph_degree(nbgraph_p graph, unsigned int i, double thre)
+{
+	return row_end(graph, i, thre) - graph->offsets[i];
+}
+
+
+/*
+ * DBSCAN over the graph.
+ *
+ * ref: A Density-Based Algorithm for Discovering Clusters in Large Spatial Databases with Noise
+ *      Martin Ester, Hans-Peter Kriegel, Jorg Sander, Xiaowei Xu
+ */
+int nbgraph_cluster(nbgraph_p graph, const double *weights, double thre, double min_pts, unsigned long *ids)
+{
+	unsigned int i, u;
+	size_t j, end, n = graph->n, top = 0;
+	unsigned long next_id = 0;
+	nbgraph_work_p work = graph->work;
+	char *core = NULL, *noise = NULL; // non-allocated pointers
+	unsigned int *stack = NULL; // non-allocated pointer
+
+	if (reserve(work->alloc, (void **) &work->core, &work->core_n, n, sizeof(char))
+			|| reserve(work->alloc, (void **) &work->noise, &work->noise_n, n, sizeof(char))
+			|| reserve(work->alloc, (void **) &work->stack, &work->stack_n, n, sizeof(unsigned int))) {
+		return -1;
+	}
+	core = work->core;
+	noise = work->noise;
+	stack = work->stack;
+
+	/* find all the core points */
+	for (i = 0; i < n; ++i) {
+		double total = 0.0;
+
+		end = row_end(graph, i, thre);
+		for (j = graph->offsets[i]; j < end; ++j) {
+			total += weights ? weights[graph->adj[j]] : 1.0;
+		}
+		core[i] = total >= min_pts;
+		ids[i] = 0;
+	}
+
+	/* expand a cluster from each core point not in any cluster yet */
+	for (i = 0; i < n; ++i) {
+		if (!core[i] || ids[i]) {
+			continue;
+		}
+
+		ids[i] = ++next_id;
+		stack[top++] = i;
+
+		while (top) {
+			u = stack[--top];
+
+			end = row_end(graph, u, thre);
+			for (j = graph->offsets[u]; j < end; ++j) {
+				unsigned int v = graph->adj[j];
+
+				if (!ids[v]) {
+					ids[v] = next_id;
+					if (core[v]) {
+						stack[top++] = v;
+					}
+				}
+			}
+		}
+	}
+
+	/* collect the noise (outliers), put them into new clusters */
+	for (i = 0; i < n; ++i) {
+		noise[i] = !ids[i];
+	}
+	for (i = 0; i < n; ++i) {
+		if (!noise[i] || ids[i]) {
+			continue;
+		}
+
+		++next_id;
+		end = row_end(graph, i, thre);
+		for (j = graph->offsets[i]; j < end; ++j) {
+			if (noise[graph->adj[j]]) {
+				ids[graph->adj[j]] = next_id;
+			}
+		}
+	}
+
+	return (int) next_id;
+}
@@ -0,0 +1,139 @@
+/* Neighbour graph of 2D points. */
+
+#ifndef _NBGRAPH_H_
+#define _NBGRAPH_H_
+
+#include <stdlib.h>
+
+#include "geo.h"
+#include "alloc.h"
+
+
+/*
+ * Neighbour graph, in compressed sparse row form.
+ *
+ * The neighbours of point i, including itself, are the points indexed by
+ * adj[offsets[i]], ..., adj[offsets[i + 1] - 1].
+ */
+typedef struct s_nbgraph
+{
+	/* number of points */
+	size_t n;
+
+	/* the squared distance the graph is created with */
+	double thre;
+
+	/* n + 1 offsets into adj */
+	size_t *offsets;
+	unsigned int *adj;
+
+	/*
+	 * Squared distance of each edge, in the same order as adj,
+	 * the neighbours of each point being sorted by it.
+	 *
+	 * NULL if the graph is created without NBGRAPH_KEEP_DIST.
+	 */
+	double *dist;
+
+	/* the memory kept to build and cluster the graph again, see nbgraph_build */
+	struct s_nbgraph_work *work;
+}
+nbgraph_t, *nbgraph_p;
+
+
+/*
+ * Flags for nbgraph_create.
+ */
+
+/* keep the distances, sorting the neighbours of each point by them */
+#define NBGRAPH_KEEP_DIST 0x01
+
+
+/*
+ * Create the graph linking all the points within thre from each other.
+ *
+ * Point i is at (char *) points + stride * i, and thre is a squared distance,
+ * as returned by point_dist.
+ *
+ * The points MUST NOT contain duplicates.
+ *
+ * NOTE: the graph created by this function MUST be destroyed by the caller,
+ * using nbgraph_destroy.
+ */
+nbgraph_p nbgraph_create(point_p points, size_t stride, size_t n, double thre, int flags);
+
+
+/*
+ * Same as nbgraph_create, searching the neighbours in threads threads,
+ * 0 for one per online processor.
+ *
+ * The kd-tree is shared by all the threads, each of which fills the rows
+ * of a run of points; the graph is the same as nbgraph_create's.
+ */
+nbgraph_p nbgraph_create_parallel(point_p points, size_t stride, size_t n, double thre, int flags,
+		unsigned int threads);
+
+
+/*
+ * Create a graph of no points, to be built by nbgraph_build, with all the
+ * memory of the graph, and of building and clustering it, coming from the
+ * allocator.
+ *
+ * The threads building the graph take their memory from the allocator under
+ * a lock, so it needn't be thread-safe.
+ *
+ * NOTE: the graph created by this function MUST be destroyed by the caller,
+ * using nbgraph_destroy.
+ */
+nbgraph_p nbgraph_create_with(allocator_p a);
+
+
+/*
+ * Build the graph again, as nbgraph_create_parallel creates it, over new points.
+ *
+ * The memory the graph already holds is reused, so building it again for
+ * no more points and neighbours than before allocates nothing.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed, the graph being left with no points.
+ */
+int nbgraph_build(nbgraph_p graph, point_p points, size_t stride, size_t n, double thre, int flags,
+		unsigned int threads);
+
+
+/*
+ * Destroy the graph, release all memories it uses.
+ */
+void nbgraph_destroy(nbgraph_p graph);
+
+
+/*
+ * Get the number of neighbours of point i within thre, where thre is no
+ * larger than the one the graph is created with.
+ *
+ * NOTE: the graph MUST be created with NBGRAPH_KEEP_DIST, unless thre is
+ * the one it's created with.
+ */
+size_t nbgraph_degree(nbgraph_p graph, unsigned int i, double thre);
+
+
+/*
+ * Cluster the points of the graph, using DBSCAN over the edges within thre.
+ *
+ * weights: weight of each point for the min_pts test, NULL for all 1
+ * ids: receives the cluster id of each point
+ *
+ * The points which belong to no cluster are grouped with their
+ * neighbours that also belong to no cluster, each group getting its own id,
+ * as dbscan_cluster does.
+ *
+ * NOTE: the memory it works with is kept in the graph, so the same graph
+ * MUST NOT be clustered by several threads at once.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int nbgraph_cluster(nbgraph_p graph, const double *weights, double thre, double min_pts, unsigned long *ids);
+
+
+#endif /* _NBGRAPH_H_ */
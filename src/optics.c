@@ -0,0 +1,226 @@
+#include "optics.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "array.h"
+#include "kdtree.h"
+#include "pqueue.h"
+
+
+#define POINT(points, stride, i) ((point_p) ((char *) (points) + (stride) * (i)))
+
+
+static int cmp(const void *a, const void *b)
+{
+	double dista = ((point_dist_p) a)->dist;
+	double distb = ((point_dist_p) b)->dist;
+
+	if (dista < distb) {
+		return -1;
+	} else if (dista > distb) {
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+
+/*
+ * Get the core distance of a point from its neighbours, sorting them by distance.
+ */
+static double core_distance(point_dist_t *pds, size_t m, point_p points, size_t stride,
+		const double *weights, double min_pts)
+{
+	unsigned int j;
+	double total = 0.0;
+
+	if (!weights) {
+		if (m < min_pts) {
+			return INFINITY;
+		}
+	} else {
+		for (j = 0; j < m; ++j) {
+			total += weights[((char *) pds[j].point - (char *) points) / stride];
+		}
+		if (total < min_pts) {
+			return INFINITY;
+		}
+		total = 0.0;
+	}
+
+	qsort(pds, m, sizeof(point_dist_t), cmp);
+
+	for (j = 0; j < m; ++j) {
+		total += weights ? weights[((char *) pds[j].point - (char *) points) / stride] : 1.0;
+		if (total >= min_pts) {
+			return pds[j].dist;
+		}
+	}
+	return INFINITY;
+}
+
+
+optics_p optics_create(point_p points, size_t stride, size_t n, const double *weights,
+		double thre, double min_pts)
+{
+	return optics_create_with(NULL, points, stride, n, weights, thre, min_pts);
+}
+
+
+optics_p optics_create_with(allocator_p a, point_p points, size_t stride, size_t n, const double *weights,
+		double thre, double min_pts)
+{
+	unsigned int i, j, k = 0;
+	optics_p optics = NULL;
+	point_p *list = NULL;
+	char *processed = NULL;
+	kdtree_p tree = NULL;
+	pqueue_p seeds = NULL;
+	array_p found = NULL;
+
+#define FREEALL()\
+	{\
+		mem_free(a, list, sizeof(point_p) * (n ? n : 1)); list = NULL;\
+		mem_free(a, processed, n ? n : 1); processed = NULL;\
+		kdtree_destroy(tree); tree = NULL;\
+		pqueue_destroy(seeds); seeds = NULL;\
+		array_destroy(found); found = NULL;\
+	}
+
+	optics = (optics_p) mem_calloc(a, 1, sizeof(optics_t));
+	if (!optics) {
+		return NULL;
+	}
+	optics->alloc = a;
+
+	list = (point_p *) mem_alloc(a, sizeof(point_p) * (n ? n : 1));
+	processed = (char *) mem_calloc(a, n ? n : 1, 1);
+	seeds = pqueue_create_with(a, n);
+	found = array_create_typed_with(a, sizeof(point_dist_t), 64);
+	tree = kdtree_create_with(a);
+	if (!list || !processed || !seeds || !found || !tree) {
+		FREEALL();
+		optics_destroy(optics);
+		return NULL;
+	}
+
+	optics->n = n;
+	optics->thre = thre;
+	optics->order = (unsigned int *) mem_alloc(a, sizeof(unsigned int) * (n ? n : 1));
+	optics->core_dist = (double *) mem_alloc(a, sizeof(double) * (n ? n : 1));
+	optics->reach = (double *) mem_alloc(a, sizeof(double) * (n ? n : 1));
+	if (!optics->order || !optics->core_dist || !optics->reach) {
+		FREEALL();
+		optics_destroy(optics);
+		return NULL;
+	}
+
+	for (i = 0; i < n; ++i) {
+		list[i] = POINT(points, stride, i);
+		optics->reach[i] = INFINITY;
+	}
+
+	if (n && kdtree_build(tree, list, n)) {
+		FREEALL();
+		optics_destroy(optics);
+		return NULL;
+	}
+
+	for (i = 0; i < n; ++i) {
+		unsigned int p = i;
+
+		if (processed[i]) {
+			continue;
+		}
+
+		/* visit the point, then the points reachable from it, nearest first */
+		do {
+			point_dist_t *pds = NULL; // non-allocated pointer
+			size_t m = 0;
+			double core = INFINITY;
+
+			array_clear(found);
+			if (kdtree_neighbours_dist(tree, list[p], thre, found)) {
+				FREEALL();
+				optics_destroy(optics);
+				return NULL;
+			}
+			pds = (point_dist_t *) array_data(found);
+			m = array_size(found);
+
+			core = core_distance(pds, m, points, stride, weights, min_pts);
+			optics->core_dist[p] = core;
+			optics->order[k++] = p;
+			processed[p] = 1;
+
+			if (core == INFINITY) {
+				continue;
+			}
+
+			for (j = 0; j < m; ++j) {
+				unsigned int q = (unsigned int) (((char *) pds[j].point - (char *) points) / stride);
+				double r = pds[j].dist > core ? pds[j].dist : core;
+
+				if (!processed[q] && r < optics->reach[q]) {
+					optics->reach[q] = r;
+					pqueue_update(seeds, q, r);
+				}
+			}
+		} while (!pqueue_pop(seeds, &p, NULL));
+	}
+
+	FREEALL();
+	return optics;
+
+#undef FREEALL
+
+}
+
+
+void optics_destroy(optics_p optics)
+{
+	if (optics) {
+		size_t n = optics->n ? optics->n : 1;
+
+		mem_free(optics->alloc, optics->order, sizeof(unsigned int) * n);
+		optics->order = NULL;
+
+		mem_free(optics->alloc, optics->core_dist, sizeof(double) * n);
+		optics->core_dist = NULL;
+
+		mem_free(optics->alloc, optics->reach, sizeof(double) * n);
+		optics->reach = NULL;
+
+		mem_free(optics->alloc, optics, sizeof(optics_t));
+	}
+}
+
+
+/*
+ * ExtractDBSCAN-Clustering, from the paper of OPTICS.
+ */
+int optics_extract(const unsigned int *order, const double *core_dist, const double *reach,
+		size_t n, double thre, int32_t *labels)
+{
+	unsigned int k;
+	int32_t id = 0;
+
+	for (k = 0; k < n; ++k) {
+		unsigned int p = order[k];
+
+		if (reach[p] > thre) {
+			if (core_dist[p] <= thre) {
+				/* a core point not reached from the cluster before, start a new one */
+				labels[p] = ++id;
+			} else {
+				labels[p] = 0;
+			}
+		} else {
+			/* reached from a core point of the current cluster */
+			labels[p] = id;
+		}
+	}
+
+	return (int) id;
+}
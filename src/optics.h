@@ -0,0 +1,92 @@
+/* OPTICS ordering of 2D points. */
+
+#ifndef _OPTICS_H_
+#define _OPTICS_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "geo.h"
+#include "alloc.h"
+
+
+/*
+ * Cluster ordering of the points.
+ *
+ * All the distances are squared, as returned by point_dist, and are
+ * INFINITY where undefined.
+ */
+typedef struct s_optics
+{
+	allocator_p alloc;
+
+	/* number of points */
+	size_t n;
+
+	/* the squared distance the ordering is computed with */
+	double thre;
+
+	/* the points, in the order they are visited */
+	unsigned int *order;
+
+	/* core distance of each point, INFINITY if it is not a core point within thre */
+	double *core_dist;
+
+	/* reachability distance of each point, INFINITY if it is not reached from any core point */
+	double *reach;
+}
+optics_t, *optics_p;
+
+
+/*
+ * Compute the cluster ordering of the points.
+ *
+ * Point i is at (char *) points + stride * i, and thre is a squared distance.
+ *
+ * weights: weight of each point for the min_pts test, NULL for all 1
+ *
+ * The points MUST NOT contain duplicates, which can be given as weights instead.
+ *
+ * ref: OPTICS: Ordering Points To Identify the Clustering Structure
+ *      Mihael Ankerst, Markus M. Breunig, Hans-Peter Kriegel, Jorg Sander
+ *
+ * NOTE: the ordering created by this function MUST be destroyed by the caller,
+ * using optics_destroy.
+ */
+optics_p optics_create(point_p points, size_t stride, size_t n, const double *weights,
+		double thre, double min_pts);
+
+
+/*
+ * Same as optics_create, with all the memory of the ordering, and of its
+ * computation, coming from the allocator.
+ */
+optics_p optics_create_with(allocator_p a, point_p points, size_t stride, size_t n, const double *weights,
+		double thre, double min_pts);
+
+
+/*
+ * Destroy the ordering, release all memories it uses.
+ */
+void optics_destroy(optics_p optics);
+
+
+/*
+ * Extract the DBSCAN clustering at thre from an ordering of n points,
+ * where thre is no larger than the one the ordering is computed with.
+ *
+ * thre is compared to core_dist and reach as is, so it is squared if they are.
+ * It takes a single pass over the order.
+ *
+ * labels: receives the cluster id of each point, 0 for noise
+ *
+ * NOTE: the core points are clustered exactly as DBSCAN does, but a border
+ * point visited before all of its core points is left as noise.
+ *
+ * Returns: the numbers of clusters.
+ */
+int optics_extract(const unsigned int *order, const double *core_dist, const double *reach,
+		size_t n, double thre, int32_t *labels);
+
+
+#endif /* _OPTICS_H_ */
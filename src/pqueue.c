@@ -0,0 +1,208 @@
+#include "pqueue.h"
+
+#include <stdlib.h>
+
+
+/* position of the items not in the queue */
+#define NOWHERE ((unsigned int) -1)
+
+
+/*
+ * An item of the heap.
+ */
+typedef struct s_pqueue_node
+{
+	double key;
+	unsigned int item;
+}
+pqueue_node_t, *pqueue_node_p;
+
+
+typedef struct s_pqueue
+{
+	allocator_p alloc;
+
+	/* capacity */
+	size_t n;
+
+	/* binary heap of size nodes */
+	pqueue_node_t *heap;
+	size_t size;
+
+	/* where each item is in the heap, NOWHERE if not in the queue */
+	unsigned int *pos;
+}
+pqueue_t;
+
+
+static inline int less(pqueue_node_p a, pqueue_node_p b)
+{
+	return a->key < b->key || (a->key == b->key && a->item < b->item);
+}
+
+
+static inline void place(pqueue_p queue, size_t i, pqueue_node_t node)
+{
+	queue->heap[i] = node;
+	queue->pos[node.item] = (unsigned int) i;
+}
+
+
+static void sift_up(pqueue_p queue, size_t i)
+{
+	pqueue_node_t node = queue->heap[i];
+
+	while (i > 0) {
+		size_t parent = (i - 1) / 2;
+
+		if (!less(&node, &queue->heap[parent])) {
+			break;
+		}
+		place(queue, i, queue->heap[parent]);
+		i = parent;
+	}
+	place(queue, i, node);
+}
+
+
+static void sift_down(pqueue_p queue, size_t i)
+{
+	pqueue_node_t node = queue->heap[i];
+	size_t size = queue->size;
+
+	for (;;) {
+		size_t child = i * 2 + 1;
+
+		if (child >= size) {
+			break;
+		}
+		if (child + 1 < size && less(&queue->heap[child + 1], &queue->heap[child])) {
+			++child;
+		}
+		if (!less(&queue->heap[child], &node)) {
+			break;
+		}
+		place(queue, i, queue->heap[child]);
+		i = child;
+	}
+	place(queue, i, node);
+}
+
+
+pqueue_p pqueue_create(size_t n)
+{
+	return pqueue_create_with(NULL, n);
+}
+
+
+pqueue_p pqueue_create_with(allocator_p a, size_t n)
+{
+	unsigned int i;
+	pqueue_p queue = (pqueue_p) mem_alloc(a, sizeof(pqueue_t));
+
+	if (queue) {
+		queue->alloc = a;
+		queue->n = n;
+		queue->size = 0;
+		queue->heap = (pqueue_node_t *) mem_alloc(a, sizeof(pqueue_node_t) * (n ? n : 1));
+		queue->pos = (unsigned int *) mem_alloc(a, sizeof(unsigned int) * (n ? n : 1));
+		if (!queue->heap || !queue->pos) {
+			pqueue_destroy(queue);
+			return NULL;
+		}
+
+		for (i = 0; i < n; ++i) {
+			queue->pos[i] = NOWHERE;
+		}
+	}
+	return queue;
+}
+
+
+void pqueue_destroy(pqueue_p queue)
+{
+	if (queue) {
+		size_t n = queue->n ? queue->n : 1;
+
+		mem_free(queue->alloc, queue->heap, sizeof(pqueue_node_t) * n);
+		queue->heap = NULL;
+
+		mem_free(queue->alloc, queue->pos, sizeof(unsigned int) * n);
+		queue->pos = NULL;
+
+		mem_free(queue->alloc, queue, sizeof(pqueue_t));
+	}
+}
+
+
+size_t pqueue_size(pqueue_p queue)
+{
+	return queue->size;
+}
+
+
+int pqueue_contains(pqueue_p queue, unsigned int item)
+{
+	return queue->pos[item] != NOWHERE;
+}
+
+
+double pqueue_key(pqueue_p queue, unsigned int item)
+{
+	return queue->heap[queue->pos[item]].key;
+}
+
+
+void pqueue_update(pqueue_p queue, unsigned int item, double key)
+{
+	unsigned int i = queue->pos[item];
+	pqueue_node_t node = { .key = key, .item = item };
+
+	if (i == NOWHERE) {
+		place(queue, queue->size++, node);
+		sift_up(queue, queue->size - 1);
+
+	} else if (less(&node, &queue->heap[i])) {
+		queue->heap[i].key = key;
+		sift_up(queue, i);
+
+	} else {
+		queue->heap[i].key = key;
+		sift_down(queue, i);
+	}
+}
+
+
+int pqueue_pop(pqueue_p queue, unsigned int *item, double *key)
+{
+	pqueue_node_t top;
+
+	if (!queue->size) {
+		return -1;
+	}
+
+	top = queue->heap[0];
+	queue->pos[top.item] = NOWHERE;
+
+	if (--queue->size) {
+		place(queue, 0, queue->heap[queue->size]);
+		sift_down(queue, 0);
+	}
+
+	*item = top.item;
+	if (key) {
+		*key = top.key;
+	}
+	return 0;
+}
+
+
+void pqueue_clear(pqueue_p queue)
+{
+	size_t i;
+
+	for (i = 0; i < queue->size; ++i) {
+		queue->pos[queue->heap[i].item] = NOWHERE;
+	}
+	queue->size = 0;
+}
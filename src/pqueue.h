@@ -0,0 +1,83 @@
+/* Indexed priority queue of the integers in [0, n). */
+
+#ifndef _PQUEUE_H_
+#define _PQUEUE_H_
+
+#include <stdlib.h>
+
+#include "alloc.h"
+
+
+/*
+ * Min-priority queue, keyed by doubles.
+ *
+ * Each item is an index less than the capacity the queue is created with,
+ * so the queue knows where every item is and can change its key in place.
+ */
+typedef struct s_pqueue *pqueue_p;
+
+
+/*
+ * Create a queue for the items in [0, n).
+ *
+ * NOTE: the queue created by this function MUST be destroyed by the caller,
+ * using pqueue_destroy.
+ */
+pqueue_p pqueue_create(size_t n);
+
+
+/*
+ * Same as pqueue_create, with all the memory of the queue coming from the allocator.
+ */
+pqueue_p pqueue_create_with(allocator_p a, size_t n);
+
+
+/*
+ * Destroy the queue, release all memories it uses.
+ */
+void pqueue_destroy(pqueue_p queue);
+
+
+/*
+ * Get the number of items in the queue.
+ */
+size_t pqueue_size(pqueue_p queue);
+
+
+/*
+ * Tell whether the item is in the queue.
+ */
+int pqueue_contains(pqueue_p queue, unsigned int item);
+
+
+/*
+ * Get the key of the item, which MUST be in the queue.
+ */
+double pqueue_key(pqueue_p queue, unsigned int item);
+
+
+/*
+ * Put the item into the queue with the key, or change its key if it is
+ * already in the queue.
+ */
+void pqueue_update(pqueue_p queue, unsigned int item, double key);
+
+
+/*
+ * Take out the item with the smallest key, the smaller item among equal keys.
+ *
+ * key: receives the key of the item, or NULL
+ *
+ * Returns: 0 if succeed;
+ *         -1 if the queue is empty.
+ */
+int pqueue_pop(pqueue_p queue, unsigned int *item, double *key);
+
+
+/*
+ * Take out all the items.
+ */
+void pqueue_clear(pqueue_p queue);
+
+
+#endif /* _PQUEUE_H_ */
@@ -0,0 +1,543 @@
+#include "rho.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "batch.h"
+#include "unionfind.h"
+
+
+#define POINT(points, stride, i) ((point_p) ((char *) (points) + (stride) * (i)))
+
+/* an empty slot of the table, or no cell at all */
+#define NO_CELL UINT32_MAX
+
+/* cells the grid starts at, so that the cells around any cell have unsigned coordinates */
+#define MARGIN 2
+
+/* most boxes across a cell, a finer rho clustering exactly */
+#define BOXES_MAX 4096
+
+/* 1 / sqrt(2), as M_SQRT1_2 is not C99 */
+#define SQRT1_2 0.70710678118654752440
+
+
+/*
+ * A non-empty cell of the grid.
+ */
+typedef struct s_cell
+{
+	/* x of the cell in the high 32 bits, y in the low ones */
+	uint64_t key;
+
+	/* its points are order[begin, end) */
+	unsigned int begin;
+	unsigned int end;
+
+	/* the boxes of its core points are [box, box_end) */
+	unsigned int box;
+	unsigned int box_end;
+
+	/* the cluster id of its core points, 0 if it has none */
+	int32_t id;
+}
+cell_t, *cell_p;
+
+
+/*
+ * The points in the grid, sorted by cell.
+ */
+typedef struct s_grid
+{
+	double side;
+	double x0;
+	double y0;
+	double thre;
+
+	cell_t *cells;
+	size_t n_cells;
+	size_t cells_n;
+
+	/* the cells by key, open addressing, of a power of 2 slots */
+	unsigned int *table;
+	size_t table_n;
+
+	/* the source index and the coordinates of each point, cell by cell */
+	unsigned int *order;
+	double *xs;
+	double *ys;
+	unsigned char *core;
+
+	/* the boxes of the core points, rect i being x_lower[i] to x_upper[i] by y_lower[i] to y_upper[i] */
+	double *x_lower;
+	double *x_upper;
+	double *y_lower;
+	double *y_upper;
+	size_t n_boxes;
+
+	/* scratch, for the points of a cell */
+	unsigned int *found;
+	double *dist;
+	uint64_t *keys;
+}
+grid_t, *grid_p;
+
+
+static inline unsigned int slot_of(uint64_t key, size_t table_n)
+{
+	return (unsigned int) ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (unsigned int) (table_n - 1);
+}
+
+
+static inline unsigned int find_cell(grid_p grid, uint64_t key)
+{
+	unsigned int s = slot_of(key, grid->table_n);
+
+	while (grid->table[s] != NO_CELL && grid->cells[grid->table[s]].key != key) {
+		s = (s + 1) & (unsigned int) (grid->table_n - 1);
+	}
+	return grid->table[s];
+}
+
+
+/*
+ * Get the cell of the key, adding it if there is none.
+ *
+ * Returns: the index of the cell if succeed;
+ *          NO_CELL if failed.
+ */
+static unsigned int add_cell(grid_p grid, uint64_t key)
+{
+	unsigned int i, s;
+
+	/* keep the table at most half full */
+	if ((grid->n_cells + 1) * 2 > grid->table_n) {
+		size_t table_n = grid->table_n ? grid->table_n * 2 : 1024;
+		unsigned int *table = (unsigned int *) malloc(sizeof(unsigned int) * table_n);
+
+		if (!table) {
+			return NO_CELL;
+		}
+		memset(table, 0xff, sizeof(unsigned int) * table_n);
+		for (i = 0; i < grid->n_cells; ++i) {
+			s = slot_of(grid->cells[i].key, table_n);
+			while (table[s] != NO_CELL) {
+				s = (s + 1) & (unsigned int) (table_n - 1);
+			}
+			table[s] = i;
+		}
+		free(grid->table);
+		grid->table = table;
+		grid->table_n = table_n;
+	}
+
+	s = slot_of(key, grid->table_n);
+	while (grid->table[s] != NO_CELL) {
+		if (grid->cells[grid->table[s]].key == key) {
+			return grid->table[s];
+		}
+		s = (s + 1) & (unsigned int) (grid->table_n - 1);
+	}
+
+	if (grid->n_cells == grid->cells_n) {
+		size_t cells_n = grid->cells_n ? grid->cells_n * 2 : 512;
+		cell_t *cells = (cell_t *) realloc(grid->cells, sizeof(cell_t) * cells_n);
+
+		if (!cells) {
+			return NO_CELL;
+		}
+		grid->cells = cells;
+		grid->cells_n = cells_n;
+	}
+
+	i = (unsigned int) grid->n_cells++;
+	memset(&grid->cells[i], 0, sizeof(cell_t));
+	grid->cells[i].key = key;
+	grid->table[s] = i;
+	return i;
+}
+
+
+/*
+ * Find the cells around the cell, itself included.
+ *
+ * around: receives the cells, MUST have space for 25 items
+ *
+ * Returns: the number of the cells.
+ */
+static size_t cells_around(grid_p grid, cell_p cell, unsigned int *around)
+{
+	uint64_t cx = cell->key >> 32, cy = cell->key & 0xffffffffULL;
+	uint64_t x, y;
+	size_t n = 0;
+
+	for (x = cx - 2; x <= cx + 2; ++x) {
+		for (y = cy - 2; y <= cy + 2; ++y) {
+			unsigned int c = find_cell(grid, x << 32 | y);
+			if (c != NO_CELL) {
+				around[n++] = c;
+			}
+		}
+	}
+	return n;
+}
+
+
+/*
+ * Get the total weight of the points of the cell within thre from the point.
+ */
+static double weight_within(grid_p grid, cell_p cell, point_p point, const double *weights)
+{
+	unsigned int i;
+	size_t n = batch_within(grid->xs + cell->begin, grid->ys + cell->begin,
+			cell->end - cell->begin, point, grid->thre, grid->found);
+	double total = 0.0;
+
+	if (!weights) {
+		return (double) n;
+	}
+	for (i = 0; i < n; ++i) {
+		total += weights[grid->order[cell->begin + grid->found[i]]];
+	}
+	return total;
+}
+
+
+static int cmp_key(const void *p1, const void *p2)
+{
+	uint64_t k1 = *(const uint64_t *) p1, k2 = *(const uint64_t *) p2;
+
+	return (k1 > k2) - (k1 < k2);
+}
+
+
+/*
+ * Group the core points of the cell into boxes of side / k wide, or a box
+ * for each of them with k 0, and append the bounding boxes of the groups.
+ */
+static void add_boxes(grid_p grid, cell_p cell, unsigned int k)
+{
+	unsigned int i, m = 0;
+	double ox = grid->x0 + (double) ((cell->key >> 32) - MARGIN) * grid->side;
+	double oy = grid->y0 + (double) ((cell->key & 0xffffffffULL) - MARGIN) * grid->side;
+	double box = k ? grid->side / k : 0.0;
+
+	/* the box of each core point in the high 32 bits, its place in the low ones */
+	for (i = cell->begin; i < cell->end; ++i) {
+		uint64_t b = m;
+
+		if (!grid->core[i]) {
+			continue;
+		}
+		if (k) {
+			double fx = (grid->xs[i] - ox) / box, fy = (grid->ys[i] - oy) / box;
+			uint64_t bx = fx <= 0 ? 0 : fx >= k ? k - 1 : (uint64_t) fx;
+			uint64_t by = fy <= 0 ? 0 : fy >= k ? k - 1 : (uint64_t) fy;
+			b = by * k + bx;
+		}
+		grid->keys[m++] = b << 32 | i;
+	}
+	if (k) {
+		qsort(grid->keys, m, sizeof(uint64_t), cmp_key);
+	}
+
+	cell->box = (unsigned int) grid->n_boxes;
+	for (i = 0; i < m; ++i) {
+		unsigned int p = (unsigned int) (grid->keys[i] & 0xffffffffULL);
+		size_t b = grid->n_boxes;
+
+		if (i && grid->keys[i] >> 32 == grid->keys[i - 1] >> 32) {
+			--b;
+			grid->x_lower[b] = grid->xs[p] < grid->x_lower[b] ? grid->xs[p] : grid->x_lower[b];
+			grid->x_upper[b] = grid->xs[p] > grid->x_upper[b] ? grid->xs[p] : grid->x_upper[b];
+			grid->y_lower[b] = grid->ys[p] < grid->y_lower[b] ? grid->ys[p] : grid->y_lower[b];
+			grid->y_upper[b] = grid->ys[p] > grid->y_upper[b] ? grid->ys[p] : grid->y_upper[b];
+		} else {
+			grid->x_lower[b] = grid->x_upper[b] = grid->xs[p];
+			grid->y_lower[b] = grid->y_upper[b] = grid->ys[p];
+			++grid->n_boxes;
+		}
+	}
+	cell->box_end = (unsigned int) grid->n_boxes;
+}
+
+
+/*
+ * Tell whether a core point of cell a is within thre of a box of cell b.
+ */
+static int joined(grid_p grid, cell_p a, cell_p b)
+{
+	unsigned int i, j;
+	size_t m = b->box_end - b->box;
+
+	for (i = a->begin; i < a->end; ++i) {
+		point_t point;
+
+		if (!grid->core[i]) {
+			continue;
+		}
+		point.x = grid->xs[i];
+		point.y = grid->ys[i];
+		batch_rect_min_dist(grid->x_lower + b->box, grid->x_upper + b->box,
+				grid->y_lower + b->box, grid->y_upper + b->box, m, &point, grid->dist);
+		for (j = 0; j < m; ++j) {
+			if (grid->dist[j] <= grid->thre) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+int rho_cluster(point_p points, size_t stride, size_t n, const double *weights,
+		double eps, double min_pts, double rho, int32_t *labels, unsigned char *core)
+{
+	unsigned int i, j, c, k = 0;
+	size_t max_count = 0;
+	double x1, y1;
+	int32_t next_id = 0;
+	grid_t grid;
+	unsigned int *cell_of = NULL;
+	unionfind_p uf = NULL;
+
+#define FREEALL()\
+	{\
+		free(grid.cells); grid.cells = NULL;\
+		free(grid.table); grid.table = NULL;\
+		free(grid.order); grid.order = NULL;\
+		free(grid.xs); grid.xs = NULL;\
+		free(grid.ys); grid.ys = NULL;\
+		free(grid.core); grid.core = NULL;\
+		free(grid.x_lower); grid.x_lower = NULL;\
+		free(grid.x_upper); grid.x_upper = NULL;\
+		free(grid.y_lower); grid.y_lower = NULL;\
+		free(grid.y_upper); grid.y_upper = NULL;\
+		free(grid.found); grid.found = NULL;\
+		free(grid.dist); grid.dist = NULL;\
+		free(grid.keys); grid.keys = NULL;\
+		free(cell_of); cell_of = NULL;\
+		unionfind_destroy(uf); uf = NULL;\
+	}
+
+	memset(&grid, 0, sizeof(grid_t));
+	if (!n) {
+		return 0;
+	}
+	if (n >= NO_CELL) {
+		return -1;
+	}
+
+	/* a cell is eps across its diagonal */
+	grid.side = eps * SQRT1_2;
+	grid.thre = eps * eps;
+	grid.x0 = x1 = POINT(points, stride, 0)->x;
+	grid.y0 = y1 = POINT(points, stride, 0)->y;
+	for (i = 1; i < n; ++i) {
+		point_p p = POINT(points, stride, i);
+
+		grid.x0 = p->x < grid.x0 ? p->x : grid.x0;
+		grid.y0 = p->y < grid.y0 ? p->y : grid.y0;
+		x1 = p->x > x1 ? p->x : x1;
+		y1 = p->y > y1 ? p->y : y1;
+	}
+	if (!(grid.side > 0) || (x1 - grid.x0) / grid.side + 2 * MARGIN + 1 >= 4294967296.0
+			|| (y1 - grid.y0) / grid.side + 2 * MARGIN + 1 >= 4294967296.0) {
+		return -1;
+	}
+
+	/* boxes no more than rho * eps across, as a cell is eps across */
+	if (rho > 0 && 1.0 / rho <= BOXES_MAX) {
+		k = (unsigned int) ceil(1.0 / rho);
+	}
+
+	/* find the cell of each point, counting the points of each cell into end */
+	cell_of = (unsigned int *) malloc(sizeof(unsigned int) * n);
+	if (!cell_of) {
+		return -1;
+	}
+	for (i = 0; i < n; ++i) {
+		point_p p = POINT(points, stride, i);
+		uint64_t cx = (uint64_t) ((p->x - grid.x0) / grid.side) + MARGIN;
+		uint64_t cy = (uint64_t) ((p->y - grid.y0) / grid.side) + MARGIN;
+
+		c = add_cell(&grid, cx << 32 | cy);
+		if (c == NO_CELL) {
+			FREEALL();
+			return -1;
+		}
+		cell_of[i] = c;
+		++grid.cells[c].end;
+	}
+
+	/* then, sort the points by cell */
+	grid.order = (unsigned int *) malloc(sizeof(unsigned int) * n);
+	grid.xs = (double *) malloc(sizeof(double) * n);
+	grid.ys = (double *) malloc(sizeof(double) * n);
+	grid.core = (unsigned char *) calloc(n, 1);
+	if (!grid.order || !grid.xs || !grid.ys || !grid.core) {
+		FREEALL();
+		return -1;
+	}
+	for (c = 0, j = 0; c < grid.n_cells; ++c) {
+		unsigned int count = grid.cells[c].end;
+
+		max_count = count > max_count ? count : max_count;
+		grid.cells[c].begin = grid.cells[c].end = j;
+		j += count;
+	}
+	for (i = 0; i < n; ++i) {
+		point_p p = POINT(points, stride, i);
+		unsigned int at = grid.cells[cell_of[i]].end++;
+
+		grid.order[at] = i;
+		grid.xs[at] = p->x;
+		grid.ys[at] = p->y;
+	}
+	free(cell_of);
+	cell_of = NULL;
+
+	grid.found = (unsigned int *) malloc(sizeof(unsigned int) * max_count);
+	grid.dist = (double *) malloc(sizeof(double) * max_count);
+	grid.keys = (uint64_t *) malloc(sizeof(uint64_t) * max_count);
+	if (!grid.found || !grid.dist || !grid.keys) {
+		FREEALL();
+		return -1;
+	}
+
+	/*
+	 * find the core points: all the points of a cell are within eps of each
+	 * other, so they are all core points if the cell holds min_pts
+	 */
+	for (c = 0; c < grid.n_cells; ++c) {
+		cell_p cell = &grid.cells[c];
+		unsigned int around[25];
+		size_t n_around = 0;
+		double total = 0.0;
+
+		for (i = cell->begin; i < cell->end; ++i) {
+			total += weights ? weights[grid.order[i]] : 1.0;
+		}
+		if (total >= min_pts) {
+			memset(grid.core + cell->begin, 1, cell->end - cell->begin);
+			continue;
+		}
+
+		n_around = cells_around(&grid, cell, around);
+		for (i = cell->begin; i < cell->end; ++i) {
+			double sum = total;
+			point_t point;
+
+			point.x = grid.xs[i];
+			point.y = grid.ys[i];
+			for (j = 0; j < n_around && sum < min_pts; ++j) {
+				if (around[j] != c) {
+					sum += weight_within(&grid, &grid.cells[around[j]], &point, weights);
+				}
+			}
+			grid.core[i] = sum >= min_pts;
+		}
+	}
+
+	/* group the core points of each cell into boxes */
+	grid.x_lower = (double *) malloc(sizeof(double) * n);
+	grid.x_upper = (double *) malloc(sizeof(double) * n);
+	grid.y_lower = (double *) malloc(sizeof(double) * n);
+	grid.y_upper = (double *) malloc(sizeof(double) * n);
+	uf = unionfind_create(grid.n_cells);
+	if (!grid.x_lower || !grid.x_upper || !grid.y_lower || !grid.y_upper || !uf) {
+		FREEALL();
+		return -1;
+	}
+	for (c = 0; c < grid.n_cells; ++c) {
+		add_boxes(&grid, &grid.cells[c], k);
+	}
+
+	/* join the cells with core points, each pair of them once */
+	for (c = 0; c < grid.n_cells; ++c) {
+		cell_p cell = &grid.cells[c];
+		unsigned int around[25];
+		size_t n_around = 0;
+
+		if (cell->box == cell->box_end) {
+			continue;
+		}
+
+		n_around = cells_around(&grid, cell, around);
+		for (j = 0; j < n_around; ++j) {
+			cell_p other = &grid.cells[around[j]];
+
+			if (around[j] <= c || other->box == other->box_end
+					|| unionfind_find(uf, c) == unionfind_find(uf, around[j])) {
+				continue;
+			}
+			/* the core points of one cell against the fewer boxes of the other */
+			if (other->box_end - other->box < cell->box_end - cell->box
+					? joined(&grid, cell, other) : joined(&grid, other, cell)) {
+				unionfind_union(uf, c, around[j]);
+			}
+		}
+	}
+
+	/* number the clusters, the representative of a set being its first cell */
+	for (c = 0; c < grid.n_cells; ++c) {
+		cell_p cell = &grid.cells[c];
+		unsigned int r = unionfind_find(uf, c);
+
+		if (cell->box != cell->box_end) {
+			cell->id = r == c ? ++next_id : grid.cells[r].id;
+		}
+	}
+
+	/* label the points, a border point joining the smallest cluster id within eps */
+	for (c = 0; c < grid.n_cells; ++c) {
+		cell_p cell = &grid.cells[c];
+		unsigned int around[25];
+		size_t n_around = 0;
+
+		for (i = cell->begin; i < cell->end; ++i) {
+			int32_t id = 0;
+			point_t point;
+
+			if (core) {
+				core[grid.order[i]] = grid.core[i];
+			}
+			if (grid.core[i]) {
+				labels[grid.order[i]] = cell->id;
+				continue;
+			}
+
+			if (!n_around) {
+				n_around = cells_around(&grid, cell, around);
+			}
+			point.x = grid.xs[i];
+			point.y = grid.ys[i];
+			for (j = 0; j < n_around; ++j) {
+				cell_p other = &grid.cells[around[j]];
+				unsigned int q;
+
+				if (!other->id || (id && other->id >= id)) {
+					continue;
+				}
+				for (q = other->begin; q < other->end; ++q) {
+					point_t p;
+
+					p.x = grid.xs[q];
+					p.y = grid.ys[q];
+					if (grid.core[q] && point_dist(&point, &p) <= grid.thre) {
+						id = other->id;
+						break;
+					}
+				}
+			}
+			labels[grid.order[i]] = id;
+		}
+	}
+
+	FREEALL();
+	return (int) next_id;
+
+#undef FREEALL
+
+}
@@ -0,0 +1,49 @@
+/* rho-approximate DBSCAN of 2D points over a grid. */
+
+#ifndef _RHO_H_
+#define _RHO_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "geo.h"
+
+
+/*
+ * Cluster the points by rho-approximate DBSCAN, in expected linear time.
+ *
+ * Point i is at (char *) points + stride * i. The space is divided into a
+ * grid of cells eps wide across their diagonal, so that the points of a cell
+ * are all within eps of each other, and the neighbours of a point are in the
+ * 5 x 5 cells around its own. The core points are found exactly, and two
+ * cells with core points are in the same cluster:
+ * - if any two of their core points are within eps;
+ * - never if none are within eps * (1 + rho).
+ * Between the two, the core points of each cell are grouped into boxes no
+ * more than rho * eps across, and the cells are joined if a core point of
+ * one is within eps of a box of the other.
+ *
+ * So the clusters are unions of the clusters of DBSCAN at eps, and each is
+ * within a cluster of DBSCAN at eps * (1 + rho).
+ *
+ * ref: DBSCAN Revisited: Mis-Claim, Un-Fixability, and Approximation
+ *      Junhao Gan, Yufei Tao
+ *
+ * eps: radius of the neighbourhood, not squared
+ * weights: weight of each point for the min_pts test, NULL for all 1
+ * rho: the approximation, 0 to cluster exactly as DBSCAN does
+ * labels: receives the cluster id of each point, 0 for noise
+ * core: receives 1 for each core point, 0 for the others, or NULL
+ *
+ * A border point joins the cluster with the smallest id among the ones of the
+ * core points within eps of it. The clusters are numbered in the order their
+ * first cells are met in the points.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed, or the grid would be wider than 2^32 cells.
+ */
+int rho_cluster(point_p points, size_t stride, size_t n, const double *weights,
+		double eps, double min_pts, double rho, int32_t *labels, unsigned char *core);
+
+
+#endif /* _RHO_H_ */
@@ -0,0 +1,148 @@
+#include "sfc.h"
+
+#include <stdlib.h>
+
+
+/*
+ * A point's position on the curve, with its index in the input.
+ */
+typedef struct s_sfc_key
+{
+	unsigned long long code;
+	unsigned int index;
+}
+sfc_key_t, *sfc_key_p;
+
+
+static inline unsigned int quantize(interval_p itv, double p)
+{
+	double w = itv->upper - itv->lower;
+
+	if (!(w > 0.0) || p <= itv->lower) {
+		return 0;
+	}
+	if (p >= itv->upper) {
+		return 0xffffffffu;
+	}
+	return (unsigned int) ((p - itv->lower) / w * 4294967295.0);
+}
+
+
+/*
+ * Spread the 32 bits of v to the even bits of the result.
+ */
+static inline unsigned long long spread_bits(unsigned int v)
+{
+	unsigned long long x = v;
+
+	x = (x | (x << 16)) & 0x0000ffff0000ffffULL;
+	x = (x | (x << 8)) & 0x00ff00ff00ff00ffULL;
+	x = (x | (x << 4)) & 0x0f0f0f0f0f0f0f0fULL;
+	x = (x | (x << 2)) & 0x3333333333333333ULL;
+	x = (x | (x << 1)) & 0x5555555555555555ULL;
+	return x;
+}
+
+
+static unsigned long long morton_code(unsigned int x, unsigned int y)
+{
+	return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+
+/*
+ * refs: Hilbert curve, xy2d
+ *       https://en.wikipedia.org/wiki/Hilbert_curve
+ */
+static unsigned long long hilbert_code(unsigned int x, unsigned int y)
+{
+	unsigned long long d = 0;
+	unsigned int s, rx, ry, t;
+
+	for (s = 1u << 31; s > 0; s >>= 1) {
+		rx = (x & s) > 0;
+		ry = (y & s) > 0;
+		d += (unsigned long long) s * s * ((3 * rx) ^ ry);
+
+		if (!ry) {
+			if (rx) {
+				x = ~x;
+				y = ~y;
+			}
+			t = x;
+			x = y;
+			y = t;
+		}
+	}
+	return d;
+}
+
+
+unsigned long long sfc_code(rect_p rect, point_p point, sfc_curve_t curve)
+{
+	unsigned int x = quantize(&rect->x_itv, point->x);
+	unsigned int y = quantize(&rect->y_itv, point->y);
+
+	return curve == SFC_HILBERT ? hilbert_code(x, y) : morton_code(x, y);
+}
+
+
+static int cmp_key(const void *a, const void *b)
+{
+	unsigned long long ca = ((sfc_key_p) a)->code;
+	unsigned long long cb = ((sfc_key_p) b)->code;
+
+	if (ca != cb) {
+		return ca < cb ? -1 : 1;
+	}
+	/* keep the input order of points on the same cell */
+	return (((sfc_key_p) a)->index > ((sfc_key_p) b)->index)
+		- (((sfc_key_p) a)->index < ((sfc_key_p) b)->index);
+}
+
+
+void sfc_order_with(point_p *points, size_t n, sfc_curve_t curve, unsigned int *perm, void *scratch)
+{
+	unsigned int i;
+	rect_t rect;
+	sfc_key_t *keys = (sfc_key_t *) scratch;
+
+	if (!n) {
+		return;
+	}
+
+	rect_init_point(&rect, points[0]);
+	for (i = 1; i < n; ++i) {
+		rect_enlarge_to(&rect, points[i]);
+	}
+
+	for (i = 0; i < n; ++i) {
+		keys[i].code = sfc_code(&rect, points[i], curve);
+		keys[i].index = i;
+	}
+	qsort(keys, n, sizeof(sfc_key_t), cmp_key);
+
+	for (i = 0; i < n; ++i) {
+		perm[i] = keys[i].index;
+	}
+}
+
+
+int sfc_order(point_p *points, size_t n, sfc_curve_t curve, unsigned int *perm)
+{
+	void *scratch = NULL;
+
+	if (!n) {
+		return 0;
+	}
+
+	scratch = malloc(SFC_SCRATCH_SIZE(n));
+	if (!scratch) {
+		return -1;
+	}
+
+	sfc_order_with(points, n, curve, perm, scratch);
+
+	free(scratch);
+	return 0;
+}
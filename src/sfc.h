@@ -0,0 +1,58 @@
+/* Space-filling curves over 2D points. */
+
+#ifndef _SFC_H_
+#define _SFC_H_
+
+#include <stdlib.h>
+
+#include "geo.h"
+
+
+/*
+ * Supported curves.
+ */
+typedef enum e_sfc_curve
+{
+	SFC_MORTON = 0,
+	SFC_HILBERT = 1
+}
+sfc_curve_t;
+
+
+/*
+ * Calculate the position of the point on the curve.
+ *
+ * The rect is quantized into a 2^32 x 2^32 grid, so the point is expected
+ * to be contained in the rect.
+ */
+unsigned long long sfc_code(rect_p rect, point_p point, sfc_curve_t curve);
+
+
+/*
+ * Order the points along the curve spanning their bounding rect.
+ *
+ * perm is filled with the indexes of the points in curve order, i.e.
+ * points[perm[0]], points[perm[1]], ... are adjacent on the curve.
+ *
+ * NOTE: perm MUST have space for n items.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int sfc_order(point_p *points, size_t n, sfc_curve_t curve, unsigned int *perm);
+
+
+/*
+ * Bytes of scratch space sfc_order_with needs for n points.
+ */
+#define SFC_SCRATCH_SIZE(n) ((n) * 2 * sizeof(unsigned long long))
+
+
+/*
+ * Same as sfc_order, but work in the scratch space given by the caller,
+ * which MUST have SFC_SCRATCH_SIZE(n) bytes, instead of allocating.
+ */
+void sfc_order_with(point_p *points, size_t n, sfc_curve_t curve, unsigned int *perm, void *scratch);
+
+
+#endif /* _SFC_H_ */
@@ -0,0 +1,519 @@
+#include "strip.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "batch.h"
+#include "unionfind.h"
+
+
+/* an empty slot of the table, or no band at all */
+#define NO_BAND UINT32_MAX
+
+/* a point with no core point joined to it yet */
+#define NO_LINK UINT32_MAX
+
+/* bands are a hair wider than eps, so that rounding never puts two neighbours two bands apart */
+#define BAND_SLACK (1.0 + 1.0 / (1 << 20))
+
+/* the bands are at most this far from the origin, so that their keys fit */
+#define BANDS_MAX 4611686018427387904.0 // 2^62
+
+/* the points a band or the window starts with */
+#define POINTS_MIN 64
+
+
+/*
+ * The points of the strip in a band of y, in x order.
+ */
+typedef struct s_band
+{
+	/* the band is [key * side, (key + 1) * side) in y */
+	int64_t key;
+
+	/* its points are [head, end) of each array, of n items */
+	double *xs;
+	double *ys;
+	double *weights;
+	unsigned int *index;
+	size_t head;
+	size_t end;
+	size_t n;
+}
+band_t, *band_p;
+
+
+/*
+ * A point of the strip.
+ */
+typedef struct s_entry
+{
+	point_t point;
+	unsigned int band;
+}
+entry_t, *entry_p;
+
+
+typedef struct s_strip
+{
+	allocator_p alloc;
+
+	double thre;
+	double side;
+	double min_pts;
+
+	band_t *bands;
+	size_t n_bands;
+	size_t bands_n;
+
+	/* the bands with arrays, the ones of an earlier sweep being kept for the next */
+	size_t n_kept;
+
+	/* the bands by key, open addressing, of a power of 2 slots */
+	unsigned int *table;
+	size_t table_n;
+
+	/* point first + i is window[head + i], up to the last one pushed */
+	entry_t *window;
+	size_t head;
+	size_t end;
+	size_t window_n;
+
+	/* the points [0, first) are out of the strip, and [0, n_final) finalized */
+	size_t first;
+	size_t n_final;
+	size_t size;
+	double last_x;
+
+	/* the core points joined so far */
+	unionfind_p uf;
+
+	/*
+	 * of each point: whether it's a core point, and the first core point
+	 * within eps of the others, the cluster id of each once finished
+	 */
+	unsigned char *core;
+	unsigned int *link;
+	size_t points_n;
+
+	/* scratch, for the points found in a band, and the neighbours finalized before a point */
+	unsigned int *found;
+	size_t found_n;
+	unsigned int *before;
+	size_t before_n;
+
+	int finished;
+	int n_clusters;
+}
+strip_t;
+
+
+/*
+ * Make the buffer of *n items of size bytes hold at least need items.
+ */
+static int reserve(allocator_p a, void **buf, size_t *n, size_t need, size_t size)
+{
+	size_t new_n;
+	void *p;
+
+	if (need <= *n) {
+		return 0;
+	}
+	new_n = *n * 2 > need ? *n * 2 : need;
+	new_n = new_n < POINTS_MIN ? POINTS_MIN : new_n;
+	p = mem_realloc(a, *buf, size * *n, size * new_n);
+	if (!p) {
+		return -1;
+	}
+	*buf = p;
+	*n = new_n;
+	return 0;
+}
+
+
+static inline unsigned int slot_of(int64_t key, size_t table_n)
+{
+	return (unsigned int) (((uint64_t) key * 0x9e3779b97f4a7c15ULL) >> 32) & (unsigned int) (table_n - 1);
+}
+
+
+static inline unsigned int find_band(strip_p strip, int64_t key)
+{
+	unsigned int s = slot_of(key, strip->table_n);
+
+	while (strip->table[s] != NO_BAND && strip->bands[strip->table[s]].key != key) {
+		s = (s + 1) & (unsigned int) (strip->table_n - 1);
+	}
+	return strip->table[s];
+}
+
+
+/*
+ * Get the band of the key, adding it if there is none.
+ *
+ * Returns: the index of the band if succeed;
+ *          NO_BAND if failed.
+ */
+static unsigned int add_band(strip_p strip, int64_t key)
+{
+	unsigned int i, s;
+
+	/* keep the table at most half full */
+	if ((strip->n_bands + 1) * 2 > strip->table_n) {
+		size_t table_n = strip->table_n ? strip->table_n * 2 : 256;
+		unsigned int *table = (unsigned int *) mem_alloc(strip->alloc, sizeof(unsigned int) * table_n);
+
+		if (!table) {
+			return NO_BAND;
+		}
+		memset(table, 0xff, sizeof(unsigned int) * table_n);
+		for (i = 0; i < strip->n_bands; ++i) {
+			s = slot_of(strip->bands[i].key, table_n);
+			while (table[s] != NO_BAND) {
+				s = (s + 1) & (unsigned int) (table_n - 1);
+			}
+			table[s] = i;
+		}
+		mem_free(strip->alloc, strip->table, sizeof(unsigned int) * strip->table_n);
+		strip->table = table;
+		strip->table_n = table_n;
+	}
+
+	s = slot_of(key, strip->table_n);
+	while (strip->table[s] != NO_BAND) {
+		if (strip->bands[strip->table[s]].key == key) {
+			return strip->table[s];
+		}
+		s = (s + 1) & (unsigned int) (strip->table_n - 1);
+	}
+
+	if (reserve(strip->alloc, (void **) &strip->bands, &strip->bands_n, strip->n_bands + 1, sizeof(band_t))) {
+		return NO_BAND;
+	}
+
+	i = (unsigned int) strip->n_bands++;
+	if (i < strip->n_kept) {
+		strip->bands[i].head = strip->bands[i].end = 0;
+	} else {
+		memset(&strip->bands[i], 0, sizeof(band_t));
+		strip->n_kept = i + 1;
+	}
+	strip->bands[i].key = key;
+	strip->table[s] = i;
+	return i;
+}
+
+
+/*
+ * Append the point to the band, growing it to twice its points, and moving
+ * them down once they reach its end. So its size depends on the most points
+ * it ever held only, and a band as full as before never grows.
+ */
+static int band_push(allocator_p a, band_p band, point_p point, double weight, unsigned int index)
+{
+	size_t m = band->end - band->head;
+
+	if ((m + 1) * 2 > band->n) {
+		size_t n = band->n, xs_n = n, ys_n = n, weights_n = n;
+
+		if (reserve(a, (void **) &band->xs, &xs_n, (m + 1) * 2, sizeof(double))
+				|| reserve(a, (void **) &band->ys, &ys_n, (m + 1) * 2, sizeof(double))
+				|| reserve(a, (void **) &band->weights, &weights_n, (m + 1) * 2, sizeof(double))
+				|| reserve(a, (void **) &band->index, &band->n, (m + 1) * 2, sizeof(unsigned int))) {
+			return -1;
+		}
+	}
+
+	/* at most half of it is the points left, so moving them costs no more than the ones dropped */
+	if (band->end == band->n) {
+		memmove(band->xs, band->xs + band->head, sizeof(double) * m);
+		memmove(band->ys, band->ys + band->head, sizeof(double) * m);
+		memmove(band->weights, band->weights + band->head, sizeof(double) * m);
+		memmove(band->index, band->index + band->head, sizeof(unsigned int) * m);
+		band->head = 0;
+		band->end = m;
+	}
+
+	band->xs[band->end] = point->x;
+	band->ys[band->end] = point->y;
+	band->weights[band->end] = weight;
+	band->index[band->end] = index;
+	band->end++;
+	return 0;
+}
+
+
+/*
+ * Finalize the next point, all the points within eps of it being in the strip.
+ */
+static int finalize(strip_p strip)
+{
+	unsigned int i, g = (unsigned int) strip->n_final;
+	size_t m = 0;
+	entry_p e = &strip->window[strip->head + (g - strip->first)];
+	point_t point = e->point;
+	int64_t key, band_key = strip->bands[e->band].key;
+	double total = 0.0;
+	int core;
+
+	/* drop the points left more than eps behind, the first ones of their bands */
+	while (strip->first < g) {
+		entry_p t = &strip->window[strip->head];
+		band_p band = &strip->bands[t->band];
+		double dx = point.x - t->point.x;
+
+		if (dx * dx <= strip->thre) {
+			break;
+		}
+		if (++band->head == band->end) {
+			band->head = band->end = 0;
+		}
+		strip->head++;
+		strip->first++;
+	}
+
+	if (reserve(strip->alloc, (void **) &strip->before, &strip->before_n, strip->end - strip->head,
+			sizeof(unsigned int))) {
+		return -1;
+	}
+
+	/* the strip being within eps in x, the neighbours are the points within eps of the 3 bands around */
+	for (key = band_key - 1; key <= band_key + 1; ++key) {
+		unsigned int b = find_band(strip, key);
+		band_p band;
+		size_t n;
+
+		if (b == NO_BAND) {
+			continue;
+		}
+		band = &strip->bands[b];
+		if (reserve(strip->alloc, (void **) &strip->found, &strip->found_n, band->end - band->head, sizeof(unsigned int))) {
+			return -1;
+		}
+
+		n = batch_within(band->xs + band->head, band->ys + band->head, band->end - band->head,
+				&point, strip->thre, strip->found);
+		for (i = 0; i < n; ++i) {
+			size_t j = band->head + strip->found[i];
+
+			total += band->weights[j];
+			if (band->index[j] < g) {
+				strip->before[m++] = band->index[j];
+			}
+		}
+	}
+
+	/*
+	 * join the point to the neighbours finalized before it, the ones after it
+	 * joining it when they are finalized: the core points are unioned, and the
+	 * others linked to their first core point
+	 */
+	core = total >= strip->min_pts;
+	strip->core[g] = (unsigned char) core;
+	for (i = 0; i < m; ++i) {
+		unsigned int j = strip->before[i];
+
+		if (core && strip->core[j]) {
+			unionfind_union(strip->uf, g, j);
+		} else if (core) {
+			if (strip->link[j] == NO_LINK) {
+				strip->link[j] = g;
+			}
+		} else if (strip->core[j] && j < strip->link[g]) {
+			strip->link[g] = j;
+		}
+	}
+
+	strip->n_final++;
+	return 0;
+}
+
+
+strip_p strip_create(double thre, double min_pts)
+{
+	return strip_create_with(NULL, thre, min_pts);
+}
+
+
+strip_p strip_create_with(allocator_p a, double thre, double min_pts)
+{
+	strip_p strip = (strip_p) mem_calloc(a, 1, sizeof(strip_t));
+	if (strip) {
+		strip->alloc = a;
+		strip->uf = unionfind_create_with(a, 0);
+		if (!strip->uf) {
+			strip_destroy(strip);
+			return NULL;
+		}
+
+		strip_reset(strip, thre, min_pts);
+	}
+	return strip;
+}
+
+
+void strip_reset(strip_p strip, double thre, double min_pts)
+{
+	double eps = sqrt(thre);
+
+	strip->thre = thre;
+	strip->side = eps > 0.0 ? eps * BAND_SLACK : 1.0;
+	strip->min_pts = min_pts;
+
+	strip->n_bands = 0;
+	if (strip->table) {
+		memset(strip->table, 0xff, sizeof(unsigned int) * strip->table_n);
+	}
+	strip->head = 0;
+	strip->end = 0;
+	strip->first = 0;
+	strip->n_final = 0;
+	strip->size = 0;
+	strip->last_x = -INFINITY;
+	unionfind_clear(strip->uf);
+
+	strip->finished = 0;
+	strip->n_clusters = 0;
+}
+
+
+void strip_destroy(strip_p strip)
+{
+	size_t i;
+
+	if (strip) {
+		allocator_p a = strip->alloc;
+
+		for (i = 0; i < strip->n_kept; ++i) {
+			band_p band = &strip->bands[i];
+
+			mem_free(a, band->xs, sizeof(double) * band->n);
+			mem_free(a, band->ys, sizeof(double) * band->n);
+			mem_free(a, band->weights, sizeof(double) * band->n);
+			mem_free(a, band->index, sizeof(unsigned int) * band->n);
+		}
+		mem_free(a, strip->bands, sizeof(band_t) * strip->bands_n);
+		mem_free(a, strip->table, sizeof(unsigned int) * strip->table_n);
+		mem_free(a, strip->window, sizeof(entry_t) * strip->window_n);
+		mem_free(a, strip->core, sizeof(unsigned char) * strip->points_n);
+		mem_free(a, strip->link, sizeof(unsigned int) * strip->points_n);
+		mem_free(a, strip->found, sizeof(unsigned int) * strip->found_n);
+		mem_free(a, strip->before, sizeof(unsigned int) * strip->before_n);
+		unionfind_destroy(strip->uf);
+
+		mem_free(a, strip, sizeof(strip_t));
+	}
+}
+
+
+int strip_push(strip_p strip, point_p point, double weight)
+{
+	double q = floor(point->y / strip->side);
+	unsigned int b, g = (unsigned int) strip->size;
+	size_t points_n = strip->points_n;
+	entry_p e;
+
+	if (strip->finished || !(point->x >= strip->last_x) || !(fabs(q) < BANDS_MAX)
+			|| strip->size >= NO_LINK) {
+		return -1;
+	}
+
+	/* finalize the points it leaves more than eps behind */
+	while (strip->n_final < strip->size) {
+		double dx = point->x - strip->window[strip->head + (strip->n_final - strip->first)].point.x;
+
+		if (dx * dx <= strip->thre) {
+			break;
+		}
+		if (finalize(strip)) {
+			return -1;
+		}
+	}
+
+	if (reserve(strip->alloc, (void **) &strip->core, &points_n, strip->size + 1, sizeof(unsigned char))
+			|| reserve(strip->alloc, (void **) &strip->link, &strip->points_n, strip->size + 1, sizeof(unsigned int))
+			|| unionfind_grow(strip->uf, strip->size + 1)) {
+		return -1;
+	}
+
+	/* the window is kept at least twice the strip, as the bands are, and moved down at its end */
+	if (reserve(strip->alloc, (void **) &strip->window, &strip->window_n, (strip->end - strip->head + 1) * 2,
+			sizeof(entry_t))) {
+		return -1;
+	}
+	if (strip->end == strip->window_n) {
+		memmove(strip->window, strip->window + strip->head, sizeof(entry_t) * (strip->end - strip->head));
+		strip->end -= strip->head;
+		strip->head = 0;
+	}
+
+	b = add_band(strip, (int64_t) q);
+	if (b == NO_BAND || band_push(strip->alloc, &strip->bands[b], point, weight, g)) {
+		return -1;
+	}
+
+	e = &strip->window[strip->end++];
+	e->point = *point;
+	e->band = b;
+
+	strip->core[g] = 0;
+	strip->link[g] = NO_LINK;
+	strip->last_x = point->x;
+	strip->size++;
+	return 0;
+}
+
+
+int strip_finish(strip_p strip)
+{
+	size_t i;
+	unsigned int next_id = 0;
+
+	if (strip->finished) {
+		return strip->n_clusters;
+	}
+
+	while (strip->n_final < strip->size) {
+		if (finalize(strip)) {
+			return -1;
+		}
+	}
+
+	/* number the clusters at their first core points, the representatives of their sets */
+	for (i = 0; i < strip->size; ++i) {
+		if (strip->core[i]) {
+			unsigned int r = unionfind_find(strip->uf, (unsigned int) i);
+			strip->link[i] = r == i ? ++next_id : strip->link[r];
+		}
+	}
+
+	/* then the other points join the cluster of the first core point within eps */
+	for (i = 0; i < strip->size; ++i) {
+		if (!strip->core[i]) {
+			strip->link[i] = strip->link[i] == NO_LINK ? 0 : strip->link[strip->link[i]];
+		}
+	}
+
+	strip->finished = 1;
+	strip->n_clusters = (int) next_id;
+	return strip->n_clusters;
+}
+
+
+size_t strip_size(strip_p strip)
+{
+	return strip->size;
+}
+
+
+int32_t strip_label(strip_p strip, size_t i)
+{
+	return (int32_t) strip->link[i];
+}
+
+
+int strip_core(strip_p strip, size_t i)
+{
+	return strip->core[i];
+}
@@ -0,0 +1,110 @@
+/* Plane-sweep DBSCAN of 2D points coming in x order. */
+
+#ifndef _STRIP_H_
+#define _STRIP_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "geo.h"
+#include "alloc.h"
+
+
+/*
+ * The points are pushed in increasing x, ties in any order, and the sweep
+ * keeps the active strip of the ones within eps in x of the points not
+ * finalized yet. A point is finalized as soon as a point further than eps in
+ * x is pushed, all its neighbours being in the strip by then: it's a core
+ * point if the weight within eps of it is at least min_pts, and it's joined
+ * to the core points finalized before it within eps of it.
+ *
+ * The strip is split into bands of eps across in y, each holding its points
+ * in x order, so that pushing a point and dropping it behind the sweep are
+ * O(1), and the neighbours of a point are found among the points of 3 bands
+ * only.
+ *
+ * So the coordinates in memory are the ones of the strip only, e.g. to
+ * cluster a file sorted by x larger than the memory, the points themselves
+ * taking 9 bytes each: their core flag, their sets of core points, and their
+ * cluster.
+ *
+ * The clusters are the ones of DBSCAN, with the noise 0:
+ * - a border point joins the cluster of the first core point within eps of it;
+ * - the clusters are numbered in the order of their first core points.
+ */
+typedef struct s_strip *strip_p;
+
+
+/*
+ * Create an empty sweep.
+ *
+ * thre: the squared radius of the neighbourhood
+ *
+ * NOTE: the sweep created by this function MUST be destroyed by the caller,
+ * using strip_destroy.
+ */
+strip_p strip_create(double thre, double min_pts);
+
+
+/*
+ * Same as strip_create, with all the memory of the sweep coming from the allocator.
+ */
+strip_p strip_create_with(allocator_p a, double thre, double min_pts);
+
+
+/*
+ * Empty the sweep, to sweep new points at thre and min_pts.
+ *
+ * The memory of the sweep is kept, so sweeping again no more points, nor
+ * denser ones, than before allocates nothing.
+ */
+void strip_reset(strip_p strip, double thre, double min_pts);
+
+
+/*
+ * Destroy the sweep, release all memories it uses.
+ */
+void strip_destroy(strip_p strip);
+
+
+/*
+ * Push the next point, of the weight for the min_pts test, finalizing the
+ * points it leaves more than eps behind.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed, the point is before the last one in x, the sweep is
+ *            finished, or it already has 2^32 - 1 points.
+ */
+int strip_push(strip_p strip, point_p point, double weight);
+
+
+/*
+ * Finalize the points left, and number the clusters.
+ *
+ * Returns: the numbers of clusters if succeed;
+ *          -1 if failed.
+ */
+int strip_finish(strip_p strip);
+
+
+/*
+ * Get the number of points pushed.
+ */
+size_t strip_size(strip_p strip);
+
+
+/*
+ * Get the cluster id of point i, in the order they were pushed, 0 for noise.
+ *
+ * NOTE: the sweep MUST be finished.
+ */
+int32_t strip_label(strip_p strip, size_t i);
+
+
+/*
+ * Tell whether point i, in the order they were pushed, is a core point.
+ */
+int strip_core(strip_p strip, size_t i);
+
+
+#endif /* _STRIP_H_ */
@@ -0,0 +1,272 @@
+#include "tiles.h"
+
+#include <stdlib.h>
+#include <math.h>
+
+#include "array.h"
+
+
+/* most cells along each axis */
+#define GRID_MAX 1024
+
+
+/*
+ * A tile, cells [x0, x1) x [y0, y1) of the grid.
+ */
+typedef struct s_tile
+{
+	unsigned int x0, y0;
+	unsigned int x1, y1;
+
+	/* points counted in the tile and its halo */
+	size_t points;
+}
+tile_t, *tile_p;
+
+
+typedef struct s_tiles
+{
+	rect_t bounds;
+	double eps;
+
+	/* the grid, of nx * ny cells */
+	unsigned int nx, ny;
+	double cell_w, cell_h;
+
+	/*
+	 * Points counted in the cells, and then, after tiles_split,
+	 * sums[(nx + 1) * y + x] is the number of points in cells [0, x) x [0, y).
+	 */
+	size_t *counts;
+	size_t *sums;
+
+	/* the tile of each cell */
+	unsigned int *owner;
+
+	array_p tiles;
+}
+tiles_t;
+
+
+static unsigned int grid_size(interval_p itv, double eps, double *cell)
+{
+	double w = itv->upper - itv->lower;
+	double n = eps > 0.0 ? floor(w / (eps * 2)) : GRID_MAX;
+
+	if (!(n >= 1.0) || !(w > 0.0)) {
+		*cell = 1.0;
+		return 1;
+	}
+	if (n > GRID_MAX) {
+		n = GRID_MAX;
+	}
+	*cell = w / n;
+	return (unsigned int) n;
+}
+
+
+static inline unsigned int cell_of(double p, double lower, double cell, unsigned int n)
+{
+	double c = floor((p - lower) / cell);
+
+	if (!(c > 0.0)) {
+		return 0;
+	}
+	return c >= n ? n - 1 : (unsigned int) c;
+}
+
+
+tiles_p tiles_create(rect_p bounds, double eps)
+{
+	tiles_p tiles = (tiles_p) calloc(1, sizeof(tiles_t));
+	if (tiles) {
+		size_t cells;
+
+		rect_clone_to(bounds, &tiles->bounds);
+		tiles->eps = eps;
+		tiles->nx = grid_size(&bounds->x_itv, eps, &tiles->cell_w);
+		tiles->ny = grid_size(&bounds->y_itv, eps, &tiles->cell_h);
+
+		cells = (size_t) tiles->nx * tiles->ny;
+		tiles->counts = (size_t *) calloc(cells, sizeof(size_t));
+		tiles->owner = (unsigned int *) calloc(cells, sizeof(unsigned int));
+		tiles->tiles = array_create_typed(sizeof(tile_t), 64);
+		if (!tiles->counts || !tiles->owner || !tiles->tiles) {
+			tiles_destroy(tiles);
+			return NULL;
+		}
+	}
+	return tiles;
+}
+
+
+void tiles_destroy(tiles_p tiles)
+{
+	if (tiles) {
+		free(tiles->counts);
+		tiles->counts = NULL;
+
+		free(tiles->sums);
+		tiles->sums = NULL;
+
+		free(tiles->owner);
+		tiles->owner = NULL;
+
+		array_destroy(tiles->tiles);
+		tiles->tiles = NULL;
+
+		free(tiles);
+	}
+}
+
+
+void tiles_count(tiles_p tiles, point_p point)
+{
+	unsigned int x = cell_of(point->x, tiles->bounds.x_itv.lower, tiles->cell_w, tiles->nx);
+	unsigned int y = cell_of(point->y, tiles->bounds.y_itv.lower, tiles->cell_h, tiles->ny);
+
+	++tiles->counts[(size_t) tiles->nx * y + x];
+}
+
+
+/*
+ * Get the number of points in cells [x0, x1) x [y0, y1), clamped to the grid.
+ */
+static size_t sum(tiles_p tiles, long x0, long y0, long x1, long y1)
+{
+	size_t w = tiles->nx + 1;
+
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 > tiles->nx ? tiles->nx : x1;
+	y1 = y1 > tiles->ny ? tiles->ny : y1;
+
+	return tiles->sums[w * y1 + x1] - tiles->sums[w * y0 + x1]
+		- tiles->sums[w * y1 + x0] + tiles->sums[w * y0 + x0];
+}
+
+
+/*
+ * Split cells [x0, x1) x [y0, y1) into tiles, halving the points each time.
+ *
+ * Since the cells are no narrower than eps, the halo is within the ring of cells around.
+ */
+static int split(tiles_p tiles, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+		size_t max_points)
+{
+	size_t points = sum(tiles, (long) x0 - 1, (long) y0 - 1, (long) x1 + 1, (long) y1 + 1);
+	int along_x = x1 - x0 >= y1 - y0;
+	unsigned int lo, hi;
+
+	if (points <= max_points || (x1 - x0 == 1 && y1 - y0 == 1)) {
+		tile_t tile = { .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1, .points = points };
+		unsigned int x, y, id = (unsigned int) array_size(tiles->tiles);
+
+		if (array_push(tiles->tiles, &tile)) {
+			return -1;
+		}
+		for (y = y0; y < y1; ++y) {
+			for (x = x0; x < x1; ++x) {
+				tiles->owner[(size_t) tiles->nx * y + x] = id;
+			}
+		}
+		return 0;
+	}
+
+	if (along_x ? x1 - x0 == 1 : y1 - y0 == 1) {
+		along_x = !along_x;
+	}
+
+	/* the first line of cells past half of the points, keeping both sides non-empty */
+	lo = (along_x ? x0 : y0) + 1;
+	hi = (along_x ? x1 : y1) - 1;
+	while (lo < hi) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		size_t half = along_x ? sum(tiles, x0, y0, mid, y1) : sum(tiles, x0, y0, x1, mid);
+
+		if (half * 2 < sum(tiles, x0, y0, x1, y1)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (along_x) {
+		return split(tiles, x0, y0, lo, y1, max_points) || split(tiles, lo, y0, x1, y1, max_points) ? -1 : 0;
+	}
+	return split(tiles, x0, y0, x1, lo, max_points) || split(tiles, x0, lo, x1, y1, max_points) ? -1 : 0;
+}
+
+
+int tiles_split(tiles_p tiles, size_t max_points)
+{
+	unsigned int x, y;
+	size_t w = tiles->nx + 1;
+
+	if (!tiles->sums) {
+		tiles->sums = (size_t *) calloc(w * (tiles->ny + 1), sizeof(size_t));
+		if (!tiles->sums) {
+			return -1;
+		}
+	}
+
+	for (y = 0; y < tiles->ny; ++y) {
+		for (x = 0; x < tiles->nx; ++x) {
+			tiles->sums[w * (y + 1) + x + 1] = tiles->counts[(size_t) tiles->nx * y + x]
+				+ tiles->sums[w * y + x + 1] + tiles->sums[w * (y + 1) + x] - tiles->sums[w * y + x];
+		}
+	}
+
+	array_clear(tiles->tiles);
+	return split(tiles, 0, 0, tiles->nx, tiles->ny, max_points);
+}
+
+
+size_t tiles_size(tiles_p tiles)
+{
+	return array_size(tiles->tiles);
+}
+
+
+size_t tiles_points(tiles_p tiles, unsigned int tile)
+{
+	return ((tile_p) array_get(tiles->tiles, tile))->points;
+}
+
+
+unsigned int tiles_owner(tiles_p tiles, point_p point)
+{
+	unsigned int x = cell_of(point->x, tiles->bounds.x_itv.lower, tiles->cell_w, tiles->nx);
+	unsigned int y = cell_of(point->y, tiles->bounds.y_itv.lower, tiles->cell_h, tiles->ny);
+
+	return tiles->owner[(size_t) tiles->nx * y + x];
+}
+
+
+size_t tiles_halo(tiles_p tiles, point_p point, unsigned int *halo)
+{
+	double eps = tiles->eps;
+	unsigned int x, y, i, n = 0;
+	unsigned int own = tiles_owner(tiles, point);
+
+	/* the cells within eps of the point, at most 2 x 2 of them as they are no narrower than 2 eps */
+	unsigned int x0 = cell_of(point->x - eps, tiles->bounds.x_itv.lower, tiles->cell_w, tiles->nx);
+	unsigned int x1 = cell_of(point->x + eps, tiles->bounds.x_itv.lower, tiles->cell_w, tiles->nx);
+	unsigned int y0 = cell_of(point->y - eps, tiles->bounds.y_itv.lower, tiles->cell_h, tiles->ny);
+	unsigned int y1 = cell_of(point->y + eps, tiles->bounds.y_itv.lower, tiles->cell_h, tiles->ny);
+
+	for (y = y0; y <= y1; ++y) {
+		for (x = x0; x <= x1; ++x) {
+			unsigned int t = tiles->owner[(size_t) tiles->nx * y + x];
+
+			if (t == own) {
+				continue;
+			}
+			for (i = 0; i < n && halo[i] != t; ++i);
+			if (i == n) {
+				halo[n++] = t;
+			}
+		}
+	}
+	return n;
+}
@@ -0,0 +1,83 @@
+/* Spatial tiles of 2D points, for clustering them tile by tile. */
+
+#ifndef _TILES_H_
+#define _TILES_H_
+
+#include <stdlib.h>
+
+#include "geo.h"
+
+
+/*
+ * Tiles covering a rect.
+ *
+ * The rect is divided into a grid of cells no narrower than 2 eps, and the
+ * tiles are rects of whole cells, split from the grid so that each of them,
+ * with its halo, holds no more than a given number of points.
+ *
+ * The halo of a tile is the points of the other tiles within eps of it,
+ * so the neighbourhoods of all the points of a tile are in the tile and its halo.
+ */
+typedef struct s_tiles *tiles_p;
+
+
+/*
+ * Create the grid covering bounds, with cells no narrower than 2 eps.
+ *
+ * NOTE: the tiles created by this function MUST be destroyed by the caller,
+ * using tiles_destroy.
+ */
+tiles_p tiles_create(rect_p bounds, double eps);
+
+
+/*
+ * Destroy the tiles, release all memories they use.
+ */
+void tiles_destroy(tiles_p tiles);
+
+
+/*
+ * Count the point in the grid, before tiles_split.
+ */
+void tiles_count(tiles_p tiles, point_p point);
+
+
+/*
+ * Split the grid into tiles, each with no more than max_points points counted
+ * in it and its halo, unless it is a single cell.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int tiles_split(tiles_p tiles, size_t max_points);
+
+
+/*
+ * Get the number of tiles.
+ */
+size_t tiles_size(tiles_p tiles);
+
+
+/*
+ * Get the number of points counted in the tile and its halo.
+ */
+size_t tiles_points(tiles_p tiles, unsigned int tile);
+
+
+/*
+ * Get the tile the point belongs to.
+ */
+unsigned int tiles_owner(tiles_p tiles, point_p point);
+
+
+/*
+ * Get the tiles the point is in the halo of.
+ *
+ * halo: receives the tiles, MUST have space for 3 items
+ *
+ * Returns: the number of the tiles.
+ */
+size_t tiles_halo(tiles_p tiles, point_p point, unsigned int *halo);
+
+
+#endif /* _TILES_H_ */
@@ -0,0 +1,115 @@
+#include "unionfind.h"
+
+#include <stdlib.h>
+
+
+typedef struct s_unionfind
+{
+	allocator_p alloc;
+
+	/* the parent of each item, roots being their own parents */
+	unsigned int *parent;
+	size_t size;
+	size_t n;
+}
+unionfind_t;
+
+
+unionfind_p unionfind_create(size_t n)
+{
+	return unionfind_create_with(NULL, n);
+}
+
+
+unionfind_p unionfind_create_with(allocator_p a, size_t n)
+{
+	unionfind_p uf = (unionfind_p) mem_alloc(a, sizeof(unionfind_t));
+	if (uf) {
+		uf->alloc = a;
+		uf->parent = NULL;
+		uf->size = 0;
+		uf->n = 0;
+
+		if (unionfind_grow(uf, n)) {
+			unionfind_destroy(uf);
+			return NULL;
+		}
+	}
+	return uf;
+}
+
+
+void unionfind_destroy(unionfind_p uf)
+{
+	if (uf) {
+		mem_free(uf->alloc, uf->parent, sizeof(unsigned int) * uf->n);
+		uf->parent = NULL;
+
+		mem_free(uf->alloc, uf, sizeof(unionfind_t));
+	}
+}
+
+
+size_t unionfind_size(unionfind_p uf)
+{
+	return uf->size;
+}
+
+
+void unionfind_clear(unionfind_p uf)
+{
+	uf->size = 0;
+}
+
+
+int unionfind_grow(unionfind_p uf, size_t n)
+{
+	size_t i;
+
+	if (n <= uf->size) {
+		return 0;
+	}
+
+	if (n > uf->n) {
+		size_t new_n = uf->n * 2 > n ? uf->n * 2 : n;
+		unsigned int *parent = (unsigned int *) mem_realloc(uf->alloc, uf->parent,
+				sizeof(unsigned int) * uf->n, sizeof(unsigned int) * new_n);
+		if (!parent) {
+			return -1;
+		}
+		uf->parent = parent;
+		uf->n = new_n;
+	}
+
+	for (i = uf->size; i < n; ++i) {
+		uf->parent[i] = (unsigned int) i;
+	}
+	uf->size = n;
+	return 0;
+}
+
+
+unsigned int unionfind_find(unionfind_p uf, unsigned int i)
+{
+	unsigned int *parent = uf->parent;
+
+	/* path halving */
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+
+void unionfind_union(unionfind_p uf, unsigned int a, unsigned int b)
+{
+	a = unionfind_find(uf, a);
+	b = unionfind_find(uf, b);
+
+	if (a < b) {
+		uf->parent[b] = a;
+	} else if (b < a) {
+		uf->parent[a] = b;
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef _UNIONFIND_H_
+#define _UNIONFIND_H_
+
+#include <stdlib.h>
+
+#include "alloc.h"
+
+
+/*
+ * Disjoint sets of the integers in [0, n).
+ *
+ * The representative of a set is always its smallest item, so the result of
+ * a series of unions doesn't depend on their order.
+ */
+typedef struct s_unionfind *unionfind_p;
+
+
+/*
+ * Create the sets {0}, {1}, ..., {n - 1}.
+ *
+ * NOTE: the sets created by this function MUST be destroyed by the caller,
+ * using unionfind_destroy.
+ */
+unionfind_p unionfind_create(size_t n);
+
+
+/*
+ * Same as unionfind_create, with all the memory of the sets coming from the allocator.
+ */
+unionfind_p unionfind_create_with(allocator_p a, size_t n);
+
+
+/*
+ * Destroy the sets, release all memories they use.
+ */
+void unionfind_destroy(unionfind_p uf);
+
+
+/*
+ * Get the number of items.
+ */
+size_t unionfind_size(unionfind_p uf);
+
+
+/*
+ * Remove all the items, keeping the memory for the next ones.
+ */
+void unionfind_clear(unionfind_p uf);
+
+
+/*
+ * Add the singletons {size}, ..., {n - 1}, if there are less than n items.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed.
+ */
+int unionfind_grow(unionfind_p uf, size_t n);
+
+
+/*
+ * Get the representative of the set of item i.
+ */
+unsigned int unionfind_find(unionfind_p uf, unsigned int i);
+
+
+/*
+ * Merge the sets of items a and b.
+ */
+void unionfind_union(unionfind_p uf, unsigned int a, unsigned int b);
+
+
+#endif /* _UNIONFIND_H_ */
@@ -0,0 +1,176 @@
+/* Checks of the pools and the arenas, over random sequences of allocations. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "alloc.h"
+#include "check.h"
+
+
+/* most allocations of a sequence */
+#define ALLOCS_MAX 400
+
+
+static unsigned char *items[ALLOCS_MAX];
+static size_t sizes[ALLOCS_MAX];
+
+
+/*
+ * Check that the n blocks of sizes are aligned for any type, and hold the
+ * byte of their index, so that none overlaps another.
+ *
+ * Returns: 0 if they are;
+ *         -1 if not, failing the check.
+ */
+static int check_blocks(const char *check, size_t n)
+{
+	size_t i, j;
+
+	for (i = 0; i < n; ++i) {
+		if (!items[i]) {
+			continue;
+		}
+		if ((uintptr_t) items[i] % 16) {
+			fail(check, "block not aligned");
+			return -1;
+		}
+		for (j = 0; j < sizes[i]; ++j) {
+			if (items[i][j] != (unsigned char) i) {
+				fail(check, "block overwritten");
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * A pool hands out items of its size which don't overlap, takes back the
+ * ones put back, refuses larger blocks through its allocator, and gives all
+ * of its memory back to its parent.
+ */
+static void check_pool()
+{
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	size_t i, n = 1 + random_next() % ALLOCS_MAX, item_bytes = 1 + random_next() % 64;
+	pool_p pool = pool_create(&a, item_bytes, 1 + random_next() % 16);
+
+	if (!pool) {
+		fail("pool", "no pool");
+		return;
+	}
+
+	for (i = 0; i < n; ++i) {
+		items[i] = (unsigned char *) pool_alloc(pool);
+		sizes[i] = item_bytes;
+		if (!items[i]) {
+			fail("pool", "failed");
+			pool_destroy(pool);
+			return;
+		}
+		memset(items[i], (int) i, item_bytes);
+	}
+
+	/* every other item put back and taken again */
+	for (i = 0; i < n; i += 2) {
+		pool_free(pool, items[i]);
+	}
+	for (i = 0; i < n; i += 2) {
+		items[i] = (unsigned char *) mem_alloc(pool_allocator(pool), item_bytes);
+		if (!items[i]) {
+			fail("pool", "failed");
+			pool_destroy(pool);
+			return;
+		}
+		memset(items[i], (int) i, item_bytes);
+	}
+	check_blocks("pool", n);
+
+	/* the items being 64 bytes at most, rounded up */
+	if (mem_alloc(pool_allocator(pool), 128) || mem_realloc(pool_allocator(pool), items[0], item_bytes, 128)) {
+		fail("pool", "block larger than an item handed out");
+	}
+
+	pool_destroy(pool);
+	if (!counter.calls || counter.bytes) {
+		fail("pool", "memory not taken from the parent, or not given back");
+	}
+}
+
+
+/*
+ * An arena hands out blocks which don't overlap, the same again after being
+ * rolled back to a mark without taking more memory from its parent, resizes
+ * and frees its last block in place, and gives all of its memory back to its
+ * parent.
+ */
+static void check_arena()
+{
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	size_t i, n = 1 + random_next() % ALLOCS_MAX, block_bytes = 64 + random_next() % 4096, calls = 0;
+	arena_p arena = arena_create(&a, block_bytes);
+	arena_mark_t mark;
+	unsigned char *last;
+	int round;
+
+	if (!arena) {
+		fail("arena", "no arena");
+		return;
+	}
+
+	for (i = 0; i < n; ++i) {
+		sizes[i] = random_next() % 20 ? random_next() % 300 : random_next() % (3 * block_bytes);
+	}
+
+	/* the same allocations twice, the second time from the blocks kept */
+	mark = arena_mark(arena);
+	for (round = 0; round < 2; ++round) {
+		for (i = 0; i < n; ++i) {
+			items[i] = (unsigned char *) arena_alloc(arena, sizes[i]);
+			if (!items[i]) {
+				fail("arena", "failed");
+				arena_destroy(arena);
+				return;
+			}
+			memset(items[i], (int) i, sizes[i]);
+		}
+		if (check_blocks("arena", n)) {
+			break;
+		}
+		if (round && counter.calls != calls) {
+			fail("arena", "memory taken from the parent again");
+		}
+		calls = counter.calls;
+		arena_reset_to(arena, mark);
+	}
+
+	last = (unsigned char *) mem_alloc(arena_allocator(arena), 16);
+	if (!last || mem_realloc(arena_allocator(arena), last, 16, 32) != last) {
+		fail("arena", "last block not resized in place");
+	}
+	mem_free(arena_allocator(arena), last, 32);
+	if (mem_alloc(arena_allocator(arena), 16) != last) {
+		fail("arena", "last block not freed in place");
+	}
+
+	arena_reset(arena);
+	arena_destroy(arena);
+	if (!counter.calls || counter.bytes) {
+		fail("arena", "memory not taken from the parent, or not given back");
+	}
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		check_pool();
+		check_arena();
+	}
+	return check_done("alloc-test");
+}
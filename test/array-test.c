@@ -0,0 +1,68 @@
+/* Checks of the arrays, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "geo.h"
+#include "array.h"
+#include "check.h"
+
+
+/*
+ * A typed array keeps its items by value through its growth, and an array
+ * of pointers keeps the pointers.
+ */
+static void check_arrays()
+{
+	array_p typed = array_create_typed(sizeof(point_t), 1), ptrs = array_create(1);
+	size_t i;
+
+	if (!typed || !ptrs) {
+		fail("arrays", "no array");
+		array_destroy(typed);
+		array_destroy(ptrs);
+		return;
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		if (array_push(typed, &input.coords[2 * i]) || array_append(ptrs, &input.coords[2 * i])) {
+			fail("arrays", "failed to grow");
+			break;
+		}
+	}
+
+	if (array_size(typed) != input.n || array_size(ptrs) != input.n
+			|| (input.n && memcmp(array_data(typed), input.coords, sizeof(point_t) * input.n))) {
+		fail("arrays", "items lost while growing");
+	}
+	for (i = 0; i < array_size(ptrs); ++i) {
+		void *item = NULL;
+
+		if (array_at(ptrs, (unsigned int) i, &item) || item != &input.coords[2 * i]
+				|| memcmp(array_get(typed, (unsigned int) i), item, sizeof(point_t))) {
+			fail("arrays", "wrong item");
+			break;
+		}
+	}
+
+	array_truncate(typed, input.n / 2);
+	if (array_size(typed) != input.n / 2 || array_get(typed, (unsigned int) (input.n / 2))) {
+		fail("arrays", "items left after truncating");
+	}
+
+	array_destroy(typed);
+	array_destroy(ptrs);
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+
+		check_arrays();
+	}
+	return check_done("array-test");
+}
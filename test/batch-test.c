@@ -0,0 +1,114 @@
+/* Checks of the batch kernels against the functions of geo.h, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "geo.h"
+#include "batch.h"
+#include "check.h"
+
+
+/*
+ * Each instruction set the kernels can use computes what the functions of
+ * geo.h compute, to the last bit, the tails of the vectors too.
+ */
+static void check_batch()
+{
+	static double xs[POINTS_MAX], ys[POINTS_MAX];
+	static double x_lower[POINTS_MAX], x_upper[POINTS_MAX], y_lower[POINTS_MAX], y_upper[POINTS_MAX];
+	static double dists[POINTS_MAX];
+	static unsigned int index[POINTS_MAX];
+	static unsigned char inside[POINTS_MAX];
+	const char *isas[4] = { "scalar", "sse2", "avx2", "avx512" };
+	const char *saved = batch_isa();
+	double thre = input.eps * input.eps;
+	point_t q = { .x = random_uniform(), .y = random_uniform() };
+	rect_t rect;
+	size_t i, j, k, m, n = input.n;
+
+	for (i = 0; i < n; ++i) {
+		point_t a = { .x = input.coords[2 * i], .y = input.coords[2 * i + 1] };
+		point_t b = { .x = input.coords[2 * ((i + 1) % n)], .y = input.coords[2 * ((i + 1) % n) + 1] };
+
+		xs[i] = a.x;
+		ys[i] = a.y;
+		rect_init_point(&rect, &a);
+		rect_enlarge_to(&rect, &b);
+		x_lower[i] = rect.x_itv.lower;
+		x_upper[i] = rect.x_itv.upper;
+		y_lower[i] = rect.y_itv.lower;
+		y_upper[i] = rect.y_itv.upper;
+	}
+	rect_init_point(&rect, &q);
+	q.x += (random_uniform() - 0.5) * 0.2;
+	q.y += (random_uniform() - 0.5) * 0.2;
+	rect_enlarge_to(&rect, &q);
+
+	for (k = 0; k < 4; ++k) {
+		if (batch_use(isas[k])) {
+			if (!k) {
+				fail("batch", "no scalar kernels");
+			}
+			continue;
+		}
+
+		batch_dist(xs, ys, n, &q, dists);
+		for (i = 0; i < n; ++i) {
+			point_t p = { .x = xs[i], .y = ys[i] };
+
+			if (dists[i] != point_dist(&p, &q)) {
+				fail(isas[k], "not the distance of point_dist");
+				break;
+			}
+		}
+
+		m = batch_within(xs, ys, n, &q, thre, index);
+		for (i = j = 0; i < n; ++i) {
+			point_t p = { .x = xs[i], .y = ys[i] };
+
+			if (point_dist(&p, &q) <= thre && (j >= m || index[j++] != i)) {
+				fail(isas[k], "not the points within thre");
+				break;
+			}
+		}
+		if (j != m) {
+			fail(isas[k], "not the points within thre");
+		}
+
+		batch_rect_contains(&rect, xs, ys, n, inside);
+		for (i = 0; i < n; ++i) {
+			point_t p = { .x = xs[i], .y = ys[i] };
+
+			if (inside[i] != (rect_contains(&rect, &p) ? 1 : 0)) {
+				fail(isas[k], "not what rect_contains tells");
+				break;
+			}
+		}
+
+		batch_rect_min_dist(x_lower, x_upper, y_lower, y_upper, n, &q, dists);
+		for (i = 0; i < n; ++i) {
+			rect_t r = { .x_itv = { x_lower[i], x_upper[i] }, .y_itv = { y_lower[i], y_upper[i] } };
+
+			if (dists[i] != rect_min_dist_to(&r, &q)) {
+				fail(isas[k], "not the distance of rect_min_dist_to");
+				break;
+			}
+		}
+	}
+
+	if (batch_use(saved)) {
+		fail("batch", "can't restore the instruction set");
+	}
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+
+		check_batch();
+	}
+	return check_done("batch-test");
+}
@@ -0,0 +1,110 @@
+/* Checks of the cache of labels, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+
+#include "dbscan.h"
+#include "cache.h"
+#include "check.h"
+
+
+/* the directory of the cache, in the working directory */
+#define CACHE_DIR "cache-test.cache"
+
+
+static int32_t labels[POINTS_MAX];
+
+/* the context the misses are clustered in */
+static dbscan_context_p ctx;
+
+
+/*
+ * The labels read back from the cache are the ones stored, the canonical
+ * ones being the ones of DBSCAN, and other parameters miss.
+ */
+static void check_cache()
+{
+	static int32_t stored[POINTS_MAX];
+	cache_p cache = cache_open(CACHE_DIR);
+	size_t hits, misses;
+	int r, s;
+
+	if (!cache) {
+		fail("cache", "can't open the cache");
+		return;
+	}
+
+	r = cache_cluster_labels(cache, ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, labels);
+	memset(labels, 0xff, sizeof(int32_t) * input.n);
+	s = cache_cluster_labels(cache, ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, labels);
+	cache_stats(cache, &hits, &misses);
+	if (!check_exact("cache", &input, &truth, s, labels, NULL) && (r != s || hits != 1 || misses != 1)) {
+		fail("cache", "the labels stored not found");
+	}
+
+	/* the labels of the other engines are read back as they were stored */
+	r = input.n ? cache_cluster_labels(cache, ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_NBGRAPH, stored) : 0;
+	s = input.n ? cache_cluster_labels(cache, ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_NBGRAPH, labels) : 0;
+	if (r < 0 || s != r || memcmp(labels, stored, sizeof(int32_t) * input.n)) {
+		fail("cache", "not the labels stored");
+	}
+
+	cache_cluster_labels(cache, ctx, input.coords, 0, input.n, input.eps / 2, input.min_pts,
+			DBSCAN_CANONICAL, labels);
+	cache_stats(cache, &hits, &misses);
+	if (misses != (input.n ? 3 : 2)) {
+		fail("cache", "other parameters found");
+	}
+	cache_close(cache);
+}
+
+
+/*
+ * Remove the files of the cache, and its directory.
+ */
+static void remove_cache()
+{
+	char path[sizeof(CACHE_DIR) + 256];
+	struct dirent *entry;
+	DIR *dir = opendir(CACHE_DIR);
+
+	while (dir && (entry = readdir(dir))) {
+		if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+			snprintf(path, sizeof(path), "%s/%s", CACHE_DIR, entry->d_name);
+			remove(path);
+		}
+	}
+	if (dir) {
+		closedir(dir);
+	}
+	remove(CACHE_DIR);
+}
+
+
+int main()
+{
+	remove_cache();
+	ctx = dbscan_context_create();
+	if (!ctx) {
+		perror(NULL);
+		return 1;
+	}
+
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_cache();
+	}
+
+	dbscan_context_destroy(ctx);
+	remove_cache();
+	return check_done("cache-test");
+}
@@ -0,0 +1,392 @@
+#include "check.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+input_t input;
+truth_t truth;
+int trial;
+int failures;
+
+
+static uint64_t random_state = 0x2545f4914f6cdd1dULL;
+
+
+uint64_t random_next(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	return random_state;
+}
+
+
+double random_uniform(void)
+{
+	return (double) (random_next() >> 11) / 9007199254740992.0;
+}
+
+
+void fail(const char *check, const char *what)
+{
+	printf("%s: trial %d (%zu points, eps %g, min_pts %zu): %s\n",
+			check, trial, input.n, input.eps, input.min_pts, what);
+	++failures;
+}
+
+
+double dist(const double *coords, size_t i, size_t j)
+{
+	double dx = coords[2 * i] - coords[2 * j], dy = coords[2 * i + 1] - coords[2 * j + 1];
+
+	return dx * dx + dy * dy;
+}
+
+
+void make_input(input_p in)
+{
+	size_t i, n_blobs = 1 + random_next() % 5;
+	double centers[10], spread = 0.01 + 0.05 * random_uniform(), noise = 0.3 * random_uniform();
+	double repeats = 0.3 * random_uniform();
+
+	in->n = trial % 10 == 9 ? 2100 + random_next() % (POINTS_MAX - 2100) : random_next() % 400;
+	in->on_grid = random_next() % 2;
+	in->eps = 0.005 + 0.05 * random_uniform();
+	in->min_pts = 1 + random_next() % 8;
+
+	for (i = 0; i < n_blobs * 2; ++i) {
+		centers[i] = random_uniform();
+	}
+
+	for (i = 0; i < in->n; ++i) {
+		double *p = &in->coords[2 * i];
+
+		if (i && random_uniform() < repeats) {
+			size_t j = random_next() % i;
+			p[0] = in->coords[2 * j];
+			p[1] = in->coords[2 * j + 1];
+		} else if (random_uniform() < noise) {
+			p[0] = random_uniform();
+			p[1] = random_uniform();
+		} else {
+			size_t b = random_next() % n_blobs;
+			p[0] = centers[2 * b] + spread * (random_uniform() + random_uniform() - 1.0);
+			p[1] = centers[2 * b + 1] + spread * (random_uniform() + random_uniform() - 1.0);
+		}
+
+		if (in->on_grid) {
+			p[0] = floor(p[0] * GRID) / GRID;
+			p[1] = floor(p[1] * GRID) / GRID;
+		}
+		in->weights[i] = 1.0;
+	}
+}
+
+
+static unsigned int find(unsigned int *parent, unsigned int i)
+{
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+
+void make_truth(input_p in, const double *weights, truth_p t)
+{
+	static unsigned int parent[POINTS_MAX];
+	static int32_t ids[POINTS_MAX];
+	size_t i, j;
+	double thre = in->eps * in->eps;
+
+	for (i = 0; i < in->n; ++i) {
+		double total = 0.0;
+
+		for (j = 0; j < in->n; ++j) {
+			if (dist(in->coords, i, j) <= thre) {
+				total += weights[j];
+			}
+		}
+		t->core[i] = total >= in->min_pts;
+		parent[i] = (unsigned int) i;
+	}
+
+	for (i = 0; i < in->n; ++i) {
+		for (j = 0; t->core[i] && j < i; ++j) {
+			if (t->core[j] && dist(in->coords, i, j) <= thre) {
+				unsigned int a = find(parent, (unsigned int) i), b = find(parent, (unsigned int) j);
+				parent[a > b ? a : b] = a > b ? b : a;
+			}
+		}
+	}
+
+	/* the clusters are numbered in the order of their first core points */
+	t->n_clusters = 0;
+	for (i = 0; i < in->n; ++i) {
+		ids[i] = 0;
+		if (t->core[i]) {
+			t->first[i] = find(parent, (unsigned int) i);
+			if (t->first[i] == i) {
+				ids[i] = ++t->n_clusters;
+			}
+			t->canonical[i] = ids[t->first[i]];
+		}
+	}
+
+	/* and a border point joins the one with the first core point */
+	for (i = 0; i < in->n; ++i) {
+		if (t->core[i]) {
+			continue;
+		}
+		t->canonical[i] = 0;
+		for (j = 0; j < in->n; ++j) {
+			if (t->core[j] && dist(in->coords, i, j) <= thre
+					&& (!t->canonical[i] || t->canonical[j] < t->canonical[i])) {
+				t->canonical[i] = t->canonical[j];
+			}
+		}
+	}
+}
+
+
+int check_clusters(const char *check, input_p in, truth_p t, const int32_t *ls,
+		const unsigned char *cores, int flags)
+{
+	static unsigned int first_of[2 * POINTS_MAX + 2];
+	static unsigned char is_core_id[2 * POINTS_MAX + 2];
+	size_t i, j;
+	double thre = in->eps * in->eps;
+
+	for (i = 0; i < 2 * in->n + 2; ++i) {
+		first_of[i] = (unsigned int) -1;
+		is_core_id[i] = 0;
+	}
+
+	for (i = 0; i < in->n; ++i) {
+		if ((flags & CORE_FLAGS) && cores[i] != t->core[i]) {
+			fail(check, "wrong core flag");
+			return -1;
+		}
+		if (ls[i] < 0 || (size_t) ls[i] > 2 * in->n + 1) {
+			fail(check, "label out of range");
+			return -1;
+		}
+		if (!t->core[i]) {
+			continue;
+		}
+		if (!ls[i]) {
+			fail(check, "core point as noise");
+			return -1;
+		}
+		if (first_of[ls[i]] == (unsigned int) -1) {
+			first_of[ls[i]] = t->first[i];
+		} else if (first_of[ls[i]] != t->first[i]) {
+			fail(check, "two clusters merged");
+			return -1;
+		}
+		is_core_id[ls[i]] = 1;
+	}
+
+	/* a cluster split in two has two ids of the same first core point */
+	for (i = 0; i < in->n; ++i) {
+		if (!(flags & HULLS) && t->core[i] && ls[t->first[i]] != ls[i]) {
+			fail(check, "cluster split");
+			return -1;
+		}
+	}
+
+	for (i = 0; i < in->n; ++i) {
+		int found = 0, reached = 0;
+
+		if (t->core[i]) {
+			continue;
+		}
+		for (j = 0; j < in->n; ++j) {
+			if (t->core[j] && dist(in->coords, i, j) <= thre) {
+				reached = 1;
+				found |= ls[j] == ls[i];
+			}
+		}
+		if (reached && !found && !(flags & HULLS) && !((flags & BORDER_NOISE) && !ls[i])) {
+			fail(check, "border point out of the clusters within eps");
+			return -1;
+		}
+		if (!reached && (flags & NOISE_ZERO) && ls[i]) {
+			fail(check, "noise in a cluster");
+			return -1;
+		}
+		if (!reached && !(flags & NOISE_ZERO) && (!ls[i] || is_core_id[ls[i]])) {
+			fail(check, "noise in a cluster");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+
+int check_exact(const char *check, input_p in, truth_p t, int r, const int32_t *ls,
+		const unsigned char *cores)
+{
+	if (r < 0) {
+		fail(check, "failed");
+		return -1;
+	}
+	if (r != t->n_clusters || memcmp(ls, t->canonical, sizeof(int32_t) * in->n)) {
+		fail(check, "not the labels of DBSCAN");
+		return -1;
+	}
+	if (cores && memcmp(cores, t->core, in->n)) {
+		fail(check, "not the core points of DBSCAN");
+		return -1;
+	}
+	return 0;
+}
+
+
+int write_points(const char *check, input_p in, size_t offset, size_t stride)
+{
+	char record[64];
+	size_t i;
+	FILE *out = fopen(POINTS_PATH, "wb");
+
+	if (!out) {
+		fail(check, "can't write the points");
+		return -1;
+	}
+	memset(record, 0, sizeof(record));
+	for (i = 0; i < in->n; ++i) {
+		double index = (double) i;
+
+		memcpy(record, &index, sizeof(double));
+		memcpy(record + offset, &in->coords[2 * i], 2 * sizeof(double));
+		if (fwrite(record, stride, 1, out) != 1) {
+			fclose(out);
+			fail(check, "can't write the points");
+			return -1;
+		}
+	}
+	if (fclose(out)) {
+		fail(check, "can't write the points");
+		return -1;
+	}
+	return 0;
+}
+
+
+int read_labels(const char *check, size_t n, int32_t *ls)
+{
+	FILE *in = fopen(LABELS_PATH, "rb");
+	size_t got = in ? fread(ls, sizeof(int32_t), n, in) : 0;
+
+	if (in) {
+		fclose(in);
+	}
+	if (!in || got != n) {
+		fail(check, "can't read the labels");
+		return -1;
+	}
+	return 0;
+}
+
+
+static void *counter_alloc(void *state, size_t bytes)
+{
+	((counter_p) state)->bytes += (long long) bytes;
+	((counter_p) state)->calls++;
+	return malloc(bytes);
+}
+
+
+static void *counter_realloc(void *state, void *ptr, size_t old_bytes, size_t bytes)
+{
+	void *p = realloc(ptr, bytes);
+
+	if (p) {
+		((counter_p) state)->bytes += (long long) bytes - (long long) old_bytes;
+		((counter_p) state)->calls++;
+	}
+	return p;
+}
+
+
+static void counter_free(void *state, void *ptr, size_t bytes)
+{
+	((counter_p) state)->bytes -= (long long) bytes;
+	((counter_p) state)->calls++;
+	free(ptr);
+}
+
+
+allocator_t counter_allocator(counter_p counter)
+{
+	allocator_t a = { counter_alloc, counter_realloc, counter_free, counter };
+
+	return a;
+}
+
+
+/*
+ * Twice the signed area of the triangle a, b, c, positive if it's counter-clockwise.
+ */
+static double cross(const point_t *a, const point_t *b, const point_t *c)
+{
+	return (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+}
+
+
+int check_hull(const char *check, const point_t *hull, size_t h, const point_t *pts, size_t n)
+{
+	size_t i, j;
+
+	if (!n || !h || h > n) {
+		if (n || h) {
+			fail(check, "hull of the wrong size");
+			return -1;
+		}
+		return 0;
+	}
+
+	for (i = 0; i < h; ++i) {
+		for (j = 0; j < n && (pts[j].x != hull[i].x || pts[j].y != hull[i].y); ++j);
+		if (j == n) {
+			fail(check, "hull vertex not a point");
+			return -1;
+		}
+		if (h > 1 && hull[i].x == hull[(i + 1) % h].x && hull[i].y == hull[(i + 1) % h].y) {
+			fail(check, "hull vertex repeated");
+			return -1;
+		}
+		if (h > 2 && cross(&hull[i], &hull[(i + 1) % h], &hull[(i + 2) % h]) <= 0) {
+			fail(check, "hull not convex and counter-clockwise");
+			return -1;
+		}
+	}
+
+	for (j = 0; j < n; ++j) {
+		for (i = 0; i < h; ++i) {
+			const point_t *a = &hull[i], *b = &hull[(i + 1) % h];
+
+			if (h == 1 ? pts[j].x != a->x || pts[j].y != a->y
+					: cross(a, b, &pts[j]) < -1e-12 || (h == 2 && (cross(a, b, &pts[j]) > 1e-12
+						|| (pts[j].x - a->x) * (pts[j].x - b->x) + (pts[j].y - a->y) * (pts[j].y - b->y) > 1e-12))) {
+				fail(check, "point out of the hull");
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+
+int check_done(const char *test)
+{
+	if (failures) {
+		printf("%s: %d checks failed\n", test, failures);
+		return 1;
+	}
+	printf("%s: all checks passed, %d trials\n", test, TRIALS);
+	return 0;
+}
@@ -0,0 +1,208 @@
+/* Random inputs and their brute-force DBSCAN, which the tests check the library against. */
+
+#ifndef _CHECK_H_
+#define _CHECK_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "geo.h"
+#include "alloc.h"
+
+
+/* trials of a test, a new input each */
+#ifndef TRIALS
+#define TRIALS 300
+#endif
+
+/* most points of an input, the ones of every tenth trial being over the scan limit of dbscan_core_labels */
+#define POINTS_MAX 3000
+
+/* the grid the points of some inputs are on, so that they have ties, and exact fixed-point coordinates */
+#define GRID 1024.0
+
+/* the files the file clusterings read and write, in the working directory */
+#define POINTS_PATH "check.points"
+#define LABELS_PATH "check.labels"
+
+
+/*
+ * A random input: blobs of points, noise, and repeated points.
+ */
+typedef struct s_input
+{
+	size_t n;
+	double coords[2 * POINTS_MAX];
+	double weights[POINTS_MAX];
+	double eps;
+	size_t min_pts;
+
+	/* whether the points are on the grid */
+	int on_grid;
+}
+input_t, *input_p;
+
+
+/*
+ * The brute-force DBSCAN of an input.
+ */
+typedef struct s_truth
+{
+	unsigned char core[POINTS_MAX];
+
+	/* the first core point of the cluster of each core point */
+	unsigned int first[POINTS_MAX];
+
+	/* the labels DBSCAN_CANONICAL describes */
+	int32_t canonical[POINTS_MAX];
+	int n_clusters;
+}
+truth_t, *truth_p;
+
+
+/* the input of the current trial, and its DBSCAN */
+extern input_t input;
+extern truth_t truth;
+extern int trial;
+
+/* the number of checks failed so far */
+extern int failures;
+
+
+/*
+ * Get the next number of the random sequence, the same from run to run.
+ */
+uint64_t random_next(void);
+
+
+/*
+ * Get a random number in [0, 1).
+ */
+double random_uniform(void);
+
+
+/*
+ * Fail the check, telling what went wrong on the input of the trial.
+ */
+void fail(const char *check, const char *what);
+
+
+/*
+ * Get the squared distance of the points i and j of the coordinates.
+ */
+double dist(const double *coords, size_t i, size_t j);
+
+
+/*
+ * Make a random input, of more than 2100 points every tenth trial.
+ */
+void make_input(input_p in);
+
+
+/*
+ * Cluster the input by brute force, the points weighing weights.
+ */
+void make_truth(input_p in, const double *weights, truth_p t);
+
+
+/*
+ * Flags for check_clusters.
+ */
+
+/* the points which belong to no cluster are 0, not grouped into clusters of their own */
+#define NOISE_ZERO 0x01
+
+/* cores holds the core flags the engine gives */
+#define CORE_FLAGS 0x02
+
+/*
+ * the clusters are expanded from their convex hulls only, as dbscan_cluster
+ * does, so that a cluster of DBSCAN may be split, and a border point may join
+ * any cluster: only the clusters merging none and the noise are checked
+ */
+#define HULLS 0x04
+
+/* a border point may be left as noise, as dbscan_optics_labels leaves some */
+#define BORDER_NOISE 0x08
+
+
+/*
+ * Check that the labels are a DBSCAN clustering of the input, whatever the
+ * ids: the core points are in the clusters of the truth, and each border point
+ * in the cluster of a core point within eps of it.
+ *
+ * Returns: 0 if they are;
+ *         -1 if not, failing the check.
+ */
+int check_clusters(const char *check, input_p in, truth_p t, const int32_t *ls,
+		const unsigned char *cores, int flags);
+
+
+/*
+ * Check that r clusters and the labels are the canonical ones of the truth,
+ * and so are the core flags, unless cores is NULL.
+ *
+ * Returns: 0 if they are;
+ *         -1 if not, failing the check.
+ */
+int check_exact(const char *check, input_p in, truth_p t, int r, const int32_t *ls,
+		const unsigned char *cores);
+
+
+/*
+ * Write the points of the input to POINTS_PATH as records of stride bytes,
+ * each point at offset bytes of its record, after the index of the point
+ * as a double.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed, failing the check.
+ */
+int write_points(const char *check, input_p in, size_t offset, size_t stride);
+
+
+/*
+ * Read the n labels a file clustering wrote to LABELS_PATH.
+ *
+ * Returns: 0 if succeed;
+ *         -1 if failed, failing the check.
+ */
+int read_labels(const char *check, size_t n, int32_t *ls);
+
+
+/*
+ * Allocator counting the calls to it, and the bytes it has out from the
+ * sizes given back on realloc and free.
+ */
+typedef struct s_counter
+{
+	long long bytes;
+	size_t calls;
+}
+counter_t, *counter_p;
+
+
+/*
+ * Get the allocator handle counting into counter.
+ */
+allocator_t counter_allocator(counter_p counter);
+
+
+/*
+ * Check that the h vertices are the convex hull of the n points, counter-clockwise,
+ * a point within rounding of an edge being on it.
+ *
+ * Returns: 0 if they are;
+ *         -1 if not, failing the check.
+ */
+int check_hull(const char *check, const point_t *hull, size_t h, const point_t *pts, size_t n);
+
+
+/*
+ * Tell how the checks of the test went.
+ *
+ * Returns: the exit status of the test.
+ */
+int check_done(const char *test);
+
+
+#endif /* _CHECK_H_ */
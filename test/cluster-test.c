@@ -4,7 +4,6 @@
 #include <errno.h>
 
 #include "geo.h"
-#include "array.h"
 #include "dbscan.h"
 
 
@@ -84,7 +83,8 @@ int main(int argc, char *argv[])
 	point_t *points = NULL;
 	cpoint_t *cpoints = NULL;
 	cpoint_p *cpoint_ps = NULL;
-	unsigned int i, j;
+	dbscan_context_p ctx = NULL;
+	unsigned int i;
 	int r;
 	size_t n;
 
@@ -93,6 +93,7 @@ int main(int argc, char *argv[])
 		free(points); points = NULL;\
 		free(cpoints); cpoints = NULL;\
 		free(cpoint_ps); cpoint_ps = NULL;\
+		dbscan_context_destroy(ctx); ctx = NULL;\
 	}
 
 	if (argc != 2) {
@@ -127,65 +128,22 @@ int main(int argc, char *argv[])
 		cpoint_ps[i] = &cpoints[i];
 	}
 
-	r = dbscan_cluster(cpoint_ps, n, EPS, MINPTS);
-	if (r > 0) {
-		int *counts = (int *) malloc(sizeof(int) * r);
-		double *deviations = (double *) malloc(sizeof(double) * r);
-		point_t *centers = (point_t *) malloc(sizeof(point_t) * r);
-		array_p *groups = (array_p *) malloc(sizeof(array_p) * r);
-
-		for (i = 0; i < (unsigned int) r; ++i) {
-			counts[i] = 0;
-			deviations[i] = 0.0;
-			centers[i].x = 0.0;
-			centers[i].y = 0.0;
-			groups[i] = array_create(0);
-		}
-
-		for (i = 0; i < n; ++i) {
-			int id = cpoints[i].cluster_id - 1;
-			++counts[id];
-			centers[id].x += cpoints[i].point.x;
-			centers[id].y += cpoints[i].point.y;
-			array_append(groups[id], &cpoints[i]);
-		}
-
-		for (i = 0; i < (unsigned int) r; ++i) {
-			centers[i].x /= counts[i];
-			centers[i].y /= counts[i];
-		}
-
-		for (i = 0; i < n; ++i) {
-			int id = cpoints[i].cluster_id - 1;
-			// deviations[id] += point_dist((point_p) &cpoints[i], &centers[id]);
-		}
-
-		for (i = 0; i < (unsigned int) r; ++i) {
-			deviations[i] /= counts[i];
-		}
+	ctx = dbscan_context_create();
+	if (!ctx) {
+		FREEALL();
+		perror(NULL);
+		return -1;
+	}
 
-		// for (i = 0; i < (unsigned int) r; ++i) {
-		// 	printf("group %2d:\n", i);
-		// 	for (j = 0; j < array_size(groups[i]); ++j) {
-		// 		point_p p = NULL;
-		// 		array_at(groups[i], j, (void **) &p);
-		// 		printf("(%.8g,%.8g)\n", p->x, p->y);
-		// 	}
-		// 	printf("\n");
-		// }
-
-		for (i = 0; i < (unsigned int) r; ++i) {
-			printf("group %2d:\ttotal:%3d\tdeviation %.9g\n", i, counts[i], deviations[i]);
-		}
+	r = dbscan_context_cluster(ctx, cpoint_ps, n, EPS, MINPTS, DBSCAN_STATS);
+	if (r > 0) {
+		size_t n_stats = 0;
+		const dbscan_stats_t *stats = dbscan_context_stats(ctx, &n_stats);
 
-		free(counts);
-		free(centers);
-		free(deviations);
-		for (i = 0; i < (unsigned int) r; ++i) {
-			array_destroy(groups[i]);
-			groups[i] = NULL;
+		for (i = 0; i < n_stats; ++i) {
+			double deviation = stats[i].size ? stats[i].m2 / stats[i].size : 0.0;
+			printf("group %2d:\ttotal:%3d\tdeviation %.9g\n", i, (int) stats[i].size, deviation);
 		}
-		free(groups);
 
 	} else {
 		printf("error\n");
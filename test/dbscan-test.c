@@ -0,0 +1,692 @@
+/* Checks of the clustering engines of dbscan.c against a brute-force DBSCAN, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "geo.h"
+#include "dbscan.h"
+#include "check.h"
+
+
+/* points far from the input added to it, more than the pointsets scanned without a kd-tree */
+#define PAD_POINTS 2100
+
+
+static int32_t labels[POINTS_MAX];
+static unsigned char core[POINTS_MAX];
+
+/* the context every trial clusters in, growing for the larger inputs and reused for the smaller */
+static dbscan_context_p ctx;
+
+
+/*
+ * Laying the points out along a Hilbert curve changes only the order they
+ * are searched in, not the clusters.
+ */
+static void check_sfc_order()
+{
+	int r = dbscan_core_labels(input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_SFC_ORDER, labels, core);
+
+	if (r < 0) {
+		fail("sfc_order", "failed");
+		return;
+	}
+	check_clusters("sfc_order", &input, &truth, labels, core, NOISE_ZERO | CORE_FLAGS);
+}
+
+
+/*
+ * The labels of a coordinate buffer are a clustering of it, as the cluster
+ * ids of the cpoint_p interface are. The two needn't be the same: the
+ * clusters pruned by the convex hulls depend on the order the pointsets are
+ * visited in, which depends on where they are in memory.
+ */
+static void check_labels()
+{
+	static cpoint_t cpoints[POINTS_MAX];
+	static cpoint_p cpoint_ps[POINTS_MAX];
+	size_t i;
+	int r;
+
+	r = dbscan_cluster_labels(input.coords, 0, input.n, input.eps, input.min_pts, 0, labels);
+	if (r < 0) {
+		fail("labels", "failed");
+		return;
+	}
+	if (check_clusters("labels", &input, &truth, labels, NULL, HULLS)) {
+		return;
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		cpoint_init(&cpoints[i], input.coords[2 * i], input.coords[2 * i + 1]);
+		cpoint_ps[i] = &cpoints[i];
+	}
+	if (dbscan_cluster(cpoint_ps, input.n, input.eps, input.min_pts) < 0) {
+		fail("labels", "failed on the cpoints");
+		return;
+	}
+	for (i = 0; i < input.n; ++i) {
+		labels[i] = (int32_t) cpoints[i].cluster_id;
+	}
+	check_clusters("labels", &input, &truth, labels, NULL, HULLS);
+}
+
+
+/*
+ * A context kept from trial to trial clusters each input as a new one
+ * does, whatever it clustered before.
+ */
+static void check_context()
+{
+	int r = dbscan_context_core_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, labels, core);
+
+	check_exact("context", &input, &truth, r, labels, core);
+}
+
+
+/*
+ * A context on an allocator clusters as one on malloc does, takes its
+ * memory from the allocator, and gives all of it back.
+ */
+static void check_allocator()
+{
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	dbscan_context_p actx = dbscan_context_create_with(&a);
+	int r;
+
+	if (!actx) {
+		fail("allocator", "no context");
+		return;
+	}
+
+	r = dbscan_context_core_labels(actx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, labels, core);
+	check_exact("allocator", &input, &truth, r, labels, core);
+	if (dbscan_context_cluster_labels(actx, input.coords, 0, input.n, input.eps,
+			input.min_pts, 0, labels) < 0) {
+		fail("allocator", "failed");
+	}
+
+	dbscan_context_destroy(actx);
+	if (!counter.calls || counter.bytes) {
+		fail("allocator", "memory not taken from the allocator, or not given back");
+	}
+}
+
+
+/*
+ * Each clustering of a sweep, derived from the neighbours at the largest
+ * eps, is a clustering of DBSCAN at its own eps and min_pts.
+ */
+static void check_sweep()
+{
+	static input_t swept;
+	static truth_t swept_truth;
+	static int32_t sweep_labels[3 * POINTS_MAX];
+	dbscan_params_t params[3] = {
+		{ input.eps, input.min_pts },
+		{ input.eps / 2, input.min_pts },
+		{ input.eps * 0.75, input.min_pts + 2 }
+	};
+	int clusters[3];
+	size_t k;
+
+	if (dbscan_sweep_labels(input.coords, 0, input.n, params, 3, 0, sweep_labels, clusters)) {
+		fail("sweep", "failed");
+		return;
+	}
+
+	memcpy(&swept, &input, sizeof(input_t));
+	for (k = 0; k < 3; ++k) {
+		swept.eps = params[k].eps;
+		swept.min_pts = params[k].min_pts;
+		make_truth(&swept, swept.weights, &swept_truth);
+		if (check_clusters("sweep", &swept, &swept_truth, sweep_labels + input.n * k, NULL, 0)) {
+			return;
+		}
+	}
+}
+
+
+/*
+ * Clustering a file tile by tile, a few dozen points to a tile, finds the
+ * clusters of DBSCAN, and a point past the end of its record is refused.
+ */
+static void check_file()
+{
+	size_t mem_bytes = 64 * 256;
+	int r;
+
+	if (write_points("file", &input, sizeof(double), 3 * sizeof(double))) {
+		return;
+	}
+	r = dbscan_cluster_file(POINTS_PATH, sizeof(double), 3 * sizeof(double), input.eps, input.min_pts,
+			0, mem_bytes, LABELS_PATH);
+	if (r < 0) {
+		fail("file", "failed");
+		return;
+	}
+	if (read_labels("file", input.n, labels)
+			|| check_clusters("file", &input, &truth, labels, NULL, NOISE_ZERO)) {
+		return;
+	}
+
+	if (dbscan_cluster_file(POINTS_PATH, 2 * sizeof(double), 3 * sizeof(double), input.eps, input.min_pts,
+				0, mem_bytes, LABELS_PATH) != -1
+			|| dbscan_cluster_file(POINTS_PATH, 4 * sizeof(double), 3 * sizeof(double), input.eps, input.min_pts,
+				0, mem_bytes, LABELS_PATH) != -1) {
+		fail("file", "point past the end of its record accepted");
+	}
+}
+
+
+/*
+ * The canonical labels are the ones of DBSCAN, however the points are
+ * searched in, and through the cpoint_p interface too.
+ */
+static void check_canonical()
+{
+	static cpoint_t cpoints[POINTS_MAX];
+	static cpoint_p cpoint_ps[POINTS_MAX];
+	const int flags[3] = { 0, DBSCAN_SFC_ORDER, DBSCAN_NBGRAPH };
+	size_t i, k;
+	int r;
+
+	for (k = 0; k < 3; ++k) {
+		r = dbscan_cluster_labels(input.coords, 0, input.n, input.eps, input.min_pts,
+				DBSCAN_CANONICAL | flags[k], labels);
+		if (check_exact("canonical", &input, &truth, r, labels, NULL)) {
+			return;
+		}
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		cpoint_init(&cpoints[i], input.coords[2 * i], input.coords[2 * i + 1]);
+		cpoint_ps[i] = &cpoints[i];
+	}
+	r = dbscan_cluster_ex(cpoint_ps, input.n, input.eps, input.min_pts, DBSCAN_CANONICAL);
+	if (r != truth.n_clusters) {
+		fail("canonical", "not the clusters of DBSCAN on the cpoints");
+		return;
+	}
+	for (i = 0; i < input.n; ++i) {
+		if (cpoints[i].cluster_id != (unsigned long) truth.canonical[i]) {
+			fail("canonical", "not the labels of DBSCAN on the cpoints");
+			return;
+		}
+	}
+}
+
+
+/*
+ * Check the statistics against the ones of the n points.
+ *
+ * Returns: 0 if they are theirs;
+ *         -1 if not, failing the check.
+ */
+static int check_stats(const char *check, const dbscan_stats_t *stats, const point_t *pts, size_t n)
+{
+	point_t sum = { .x = 0.0, .y = 0.0 };
+	rect_t rect;
+	double m2 = 0.0;
+	size_t i;
+
+	if (stats->size != n) {
+		fail(check, "not the size of the cluster");
+		return -1;
+	}
+	for (i = 0; i < n; ++i) {
+		sum.x += pts[i].x;
+		sum.y += pts[i].y;
+		if (!i) {
+			rect_init_point(&rect, (point_p) &pts[i]);
+		} else {
+			rect_enlarge_to(&rect, (point_p) &pts[i]);
+		}
+	}
+	sum.x /= (double) n;
+	sum.y /= (double) n;
+	for (i = 0; i < n; ++i) {
+		m2 += (pts[i].x - sum.x) * (pts[i].x - sum.x) + (pts[i].y - sum.y) * (pts[i].y - sum.y);
+	}
+
+	if (fabs(stats->centroid.x - sum.x) > 1e-9 || fabs(stats->centroid.y - sum.y) > 1e-9
+			|| fabs(stats->m2 - m2) > 1e-9 * (1.0 + m2)) {
+		fail(check, "not the centroid of the cluster");
+		return -1;
+	}
+	if (memcmp(&stats->rect, &rect, sizeof(rect_t))) {
+		fail(check, "not the rect of the cluster");
+		return -1;
+	}
+	return check_hull(check, stats->hull, stats->hull_size, pts, n);
+}
+
+
+/*
+ * The statistics kept of the clusters of DBSCAN are the ones of their
+ * points, and two merged are the ones of both.
+ */
+static void check_stats_of()
+{
+	static point_t pts[POINTS_MAX];
+	static point_t hull[2 * POINTS_MAX];
+	const dbscan_stats_t *stats;
+	dbscan_stats_t merged;
+	size_t i, k, m, n_stats = 0;
+	int r = dbscan_context_cluster_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL | DBSCAN_STATS, labels);
+
+	if (check_exact("stats", &input, &truth, r, labels, NULL)) {
+		return;
+	}
+	stats = dbscan_context_stats(ctx, &n_stats);
+	if (!stats || n_stats != (size_t) r) {
+		fail("stats", "not the statistics of the clusters");
+		return;
+	}
+
+	for (k = 0; k < n_stats; ++k) {
+		for (i = m = 0; i < input.n; ++i) {
+			if (labels[i] == (int32_t) k + 1) {
+				pts[m].x = input.coords[2 * i];
+				pts[m++].y = input.coords[2 * i + 1];
+			}
+		}
+		if (check_stats("stats", &stats[k], pts, m)) {
+			return;
+		}
+	}
+
+	/* the first two clusters merged */
+	if (n_stats < 2) {
+		return;
+	}
+	merged = stats[0];
+	if (dbscan_stats_merge(&merged, &stats[1], hull)) {
+		fail("stats", "merge failed");
+		return;
+	}
+	for (i = m = 0; i < input.n; ++i) {
+		if (labels[i] == 1 || labels[i] == 2) {
+			pts[m].x = input.coords[2 * i];
+			pts[m++].y = input.coords[2 * i + 1];
+		}
+	}
+	check_stats("stats merged", &merged, pts, m);
+}
+
+
+/*
+ * A small input, whose neighbours are scanned for, is clustered the same
+ * when searched in a kd-tree, points far from it being added after it past
+ * the number of pointsets scanned.
+ */
+static void check_scan()
+{
+	static double padded[2 * (POINTS_MAX + PAD_POINTS)];
+	static int32_t padded_labels[POINTS_MAX + PAD_POINTS];
+	static unsigned char padded_core[POINTS_MAX + PAD_POINTS];
+	size_t i, n = input.n + PAD_POINTS;
+	int r, s;
+
+	memcpy(padded, input.coords, sizeof(double) * 2 * input.n);
+	for (i = 0; i < PAD_POINTS; ++i) {
+		padded[2 * (input.n + i)] = 10.0 + (double) (i % 50);
+		padded[2 * (input.n + i) + 1] = 10.0 + (double) (i / 50);
+	}
+
+	r = dbscan_context_core_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, labels, core);
+	s = dbscan_context_core_labels(ctx, padded, 0, n, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, padded_labels, padded_core);
+	if (check_exact("scan", &input, &truth, r, labels, core)) {
+		return;
+	}
+	if (s != r + (input.min_pts == 1 ? PAD_POINTS : 0)
+			|| memcmp(padded_labels, labels, sizeof(int32_t) * input.n)
+			|| memcmp(padded_core, core, input.n)) {
+		fail("scan", "not the labels of the kd-tree");
+	}
+}
+
+
+/*
+ * Sampling all the points clusters as DBSCAN does, and sampling half of
+ * them finds core points of DBSCAN, none of two of its clusters in the same
+ * cluster.
+ */
+static void check_sample()
+{
+	static unsigned int first_of[POINTS_MAX + 1];
+	size_t i;
+	int r = dbscan_context_sample_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			1.0, 0, labels, core);
+
+	if (r != truth.n_clusters) {
+		fail("sample", "not the clusters of DBSCAN");
+		return;
+	}
+	if (check_clusters("sample", &input, &truth, labels, core, NOISE_ZERO | CORE_FLAGS)) {
+		return;
+	}
+
+	r = dbscan_context_sample_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			0.5, 0, labels, core);
+	if (r < 0) {
+		fail("sample", "failed");
+		return;
+	}
+	for (i = 0; i <= (size_t) r; ++i) {
+		first_of[i] = (unsigned int) -1;
+	}
+	for (i = 0; i < input.n; ++i) {
+		if (labels[i] < 0 || labels[i] > r || (core[i] && (!truth.core[i] || !labels[i]))) {
+			fail("sample", "not a core point of DBSCAN");
+			return;
+		}
+		if (!core[i]) {
+			continue;
+		}
+		if (first_of[labels[i]] == (unsigned int) -1) {
+			first_of[labels[i]] = truth.first[i];
+		} else if (first_of[labels[i]] != truth.first[i]) {
+			fail("sample", "two clusters merged");
+			return;
+		}
+	}
+}
+
+
+/*
+ * The points weighing their weights are clustered as DBSCAN clusters them
+ * weighed, the weights being quarters so that they add up exactly in any
+ * order.
+ */
+static void check_weighted()
+{
+	static double weights[POINTS_MAX];
+	static truth_t weighed;
+	size_t i;
+	int r;
+
+	for (i = 0; i < input.n; ++i) {
+		weights[i] = 0.25 * (double) (1 + random_next() % 8);
+	}
+	make_truth(&input, weights, &weighed);
+
+	r = dbscan_context_weighted_labels(ctx, input.coords, 0, input.n, weights, input.eps, input.min_pts,
+			DBSCAN_CANONICAL, labels);
+	if (check_exact("weighted", &input, &weighed, r, labels, NULL)) {
+		return;
+	}
+
+	r = dbscan_weighted_labels(input.coords, 0, input.n, weights, input.eps, input.min_pts,
+			DBSCAN_NBGRAPH, labels);
+	if (r < 0) {
+		fail("weighted", "failed");
+		return;
+	}
+	check_clusters("weighted", &input, &weighed, labels, NULL, 0);
+}
+
+
+/*
+ * Input with runs of the same point next to each other, as from stationary
+ * devices, and copies far apart, is clustered as DBSCAN does, each run
+ * labelled as one point.
+ */
+static void check_duplicates()
+{
+	static input_t runs;
+	static truth_t runs_truth;
+	size_t i, k;
+	int r;
+
+	runs = input;
+	runs.n = 0;
+	for (i = 0; i < input.n && runs.n < POINTS_MAX; ++i) {
+		size_t at = random_uniform() < 0.2 ? (size_t) (random_next() % input.n) : i;
+		size_t length = 1 + random_next() % 8;
+
+		for (k = 0; k < length && runs.n < POINTS_MAX; ++k, ++runs.n) {
+			runs.coords[2 * runs.n] = input.coords[2 * at];
+			runs.coords[2 * runs.n + 1] = input.coords[2 * at + 1];
+			runs.weights[runs.n] = 1.0;
+		}
+	}
+	make_truth(&runs, runs.weights, &runs_truth);
+
+	r = dbscan_context_core_labels(ctx, runs.coords, 0, runs.n, runs.eps, runs.min_pts,
+			DBSCAN_CANONICAL, labels, core);
+	if (check_exact("duplicates", &runs, &runs_truth, r, labels, core)) {
+		return;
+	}
+
+	r = dbscan_context_cluster_labels(ctx, runs.coords, 0, runs.n, runs.eps, runs.min_pts,
+			DBSCAN_NBGRAPH, labels);
+	if (r < 0) {
+		fail("duplicates", "failed");
+		return;
+	}
+	if (check_clusters("duplicates", &runs, &runs_truth, labels, NULL, 0) || !runs.n) {
+		return;
+	}
+
+	r = dbscan_context_cluster_labels(ctx, runs.coords, 0, runs.n, runs.eps, runs.min_pts, 0, labels);
+	if (r < 0) {
+		fail("duplicates", "failed");
+		return;
+	}
+	if (check_clusters("duplicates", &runs, &runs_truth, labels, NULL, HULLS)) {
+		return;
+	}
+	for (i = 1; i < runs.n; ++i) {
+		if (!dist(runs.coords, i - 1, i) && labels[i - 1] != labels[i]) {
+			fail("duplicates", "run of a point split");
+			return;
+		}
+	}
+}
+
+
+/*
+ * The points of the grid in fixed point, GRID units to 1 and shifted to
+ * negative ones too, are clustered as DBSCAN does, the scaled distances
+ * being the same to the last bit.
+ */
+static void check_fixed()
+{
+	static int32_t fixed[3 * POINTS_MAX];
+	size_t i;
+	int r;
+
+	if (!input.on_grid) {
+		return;
+	}
+	for (i = 0; i < input.n; ++i) {
+		fixed[3 * i] = (int32_t) (input.coords[2 * i] * GRID) - (int32_t) GRID / 2;
+		fixed[3 * i + 1] = (int32_t) (input.coords[2 * i + 1] * GRID) - (int32_t) GRID / 2;
+		fixed[3 * i + 2] = (int32_t) i;
+	}
+
+	/* records of 3 int32_t first */
+	r = dbscan_context_fixed_labels(ctx, fixed, 3 * sizeof(int32_t), input.n, input.eps * GRID,
+			input.min_pts, DBSCAN_CANONICAL, labels);
+	if (check_exact("fixed", &input, &truth, r, labels, NULL)) {
+		return;
+	}
+
+	/* then the points packed */
+	for (i = 0; i < input.n; ++i) {
+		fixed[2 * i] = fixed[3 * i];
+		fixed[2 * i + 1] = fixed[3 * i + 1];
+	}
+	r = dbscan_fixed_labels(fixed, 0, input.n, input.eps * GRID, input.min_pts, DBSCAN_CANONICAL, labels);
+	check_exact("fixed packed", &input, &truth, r, labels, NULL);
+}
+
+
+/*
+ * No points make no clusters, whatever the engine the flags pick.
+ */
+static void check_empty()
+{
+	static const int flags[] = { 0, DBSCAN_SFC_ORDER, DBSCAN_NBGRAPH, DBSCAN_CANONICAL, DBSCAN_STATS,
+			DBSCAN_PLANE_SWEEP };
+	double coords[2] = { 0.0, 0.0 }, weights[1] = { 1.0 };
+	int32_t fixed[2] = { 0, 0 };
+	cpoint_t point;
+	cpoint_p points[1] = { &point };
+	size_t i;
+
+	for (i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+		if (dbscan_cluster_ex(points, 0, 0.1, 2, flags[i]) != 0
+				|| dbscan_context_cluster_labels(ctx, coords, 0, 0, 0.1, 2, flags[i], labels) != 0
+				|| dbscan_context_core_labels(ctx, coords, 0, 0, 0.1, 2, flags[i], labels, core) != 0
+				|| dbscan_context_sample_labels(ctx, coords, 0, 0, 0.1, 2, 0.5, flags[i], labels, core) != 0
+				|| dbscan_context_weighted_labels(ctx, coords, 0, 0, weights, 0.1, 2, flags[i], labels) != 0
+				|| dbscan_context_fixed_labels(ctx, fixed, 0, 0, 10, 2, flags[i], labels) != 0) {
+			fail("empty", "no points not clustered as no clusters");
+		}
+	}
+}
+
+
+/*
+ * Run one of the entry points of a context, 0 to STEADY_ENTRIES - 1, with
+ * the flags, over the input.
+ *
+ * returns: the result of the entry point
+ */
+#define STEADY_ENTRIES 9
+static int run_entry(dbscan_context_p c, int entry, int flags)
+{
+	static cpoint_t cpoints[POINTS_MAX];
+	static cpoint_p cpoint_ps[POINTS_MAX];
+	static int32_t fixed[2 * POINTS_MAX];
+	static int32_t sweep_labels[2 * POINTS_MAX];
+	static unsigned int order[POINTS_MAX];
+	static double core_dist[POINTS_MAX], reach[POINTS_MAX];
+	dbscan_params_t params[2] = { { input.eps, input.min_pts }, { input.eps / 2, input.min_pts + 1 } };
+	int clusters[2];
+	size_t i;
+
+	switch (entry) {
+	case 0:
+		for (i = 0; i < input.n; ++i) {
+			cpoint_init(&cpoints[i], input.coords[2 * i], input.coords[2 * i + 1]);
+			cpoint_ps[i] = &cpoints[i];
+		}
+		return dbscan_context_cluster(c, cpoint_ps, input.n, input.eps, input.min_pts, flags);
+	case 1:
+		return dbscan_context_cluster_labels(c, input.coords, 0, input.n, input.eps, input.min_pts, flags, labels);
+	case 2:
+		return dbscan_context_core_labels(c, input.coords, 0, input.n, input.eps, input.min_pts, flags,
+				labels, core);
+	case 3:
+		return dbscan_context_weighted_labels(c, input.coords, 0, input.n, input.weights, input.eps,
+				input.min_pts, flags, labels);
+	case 4:
+		for (i = 0; i < 2 * input.n; ++i) {
+			fixed[i] = (int32_t) (input.coords[i] * GRID);
+		}
+		return dbscan_context_fixed_labels(c, fixed, 0, input.n, input.eps * GRID, input.min_pts, flags, labels);
+	case 5:
+		return dbscan_context_sample_labels(c, input.coords, 0, input.n, input.eps, input.min_pts, 0.5, flags,
+				labels, core);
+	case 6:
+		return dbscan_context_sweep_labels(c, input.coords, 0, input.n, params, 2, flags, sweep_labels, clusters);
+	case 7:
+		return dbscan_context_optics(c, input.coords, 0, input.n, input.eps, input.min_pts, flags,
+				order, core_dist, reach);
+	default:
+		return dbscan_context_sample_labels(c, input.coords, 0, input.n, input.eps, input.min_pts, 1.0, flags,
+				labels, core);
+	}
+}
+
+
+/*
+ * Clustering the same input again in a context takes no memory, whatever
+ * the entry point and the flags, as the context keeps the memory of the
+ * first clustering.
+ */
+static void check_steady()
+{
+	static const int flags[] = { 0, DBSCAN_SFC_ORDER, DBSCAN_NBGRAPH, DBSCAN_CANONICAL, DBSCAN_STATS,
+			DBSCAN_PLANE_SWEEP };
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	dbscan_context_p sctx = dbscan_context_create_with(&a);
+	size_t i, calls;
+	int entry;
+
+	if (!sctx) {
+		fail("steady", "no context");
+		return;
+	}
+
+	for (entry = 0; entry < STEADY_ENTRIES; ++entry) {
+		for (i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+			if (run_entry(sctx, entry, flags[i]) < 0) {
+				fail("steady", "failed");
+				break;
+			}
+			calls = counter.calls;
+			if (run_entry(sctx, entry, flags[i]) < 0) {
+				fail("steady", "failed again");
+				break;
+			}
+			if (counter.calls != calls) {
+				fprintf(stderr, "entry %d, flags %d: ", entry, flags[i]);
+				fail("steady", "memory taken again for the same input");
+				break;
+			}
+		}
+	}
+
+	dbscan_context_destroy(sctx);
+}
+
+
+int main()
+{
+	ctx = dbscan_context_create();
+	if (!ctx) {
+		perror(NULL);
+		return 1;
+	}
+
+	check_empty();
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_sfc_order();
+		check_labels();
+		check_context();
+		check_allocator();
+		check_sweep();
+		check_file();
+		check_canonical();
+		check_stats_of();
+		check_scan();
+		check_sample();
+		check_weighted();
+		check_duplicates();
+		check_fixed();
+		check_steady();
+	}
+
+	dbscan_context_destroy(ctx);
+	remove(POINTS_PATH);
+	remove(LABELS_PATH);
+	return check_done("dbscan-test");
+}
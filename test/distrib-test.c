@@ -0,0 +1,34 @@
+/* Checks of the clustering in worker processes against a brute-force DBSCAN, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "distrib.h"
+#include "check.h"
+
+
+/*
+ * Clustering in worker processes gives the canonical labels of DBSCAN,
+ * whatever the number of workers.
+ */
+static void check_distrib()
+{
+	static int32_t labels[POINTS_MAX];
+	unsigned int workers = (unsigned int) (trial % 4);
+	int r = distrib_cluster_labels(input.coords, 0, input.n, input.eps, input.min_pts, 0, workers, labels);
+
+	check_exact("distrib", &input, &truth, r, labels, NULL);
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_distrib();
+	}
+	return check_done("distrib-test");
+}
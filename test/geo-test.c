@@ -0,0 +1,71 @@
+/* Checks of the convex hulls against the points they hold, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "geo.h"
+#include "check.h"
+
+
+/* points of the input the hulls are found of */
+#define HULL_POINTS 500
+
+
+/*
+ * The convex hull of points, found at once, from sorted points, or point by
+ * point, is their hull.
+ */
+static void check_convex_hull()
+{
+	static point_t pts[HULL_POINTS];
+	static point_p list[HULL_POINTS], hull_ps[HULL_POINTS + 1];
+	static point_t hull[HULL_POINTS + 1];
+	size_t i, h, n = input.n < HULL_POINTS ? input.n : HULL_POINTS;
+
+	for (i = 0; i < n; ++i) {
+		pts[i].x = input.coords[2 * i];
+		pts[i].y = input.coords[2 * i + 1];
+		list[i] = &pts[i];
+	}
+
+	h = convex_hull(list, n, hull_ps);
+	for (i = 0; i < h; ++i) {
+		hull[i] = *hull_ps[i];
+	}
+	if (check_hull("convex_hull", hull, h, pts, n)) {
+		return;
+	}
+
+	/* the points are sorted now */
+	h = convex_hull_sorted(list, n, hull_ps);
+	for (i = 0; i < h; ++i) {
+		hull[i] = *hull_ps[i];
+	}
+	if (check_hull("convex_hull_sorted", hull, h, pts, n)) {
+		return;
+	}
+
+	for (i = 0; i < n; ++i) {
+		list[i] = &pts[i];
+	}
+	h = 0;
+	for (i = 0; i < n; ++i) {
+		h = convex_hull_insert(hull_ps, h, list[i]);
+	}
+	for (i = 0; i < h; ++i) {
+		hull[i] = *hull_ps[i];
+	}
+	check_hull("convex_hull_insert", hull, h, pts, n);
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+
+		check_convex_hull();
+	}
+	return check_done("geo-test");
+}
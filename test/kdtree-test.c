@@ -0,0 +1,217 @@
+/* Checks of the searches of the kd-tree against brute-force ones, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "geo.h"
+#include "array.h"
+#include "kdtree.h"
+#include "check.h"
+
+
+/* the file of the snapshot, in the working directory */
+#define SNAPSHOT_PATH "kdtree-test.kdtree"
+
+/* points searched for each trial */
+#define QUERIES 100
+
+
+/*
+ * A snapshot opened back finds the neighbours and the nearest point a
+ * brute-force search finds, with the indexes they were saved with, each
+ * place once as the tree keeps one point of each, and a snapshot with a
+ * child before its parent is refused.
+ */
+static void check_snapshot()
+{
+	static point_p points[POINTS_MAX];
+	static unsigned char found[POINTS_MAX];
+	const point_t *base = (const point_t *) input.coords;
+	double thre = input.eps * input.eps;
+	kdtree_p tree = NULL, opened = NULL;
+	array_p result = NULL;
+	size_t i, j, k;
+	uint32_t zero = 0;
+	FILE *file;
+
+#define FREEALL()\
+	{\
+		kdtree_destroy(tree); tree = NULL;\
+		kdtree_destroy(opened); opened = NULL;\
+		array_destroy(result); result = NULL;\
+	}
+
+	/* an empty tree isn't saved */
+	if (!input.n) {
+		return;
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		points[i] = (point_p) &base[i];
+	}
+	tree = kdtree_create_static(points, input.n);
+	result = array_create(16);
+	if (!tree || !result || kdtree_save(tree, SNAPSHOT_PATH, base, 0)) {
+		fail("snapshot", "can't save the tree");
+		FREEALL();
+		return;
+	}
+	opened = kdtree_open(SNAPSHOT_PATH);
+	if (!opened) {
+		fail("snapshot", "can't open the snapshot");
+		FREEALL();
+		return;
+	}
+
+	for (k = 0; k < QUERIES && k < input.n; ++k) {
+		point_t q = base[(size_t) (random_next() % input.n)];
+		point_p nearest;
+		double best = INFINITY, d;
+
+		q.x += (random_uniform() - 0.5) * input.eps;
+		q.y += (random_uniform() - 0.5) * input.eps;
+		for (i = 0; i < input.n; ++i) {
+			d = (base[i].x - q.x) * (base[i].x - q.x) + (base[i].y - q.y) * (base[i].y - q.y);
+			found[i] = d <= thre;
+			best = d < best ? d : best;
+		}
+
+		array_truncate(result, 0);
+		if (kdtree_neighbours(opened, &q, thre, result)) {
+			fail("snapshot", "failed");
+			break;
+		}
+		for (j = 0; j < array_size(result); ++j) {
+			void *found_point = NULL;
+			long id = array_at(result, (unsigned int) j, &found_point) ? -1
+				: kdtree_point_id(opened, (point_p) found_point);
+
+			if (id < 0 || (size_t) id >= input.n || !found[id]) {
+				fail("snapshot", "not a neighbour");
+				break;
+			}
+			for (i = 0; i < input.n; ++i) {
+				found[i] &= base[i].x != base[id].x || base[i].y != base[id].y;
+			}
+		}
+		for (i = 0; i < input.n && !found[i]; ++i);
+		if (i < input.n) {
+			fail("snapshot", "neighbour not found");
+			break;
+		}
+
+		nearest = kdtree_nearest_neighbour(opened, &q);
+		if (!nearest || (nearest->x - q.x) * (nearest->x - q.x) + (nearest->y - q.y) * (nearest->y - q.y) != best) {
+			fail("snapshot", "not the nearest point");
+			break;
+		}
+	}
+	kdtree_destroy(opened);
+	opened = NULL;
+
+	/* the child indexes follow the point of a node, the last node being a leaf */
+	file = fopen(SNAPSHOT_PATH, "r+b");
+	if (!file || fseek(file, -(long) (sizeof(point_t) + 4 * sizeof(uint32_t)) + (long) sizeof(point_t), SEEK_END)
+			|| fwrite(&zero, sizeof(uint32_t), 1, file) != 1) {
+		fail("snapshot", "can't corrupt the snapshot");
+	}
+	if (file) {
+		fclose(file);
+	}
+	opened = kdtree_open(SNAPSHOT_PATH);
+	if (opened) {
+		fail("snapshot", "child before its parent accepted");
+	}
+	FREEALL();
+#undef FREEALL
+}
+
+
+/*
+ * Filter of check_filter, keeping the points left of x = *arg.
+ */
+static int left_of(point_p point, void *arg)
+{
+	return point->x < *(double *) arg;
+}
+
+
+/*
+ * A search through a filter, as the noise is grouped, finds the points a
+ * brute-force search passing the filter finds, each place once.
+ */
+static void check_filter()
+{
+	static point_p points[POINTS_MAX];
+	static unsigned char found[POINTS_MAX];
+	const point_t *base = (const point_t *) input.coords;
+	double thre = input.eps * input.eps, left = random_uniform();
+	kdtree_p tree = NULL;
+	array_p result = NULL;
+	size_t i, j, k;
+
+	if (!input.n) {
+		return;
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		points[i] = (point_p) &base[i];
+	}
+	tree = kdtree_create_static(points, input.n);
+	result = array_create(16);
+	if (!tree || !result) {
+		fail("filter", "no tree");
+		kdtree_destroy(tree);
+		array_destroy(result);
+		return;
+	}
+
+	for (k = 0; k < QUERIES && k < input.n; ++k) {
+		point_p q = (point_p) &base[(size_t) (random_next() % input.n)];
+
+		for (i = 0; i < input.n; ++i) {
+			found[i] = dist(input.coords, i, (size_t) (q - base)) <= thre && base[i].x < left;
+		}
+
+		array_truncate(result, 0);
+		if (kdtree_neighbours_filter(tree, q, thre, left_of, &left, result)) {
+			fail("filter", "failed");
+			break;
+		}
+		for (j = 0; j < array_size(result); ++j) {
+			void *p = NULL;
+			size_t at = array_at(result, (unsigned int) j, &p) ? input.n : (size_t) ((point_p) p - base);
+
+			if (at >= input.n || !found[at]) {
+				fail("filter", "not a neighbour passing the filter");
+				break;
+			}
+			for (i = 0; i < input.n; ++i) {
+				found[i] &= base[i].x != base[at].x || base[i].y != base[at].y;
+			}
+		}
+		for (i = 0; i < input.n && !found[i]; ++i);
+		if (i < input.n) {
+			fail("filter", "neighbour passing the filter not found");
+			break;
+		}
+	}
+	kdtree_destroy(tree);
+	array_destroy(result);
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+
+		check_snapshot();
+		check_filter();
+	}
+
+	remove(SNAPSHOT_PATH);
+	return check_done("kdtree-test");
+}
@@ -0,0 +1,94 @@
+/* Checks of the model of a clustering against a brute-force search, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "model.h"
+#include "check.h"
+
+
+/* points assigned each trial */
+#define QUERIES 100
+
+
+/*
+ * The model of the clustering of DBSCAN assigns a point to the cluster of
+ * its nearest core point within eps, or to the noise, alone or in a batch.
+ */
+static void check_model()
+{
+	static double queries[2 * QUERIES];
+	static int32_t assigned[QUERIES];
+	static int32_t expected[QUERIES];
+	double thre = input.eps * input.eps;
+	size_t i, k, n_core = 0;
+	model_p model = model_create(input.coords, 0, input.n, truth.canonical, truth.core, input.eps);
+
+	if (!model) {
+		fail("model", "no model");
+		return;
+	}
+	for (i = 0; i < input.n; ++i) {
+		n_core += truth.core[i];
+	}
+	if (model_size(model) != n_core) {
+		fail("model", "not the core points");
+	}
+
+	for (k = 0; k < QUERIES; ++k) {
+		size_t at = input.n ? (size_t) (random_next() % input.n) : 0;
+		double best = INFINITY;
+
+		queries[2 * k] = input.n ? input.coords[2 * at] : random_uniform();
+		queries[2 * k + 1] = input.n ? input.coords[2 * at + 1] : random_uniform();
+		if (k % 2) {
+			queries[2 * k] += (random_uniform() - 0.5) * 3 * input.eps;
+			queries[2 * k + 1] += (random_uniform() - 0.5) * 3 * input.eps;
+		}
+
+		/* the nearest of the core points at the same distance being any of them */
+		expected[k] = 0;
+		for (i = 0; i < input.n; ++i) {
+			double dx = input.coords[2 * i] - queries[2 * k], dy = input.coords[2 * i + 1] - queries[2 * k + 1];
+			double d = dx * dx + dy * dy;
+
+			if (truth.core[i] && d <= thre && d <= best) {
+				expected[k] = d < best || expected[k] == truth.canonical[i] ? truth.canonical[i] : -1;
+				best = d;
+			}
+		}
+	}
+
+	if (model_assign_batch(model, queries, 0, QUERIES, assigned, 2)) {
+		fail("model", "failed");
+		model_destroy(model);
+		return;
+	}
+	for (k = 0; k < QUERIES; ++k) {
+		int32_t one = model_assign(model, queries[2 * k], queries[2 * k + 1]);
+
+		if (one != assigned[k]) {
+			fail("model", "not the cluster of the batch");
+			break;
+		}
+		if (expected[k] >= 0 ? one != expected[k] : !one) {
+			fail("model", "not the cluster of the nearest core point");
+			break;
+		}
+	}
+	model_destroy(model);
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_model();
+	}
+	return check_done("model-test");
+}
@@ -0,0 +1,121 @@
+/* Checks of the clustering over the neighbour graph against a brute-force DBSCAN, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "dbscan.h"
+#include "nbgraph.h"
+#include "check.h"
+
+
+/*
+ * Compare two points by x, then y.
+ */
+static int compare_points(const void *a, const void *b)
+{
+	const point_t *p = (const point_t *) a, *q = (const point_t *) b;
+
+	if (p->x != q->x) {
+		return p->x < q->x ? -1 : 1;
+	}
+	return p->y < q->y ? -1 : p->y > q->y;
+}
+
+
+/*
+ * Tell whether two graphs have the same edges, and the same distances.
+ */
+static int same_graph(nbgraph_p g, nbgraph_p h)
+{
+	size_t edges = g->offsets[g->n];
+
+	return g->n == h->n && !memcmp(g->offsets, h->offsets, sizeof(size_t) * (g->n + 1))
+			&& (!edges || (!memcmp(g->adj, h->adj, sizeof(unsigned int) * edges)
+			&& !memcmp(g->dist, h->dist, sizeof(double) * edges)));
+}
+
+
+/*
+ * Expanding the clusters over the neighbour graph finds the clusters of
+ * DBSCAN, none split, as the convex hulls may split them.
+ */
+static void check_nbgraph()
+{
+	static int32_t labels[POINTS_MAX];
+	int r;
+
+	r = dbscan_cluster_labels(input.coords, 0, input.n, input.eps, input.min_pts, DBSCAN_NBGRAPH, labels);
+	if (r < 0) {
+		fail("nbgraph", "failed");
+		return;
+	}
+	check_clusters("nbgraph", &input, &truth, labels, NULL, 0);
+}
+
+
+/*
+ * A graph built on an allocator is the one created on malloc, built again
+ * over the same points it takes no more memory, and it gives all of it back.
+ */
+static void check_build()
+{
+	static point_t points[POINTS_MAX];
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	nbgraph_p graph = nbgraph_create_with(&a), created = NULL;
+	size_t i, n = 0, calls;
+	double thre = input.eps * input.eps;
+
+	if (!graph) {
+		fail("build", "no graph");
+		return;
+	}
+
+	/* the points without their copies */
+	for (i = 0; i < input.n; ++i) {
+		point_init(&points[i], input.coords[2 * i], input.coords[2 * i + 1]);
+	}
+	qsort(points, input.n, sizeof(point_t), compare_points);
+	for (i = 0; i < input.n; ++i) {
+		if (!n || compare_points(&points[n - 1], &points[i])) {
+			points[n++] = points[i];
+		}
+	}
+
+	created = nbgraph_create(points, sizeof(point_t), n, thre, NBGRAPH_KEEP_DIST);
+	if (!created || nbgraph_build(graph, points, sizeof(point_t), n, thre, NBGRAPH_KEEP_DIST, 3)) {
+		fail("build", "failed");
+	} else if (!same_graph(created, graph)) {
+		fail("build", "not the graph created on malloc");
+	} else {
+		calls = counter.calls;
+		if (nbgraph_build(graph, points, sizeof(point_t), n, thre, NBGRAPH_KEEP_DIST, 3)) {
+			fail("build", "failed again");
+		} else if (!same_graph(created, graph)) {
+			fail("build", "not the graph built before");
+		} else if (counter.calls != calls) {
+			fail("build", "memory taken again");
+		}
+	}
+
+	nbgraph_destroy(created);
+	nbgraph_destroy(graph);
+	if (counter.bytes) {
+		fail("build", "memory not given back");
+	}
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_nbgraph();
+		check_build();
+	}
+	return check_done("nbgraph-test");
+}
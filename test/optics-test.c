@@ -0,0 +1,105 @@
+/* Checks of the OPTICS ordering against a brute-force DBSCAN, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "dbscan.h"
+#include "check.h"
+
+
+/*
+ * The clustering extracted from the OPTICS ordering at its eps has the core
+ * points and clusters of DBSCAN, and the copies of a point are in the same
+ * cluster, e.g. the two last points of
+ * (0, 0) (0.1, 0) (0.2, 0) (0.3, 0) (1.25, 0) (1.25, 0), at eps 1 and min_pts 5.
+ */
+static void check_optics()
+{
+	static unsigned int order[POINTS_MAX];
+	static double core_dist[POINTS_MAX], reach[POINTS_MAX];
+	static int32_t labels[POINTS_MAX];
+	static unsigned char core[POINTS_MAX];
+	const double line[12] = { 0, 0, 0.1, 0, 0.2, 0, 0.3, 0, 1.25, 0, 1.25, 0 };
+	size_t i, j;
+
+	if (dbscan_optics(line, 0, 6, 1.0, 5, 0, order, core_dist, reach)) {
+		fail("optics", "failed");
+		return;
+	}
+	dbscan_optics_labels(order, core_dist, reach, 6, 1.0, labels);
+	if (!labels[4] || labels[5] != labels[4]) {
+		fail("optics", "copies of a border point split");
+	}
+
+	if (dbscan_optics(input.coords, 0, input.n, input.eps, input.min_pts, 0, order, core_dist, reach)) {
+		fail("optics", "failed");
+		return;
+	}
+	for (i = 0; i < input.n; ++i) {
+		core[i] = !isinf(core_dist[i]);
+	}
+	dbscan_optics_labels(order, core_dist, reach, input.n, input.eps, labels);
+	if (check_clusters("optics", &input, &truth, labels, core, NOISE_ZERO | CORE_FLAGS | BORDER_NOISE)) {
+		return;
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		for (j = 0; j < i; ++j) {
+			if (!dist(input.coords, i, j) && labels[i] != labels[j]) {
+				fail("optics", "copies of a point split");
+				return;
+			}
+		}
+	}
+}
+
+
+/*
+ * The ordering computed in a context on an allocator is the one computed
+ * on malloc, and its memory, taken from the arena of the context, is all
+ * given back with the context.
+ */
+static void check_context()
+{
+	static unsigned int order[POINTS_MAX], order_[POINTS_MAX];
+	static double core_dist[POINTS_MAX], core_dist_[POINTS_MAX], reach[POINTS_MAX], reach_[POINTS_MAX];
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	dbscan_context_p ctx = dbscan_context_create_with(&a);
+
+	if (!ctx) {
+		fail("context", "no context");
+		return;
+	}
+
+	if (dbscan_optics(input.coords, 0, input.n, input.eps, input.min_pts, 0, order, core_dist, reach)
+			|| dbscan_context_optics(ctx, input.coords, 0, input.n, input.eps, input.min_pts, 0,
+					order_, core_dist_, reach_)) {
+		fail("context", "failed");
+	} else if (memcmp(order, order_, sizeof(unsigned int) * input.n)
+			|| memcmp(core_dist, core_dist_, sizeof(double) * input.n)
+			|| memcmp(reach, reach_, sizeof(double) * input.n)) {
+		fail("context", "not the ordering computed on malloc");
+	}
+
+	dbscan_context_destroy(ctx);
+	if (counter.bytes) {
+		fail("context", "memory not given back");
+	}
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_optics();
+		check_context();
+	}
+	return check_done("optics-test");
+}
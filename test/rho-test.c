@@ -0,0 +1,89 @@
+/* Checks of the rho-approximate clustering against a brute-force DBSCAN, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "dbscan.h"
+#include "check.h"
+
+
+/*
+ * The rho-approximate clustering with rho 0 is the one of DBSCAN, and
+ * otherwise has its core points, with clusters which are unions of its
+ * clusters at eps, each within one of its clusters at eps * (1 + rho).
+ */
+static void check_rho()
+{
+	static int32_t labels[POINTS_MAX];
+	static unsigned char core[POINTS_MAX];
+	static truth_t wide;
+	static unsigned int first_of[POINTS_MAX + 1];
+	double rho = 0.1 + random_uniform(), eps = input.eps, thre = eps * eps;
+	size_t i, j;
+	int r = dbscan_rho_labels(input.coords, 0, input.n, input.eps, input.min_pts, 0.0, labels, core);
+
+	if (r != truth.n_clusters) {
+		fail("rho", "not the clusters of DBSCAN");
+		return;
+	}
+	if (check_clusters("rho", &input, &truth, labels, core, NOISE_ZERO | CORE_FLAGS)) {
+		return;
+	}
+
+	r = dbscan_rho_labels(input.coords, 0, input.n, input.eps, input.min_pts, rho, labels, core);
+	if (r < 0 || r > truth.n_clusters) {
+		fail("rho", "not unions of the clusters of DBSCAN");
+		return;
+	}
+	input.eps = eps * (1.0 + rho);
+	make_truth(&input, input.weights, &wide);
+	input.eps = eps;
+
+	for (i = 0; i <= (size_t) r; ++i) {
+		first_of[i] = (unsigned int) -1;
+	}
+	for (i = 0; i < input.n; ++i) {
+		int reached = 0, found = 0;
+
+		if (core[i] != truth.core[i] || labels[i] < 0 || labels[i] > r) {
+			fail("rho", "not the core points of DBSCAN");
+			return;
+		}
+		if (truth.core[i]) {
+			if (!labels[i] || labels[truth.first[i]] != labels[i]) {
+				fail("rho", "cluster of DBSCAN split");
+				return;
+			}
+			if (first_of[labels[i]] == (unsigned int) -1) {
+				first_of[labels[i]] = wide.first[i];
+			} else if (first_of[labels[i]] != wide.first[i]) {
+				fail("rho", "clusters merged beyond eps * (1 + rho)");
+				return;
+			}
+			continue;
+		}
+		for (j = 0; j < input.n; ++j) {
+			if (truth.core[j] && dist(input.coords, i, j) <= thre) {
+				reached = 1;
+				found |= labels[j] == labels[i];
+			}
+		}
+		if (reached ? !found : labels[i] != 0) {
+			fail("rho", "border point out of the clusters within eps");
+			return;
+		}
+	}
+}
+
+
+int main()
+{
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_rho();
+	}
+	return check_done("rho-test");
+}
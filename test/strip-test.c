@@ -0,0 +1,220 @@
+/* Checks of the plane sweep against a brute-force DBSCAN, over random inputs. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "dbscan.h"
+#include "strip.h"
+#include "check.h"
+
+
+static int32_t labels[POINTS_MAX];
+static unsigned char core[POINTS_MAX];
+
+/* the context every trial sweeps in */
+static dbscan_context_p ctx;
+
+/* coordinates compare_xy sorts the indexes of */
+static const double *sorting;
+
+
+/*
+ * Compare the points at two indexes by x, then y, then index.
+ */
+static int compare_xy(const void *a, const void *b)
+{
+	unsigned int i = *(const unsigned int *) a, j = *(const unsigned int *) b;
+
+	if (sorting[2 * i] != sorting[2 * j]) {
+		return sorting[2 * i] < sorting[2 * j] ? -1 : 1;
+	}
+	if (sorting[2 * i + 1] != sorting[2 * j + 1]) {
+		return sorting[2 * i + 1] < sorting[2 * j + 1] ? -1 : 1;
+	}
+	return i < j ? -1 : i > j;
+}
+
+
+/*
+ * The plane sweep clusters as DBSCAN does, the clusters numbered in the x
+ * order of their first core points and a border point joining the cluster
+ * of its first core point within eps in x order, unless canonical; a file
+ * sorted by x is swept the same, and a file out of x order refused.
+ */
+static void check_plane_sweep()
+{
+	static unsigned int order[POINTS_MAX];
+	static int32_t id_of[POINTS_MAX], swept[POINTS_MAX];
+	static input_t sorted;
+	double thre = input.eps * input.eps;
+	int32_t next_id = 0;
+	size_t i, k;
+	int r;
+
+	r = dbscan_context_core_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_PLANE_SWEEP | DBSCAN_CANONICAL, labels, core);
+	if (check_exact("plane_sweep", &input, &truth, r, labels, core)) {
+		return;
+	}
+
+	/* the labels in x order */
+	for (i = 0; i < input.n; ++i) {
+		order[i] = (unsigned int) i;
+		id_of[i] = 0;
+	}
+	sorting = input.coords;
+	qsort(order, input.n, sizeof(unsigned int), compare_xy);
+	for (k = 0; k < input.n; ++k) {
+		if (truth.core[order[k]] && !id_of[truth.first[order[k]]]) {
+			id_of[truth.first[order[k]]] = ++next_id;
+		}
+	}
+	for (i = 0; i < input.n; ++i) {
+		swept[i] = truth.core[i] ? id_of[truth.first[i]] : 0;
+		for (k = 0; !truth.core[i] && k < input.n; ++k) {
+			if (truth.core[order[k]] && dist(input.coords, i, order[k]) <= thre) {
+				swept[i] = id_of[truth.first[order[k]]];
+				break;
+			}
+		}
+	}
+
+	r = dbscan_context_core_labels(ctx, input.coords, 0, input.n, input.eps, input.min_pts,
+			DBSCAN_PLANE_SWEEP, labels, core);
+	if (r != truth.n_clusters || memcmp(labels, swept, sizeof(int32_t) * input.n)) {
+		fail("plane_sweep", "not the labels of DBSCAN in x order");
+		return;
+	}
+
+	/* the points sorted into a file */
+	sorted.n = input.n;
+	for (k = 0; k < input.n; ++k) {
+		sorted.coords[2 * k] = input.coords[2 * order[k]];
+		sorted.coords[2 * k + 1] = input.coords[2 * order[k] + 1];
+	}
+	if (write_points("sorted_file", &sorted, sizeof(double), 3 * sizeof(double))) {
+		return;
+	}
+	r = dbscan_cluster_sorted_file(POINTS_PATH, sizeof(double), 3 * sizeof(double), input.eps, input.min_pts,
+			LABELS_PATH);
+	if (r != truth.n_clusters || read_labels("sorted_file", input.n, labels)) {
+		fail("sorted_file", "not the clusters of DBSCAN");
+		return;
+	}
+	for (k = 0; k < input.n; ++k) {
+		if (labels[k] != swept[order[k]]) {
+			fail("sorted_file", "not the labels of DBSCAN in x order");
+			return;
+		}
+	}
+	if (dbscan_cluster_sorted_file(POINTS_PATH, 2 * sizeof(double), 3 * sizeof(double), input.eps, input.min_pts,
+				LABELS_PATH) != -1) {
+		fail("sorted_file", "point past the end of its record accepted");
+	}
+
+	/* and as they are, if out of x order */
+	for (i = 1; i < input.n && input.coords[2 * (i - 1)] <= input.coords[2 * i]; ++i);
+	if (i >= input.n || write_points("sorted_file", &input, sizeof(double), 3 * sizeof(double))) {
+		return;
+	}
+	if (dbscan_cluster_sorted_file(POINTS_PATH, sizeof(double), 3 * sizeof(double), input.eps, input.min_pts,
+				LABELS_PATH) != -1) {
+		fail("sorted_file", "points out of x order accepted");
+	}
+}
+
+
+/*
+ * Sweep the input in x order, the points weighing 1.
+ *
+ * returns: the clusters num, or -1 if failed
+ */
+static int sweep(strip_p strip, const unsigned int *order)
+{
+	point_t p;
+	size_t k;
+
+	for (k = 0; k < input.n; ++k) {
+		point_init(&p, input.coords[2 * order[k]], input.coords[2 * order[k] + 1]);
+		if (strip_push(strip, &p, 1.0)) {
+			return -1;
+		}
+	}
+	return strip_finish(strip);
+}
+
+
+/*
+ * A sweep reset sweeps the same points again the same, on the memory of
+ * the first sweep, and a sweep on an allocator gives all of it back.
+ */
+static void check_reset()
+{
+	static unsigned int order[POINTS_MAX];
+	static int32_t first[POINTS_MAX];
+	counter_t counter = { 0, 0 };
+	allocator_t a = counter_allocator(&counter);
+	strip_p strip = strip_create_with(&a, input.eps * input.eps, (double) input.min_pts);
+	size_t i, calls;
+	int r;
+
+	if (!strip) {
+		fail("reset", "no sweep");
+		return;
+	}
+
+	for (i = 0; i < input.n; ++i) {
+		order[i] = (unsigned int) i;
+	}
+	sorting = input.coords;
+	qsort(order, input.n, sizeof(unsigned int), compare_xy);
+
+	r = sweep(strip, order);
+	for (i = 0; r >= 0 && i < input.n; ++i) {
+		first[i] = strip_label(strip, i);
+	}
+	calls = counter.calls;
+
+	strip_reset(strip, input.eps * input.eps, (double) input.min_pts);
+	if (r < 0 || sweep(strip, order) != r) {
+		fail("reset", "not the clusters of the first sweep");
+	} else if (counter.calls != calls) {
+		fail("reset", "memory taken again");
+	}
+	for (i = 0; r >= 0 && i < input.n; ++i) {
+		if (strip_label(strip, i) != first[i]) {
+			fail("reset", "not the labels of the first sweep");
+			break;
+		}
+	}
+
+	strip_destroy(strip);
+	if (counter.bytes) {
+		fail("reset", "memory not given back");
+	}
+}
+
+
+int main()
+{
+	ctx = dbscan_context_create();
+	if (!ctx) {
+		perror(NULL);
+		return 1;
+	}
+
+	for (trial = 0; trial < TRIALS; ++trial) {
+		make_input(&input);
+		make_truth(&input, input.weights, &truth);
+
+		check_plane_sweep();
+		check_reset();
+	}
+
+	dbscan_context_destroy(ctx);
+	remove(POINTS_PATH);
+	remove(LABELS_PATH);
+	return check_done("strip-test");
+}